@@ -0,0 +1,29 @@
+#pragma once
+
+namespace Arrival
+{
+	struct ArrivalStats
+	{
+		double OfferedRate;		// Files per second of schedule, over span until arrival after last file (whole periods if BURSTY).
+		double MeanPostLag;		// Post time - scheduled arrival (us). Counted in queue wait and total latency.
+		double MaxPostLag;
+	};
+
+	// Same seed every test, so that points of sweep see the same arrivals.
+	constexpr UINT64 g_arrivalSeed = 0x5EED;
+
+	// Build arrival offsets of fileCount files for process of type at mean rate (files per second).
+	// BURSTY arrives only in first burstOnPercent of every burstPeriodMicroSeconds, at rate scaled up so that mean rate is kept.
+	// Not thread safe, call before Start.
+	void Init(ThreadSchedule::ArrivalType type, UINT rate, UINT fileCount, UINT burstPeriodMicroSeconds, UINT burstOnPercent);
+
+	// Offsets count from now.
+	void Start();
+
+	// Sleep until i-th arrival is due. Returns its scheduled time, in clock of Latency::GetNanoSeconds.
+	// Returns at once if arrival is already overdue, so that late arrivals are posted back to back.
+	UINT64 WaitArrival(UINT index);
+
+	// Return stats of this run.
+	ArrivalStats Shutdown();
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+namespace BufferPool
+{
+	struct BufferPoolStats
+	{
+		UINT64 HitCount;			// Served from thread cache or shared free list.
+		UINT64 MissCount;			// Carved from new slab, or allocated directly.
+		UINT64 DirectAllocCount;	// Arena exhausted, allocated from OS. Included in MissCount.
+		UINT64 HighWaterByteSize;	// Peak bytes handed out at the same time.
+	};
+
+	// Smallest size class. Also alignment of every buffer.
+	constexpr UINT64 g_minClassByteSize = 4096;
+
+	// Size classes are g_minClassByteSize << [0, g_classCount).
+	constexpr UINT g_classCount = 20;
+
+	// Small classes are carved out of slab of this size.
+	constexpr UINT64 g_slabByteSize = 4 * 1024 * 1024;
+
+	// Buffers kept in thread cache per class. Beyond this, half goes to shared free list.
+	constexpr UINT g_threadCacheCount = 8;
+
+	// Reserve arena of byteCap. If preTouch, commit & touch whole arena now.
+	void Init(UINT64 byteCap, BOOL preTouch);
+
+	// Get sector aligned buffer of at least byteSize.
+	BYTE* Acquire(UINT64 byteSize);
+
+	// Return buffer. byteSize must be the one given to Acquire.
+	void Release(BYTE* buffer, UINT64 byteSize);
+
+	// Release arena and return stats of this run.
+	BufferPoolStats Shutdown();
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+namespace ComputeKernel
+{
+	// Select kernel used by ByteSum. If CPU (or OS) lacks requested one, widest supported one is used.
+	// Returns selected kernel. Not thread safe, call before threads start.
+	ThreadSchedule::ComputeKernelType Init(ThreadSchedule::ComputeKernelType kernel);
+
+	// Can kernel run on this CPU and OS?
+	BOOL IsSupported(ThreadSchedule::ComputeKernelType kernel);
+
+	// Sum of bytes, using kernel selected by Init.
+	UINT64 ByteSum(const BYTE* data, UINT64 byteSize);
+
+	// Two's complement checksum of sum, added back to sum (& 0xFF).
+	int FoldChecksum(int sum);
+
+	// FoldChecksum of byte sum.
+	int Checksum(const BYTE* data, UINT64 byteSize);
+}
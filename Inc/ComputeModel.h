@@ -0,0 +1,38 @@
+#pragma once
+
+namespace ComputeModel
+{
+	struct ComputeModelStats
+	{
+		double UnitsPerMicroSecond;		// Calibrated speed of selected profile.
+		double MeanOvershoot;			// Actual - target compute time per call (us).
+		double MeanTimerCheckCount;		// Clock reads per call.
+	};
+
+	// Work done between clock reads. Bounds timer checks to target / this + 1.
+	constexpr double g_checkIntervalMicroSeconds = 50.0;
+
+	// Calibration run length per profile.
+	constexpr double g_calibrationMicroSeconds = 20000.0;
+
+	// Buffer streamed by calibration. Close to mean dummy file size.
+	constexpr UINT64 g_calibrationByteSize = 1 * 1024 * 1024;
+
+	// Bytes summed by one MEMORY_STREAM unit.
+	constexpr UINT64 g_streamUnitByteSize = 4096;
+
+	// Pointer-chase table of CACHE_THRASH. Larger than LLC, so that most loads miss.
+	// Included in peak memory of tests with CACHE_THRASH or MIXED profile.
+	constexpr UINT64 g_thrashTableByteSize = 64 * 1024 * 1024;
+
+	// Measure work units per microsecond of profile. Runs every test, so that current clock / kernel is reflected.
+	// Not thread safe, call before threads start. Call after ComputeKernel::Init.
+	void Init(ThreadSchedule::ComputeProfileType profile);
+
+	// Do calibrated work for targetMicroSeconds, reading clock every g_checkIntervalMicroSeconds.
+	// MEMORY_STREAM part streams over buffer. Returns checksum, so that work can't be optimized away.
+	int Run(const BYTE* buffer, UINT64 byteSize, double targetMicroSeconds);
+
+	// Release pointer-chase table and return stats of this run.
+	ComputeModelStats Shutdown();
+}
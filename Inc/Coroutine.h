@@ -0,0 +1,52 @@
+#pragma once
+
+namespace Coroutine
+{
+	struct FramePoolStats
+	{
+		UINT64 FrameByteSize;		// Largest frame asked for.
+		UINT64 FrameCount;			// Frames allocated.
+		UINT64 PeakFrameCount;		// Frames alive at the same time.
+		UINT64 SlabByteSize;		// Bytes carved into frames.
+		UINT64 HeapFrameCount;		// Frames larger than every class, allocated by operator new.
+	};
+
+	// Size classes are g_frameClassByteSize * [1, g_frameClassCount].
+	constexpr UINT64 g_frameClassByteSize = 64;
+	constexpr UINT g_frameClassCount = 16;
+
+	// Frames of a class are carved out of slab of this size.
+	constexpr UINT64 g_frameSlabByteSize = 1024 * 1024;
+
+	// Frames kept in thread cache per class. Beyond this, half goes to shared free list.
+	constexpr UINT g_frameThreadCacheCount = 256;
+
+	// Not thread safe, call before any frame is allocated.
+	void Init();
+
+	// Frame of coroutine. Thread that frees it can be other than the allocating one.
+	void* AllocateFrame(size_t byteSize);
+	void FreeFrame(void* frame, size_t byteSize);
+
+	// Release slabs and return stats of this run. Every frame must be freed.
+	FramePoolStats Shutdown();
+
+	// Coroutine of one file. Created suspended, so it runs only when scheduler resumes it.
+	// Frame is freed when body returns, and comes from frame pool instead of heap.
+	struct FileTask
+	{
+		struct promise_type
+		{
+			FileTask get_return_object() { return { std::coroutine_handle<promise_type>::from_promise(*this) }; }
+			std::suspend_always initial_suspend() noexcept { return {}; }
+			std::suspend_never final_suspend() noexcept { return {}; }
+			void return_void() {}
+			void unhandled_exception() { std::terminate(); }
+
+			static void* operator new(size_t byteSize) { return AllocateFrame(byteSize); }
+			static void operator delete(void* frame, size_t byteSize) { FreeFrame(frame, byteSize); }
+		};
+
+		std::coroutine_handle<promise_type> Handle;
+	};
+}
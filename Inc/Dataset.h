@@ -0,0 +1,47 @@
+#pragma once
+
+namespace Dataset
+{
+	// Entry of manifest, one per FID. Generator writes it, so tests know every file before reading it.
+	struct ManifestEntry
+	{
+		UINT64 Offset;				// Offset in packed data file, zero padded up to g_packedAlignment.
+		UINT64 ByteSize;
+		UINT ComputeMicroSeconds;	// Same as first 4 bytes of data.
+		UINT Reserved;
+	};
+
+	// Manifest file is this header, then FileCount entries.
+	struct ManifestHeader
+	{
+		UINT64 Magic;
+		UINT64 FileCount;
+	};
+
+	constexpr UINT64 g_manifestMagic = 0x31464e414d4f494d;	// "MIOMANF1"
+
+	// Offset of every entry. Sector aligned for unbuffered reads, page aligned for mmap.
+	constexpr UINT64 g_packedAlignment = 4096;
+
+#ifdef _WIN32
+	constexpr const wchar_t* g_packedDataPath = L"dummy\\packed.dat";
+	constexpr const wchar_t* g_manifestPath = L"dummy\\manifest";
+#else
+	constexpr const char* g_packedDataPath = "dummy/packed.dat";
+	constexpr const char* g_manifestPath = "dummy/manifest";
+#endif
+
+	// Read manifest of dataset. Fails if it has fewer than fileCount entries.
+	// Not thread safe, call before threads start.
+	void LoadManifest(UINT fileCount);
+
+	const ManifestEntry& GetEntry(UINT fid);
+
+	// Write manifest of entries, overwriting old one.
+	void WriteManifest(const std::vector<ManifestEntry>& entryAry);
+
+	void UnloadManifest();
+
+	// FIDs of loaded manifest in order of post. Cost of file is its compute time if byComputeTime, else its size.
+	std::vector<UINT> GetPostOrder(UINT fileCount, ThreadSchedule::PostOrderType order, BOOL byComputeTime);
+}
@@ -25,7 +25,7 @@ namespace FileGenerator
 		UINT Mean;
 		UINT Variance;
 	};
-	
+
 	struct FileGenerationArgs
 	{
 		UINT64 TotalFileCount;
@@ -34,5 +34,20 @@ namespace FileGenerator
 		FileComputeArgs FileCompute;
 	};
 
-	void GenerateDummyFiles(FileGenerationArgs fileGenerationArgs);
+	// How dataset is written. Not saved in distribution file.
+	struct GeneratorOptions
+	{
+		UINT ThreadCount;		// 0 means hardware thread count.
+		UINT QueueDepth;		// Chunk writes in flight per thread. 0 means g_defaultGeneratorQueueDepth.
+		UINT64 Seed;			// RNG stream of thread t is seeded by (Seed, t). 0 draws one from random_device.
+	};
+
+	constexpr UINT g_defaultGeneratorQueueDepth = 32;
+
+	// Files are written unbuffered in chunks of this size. Chunks after first one of file are all zero.
+	constexpr UINT g_generatorChunkByteSize = 1024 * 1024;
+
+	// Write dataset as dummy/<fid> files if writeFiles, and as dummy/packed.dat if writePacked.
+	// Both layouts get same sizes and compute times, listed in dummy/manifest. Same seed and thread count give same dataset.
+	void GenerateDummyFiles(FileGenerationArgs fileGenerationArgs, GeneratorOptions options, BOOL writeFiles, BOOL writePacked);
 }
@@ -0,0 +1,33 @@
+#pragma once
+
+namespace HugePage
+{
+	struct HugePageStats
+	{
+		UINT64 HugePageByteSize;	// 0 if system has no huge page, or FALSE == useHugePage on Linux.
+		UINT64 HugeTlbCount;		// Buffers on reserved huge pages.
+		UINT64 TransparentCount;	// Fell back to THP. Always 0 on Windows.
+		UINT64 SmallPageCount;		// Fell back to small pages.
+		UINT64 SmallBufferCount;	// Under half of huge page, so kept on small pages without trying.
+		BOOL IsDtlbCounted;			// FALSE if perf counter is unavailable. Always FALSE on Windows.
+		UINT64 DtlbMissCount;		// User mode dTLB load misses, from StartDtlbCount to Shutdown.
+	};
+
+	// Find huge page size, and open dTLB miss counter of calling thread and threads it creates afterwards.
+	// Counter is opened even if FALSE == useHugePage, so that both modes can be compared.
+	// Not thread safe, call before threads start.
+	void Init(BOOL useHugePage);
+
+	// Start counting. Threads created since Init are counted too.
+	void StartDtlbCount();
+
+	// Buffer of byteSize rounded up to huge page size, aligned to it.
+	// Tries reserved huge pages (MAP_HUGETLB / MEM_LARGE_PAGES), then THP by madvise(MADV_HUGEPAGE) on Linux, then small pages.
+	BYTE* Allocate(UINT64 byteSize);
+
+	// byteSize must be the one given to Allocate.
+	void Free(BYTE* buffer, UINT64 byteSize);
+
+	// Call after threads are joined. Returns stats of this run.
+	HugePageStats Shutdown();
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+
+namespace IoUring
+{
+	// Minimal io_uring wrapper over raw syscalls (no liburing dependency).
+	// Not thread safe. Caller must serialize SQ side and CQ side separately.
+	class Ring
+	{
+	public:
+		// Setup ring with given SQ entry count. Returns FALSE on failure.
+		BOOL Init(UINT entries);
+
+		// Unmap rings and close ring fd.
+		void Exit();
+
+		// Get free SQE slot. Returns nullptr if SQ is full.
+		io_uring_sqe* GetSqe();
+
+		// Number of SQEs prepared but not submitted yet.
+		UINT PendingCount() const;
+
+		// Submit prepared SQEs, optionally waiting until waitCount CQEs are ready.
+		int Submit(UINT waitCount = 0);
+
+		// Get CQE without blocking. Returns nullptr if CQ is empty.
+		io_uring_cqe* PeekCqe();
+
+		// Get CQE, block until one is available.
+		io_uring_cqe* WaitCqe();
+
+		// Mark CQE returned by PeekCqe/WaitCqe as consumed.
+		void SeenCqe();
+
+	private:
+		int ringFd = -1;
+
+		void* sqRingPtr = nullptr;
+		void* cqRingPtr = nullptr;
+		SIZE_T sqRingSize = 0;
+		SIZE_T cqRingSize = 0;
+
+		unsigned* sqHead = nullptr;
+		unsigned* sqTail = nullptr;
+		unsigned* sqMask = nullptr;
+		unsigned* sqArray = nullptr;
+		io_uring_sqe* sqes = nullptr;
+		SIZE_T sqesSize = 0;
+		unsigned sqeHead = 0;			// First prepared SQE not submitted yet.
+		unsigned sqeTail = 0;			// Next free SQE.
+		unsigned sqEntries = 0;
+
+		unsigned* cqHead = nullptr;
+		unsigned* cqTail = nullptr;
+		unsigned* cqMask = nullptr;
+		io_uring_cqe* cqes = nullptr;
+	};
+}
+#endif
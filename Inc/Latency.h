@@ -0,0 +1,60 @@
+#pragma once
+
+namespace Latency
+{
+	// Timestamps taken per file.
+	enum StageType
+	{
+		STAGE_POST,				// ReadCall task posted. Scheduled arrival time with ArrivalRate.
+		STAGE_READ_START,		// ReadCall task started.
+		STAGE_READ_COMPLETE,	// Read completion observed by a thread.
+		STAGE_COMPUTE_START,
+		STAGE_COMPUTE_END,
+		STAGE_COUNT
+	};
+
+	// How read of file was served. Read and total latency are also kept per path.
+	enum PathType
+	{
+		PATH_ASYNC,		// Read submitted, completion observed later.
+		PATH_INLINE,	// Read returned data at once, so file was computed by ReadCall thread.
+		PATH_COUNT
+	};
+
+	struct LatencyStats
+	{
+		ThreadSchedule::LatencyPercentiles QueueWait;		// POST -> READ_START
+		ThreadSchedule::LatencyPercentiles Read;			// READ_START -> READ_COMPLETE
+		ThreadSchedule::LatencyPercentiles ComputeWait;		// READ_COMPLETE -> COMPUTE_START
+		ThreadSchedule::LatencyPercentiles Compute;			// COMPUTE_START -> COMPUTE_END
+		ThreadSchedule::LatencyPercentiles Total;			// POST -> COMPUTE_END
+		ThreadSchedule::LatencyPercentiles PathRead[PATH_COUNT];
+		ThreadSchedule::LatencyPercentiles PathTotal[PATH_COUNT];
+	};
+
+	// Values below 2^g_subBucketBits (ns) are exact. Above, each power of 2 is split into 2^g_subBucketBits buckets (~3% error).
+	constexpr UINT g_subBucketBits = 5;
+	constexpr UINT g_subBucketCount = 1u << g_subBucketBits;
+	constexpr UINT g_bucketCount = (64 - g_subBucketBits + 1) * g_subBucketCount;
+
+	// Allocate timestamp table of fileCount. Not thread safe, call before threads start.
+	void Init(UINT fileCount);
+
+	// Record current time as stage of file. Each stage of file must be stamped by one thread.
+	void Stamp(UINT fid, StageType stage);
+
+	// Record given time of GetNanoSeconds clock as stage of file.
+	void StampAt(UINT fid, StageType stage, UINT64 nanoSeconds);
+
+	// Monotonic clock of stamps.
+	UINT64 GetNanoSeconds();
+
+	// Files are PATH_ASYNC unless set. Call before Complete.
+	void SetPath(UINT fid, PathType path);
+
+	// Stamp COMPUTE_END, then add stage latencies of file to histograms of calling thread. No lock.
+	void Complete(UINT fid);
+
+	// Merge histograms of every thread and get percentiles. Call after threads are joined.
+	LatencyStats Shutdown();
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+namespace MemoryBudget
+{
+	struct MemoryBudgetStats
+	{
+		UINT64 WaitCount;			// Admissions that had to wait for release.
+		double WaitTime;			// Sum of waits (ms).
+		UINT64 OverCommitCount;		// Admitted over cap, because every thread was waiting.
+		UINT64 HighWaterByteSize;	// Peak admitted bytes.
+	};
+
+	// Bytes of file buffers (or mapped views) admitted at the same time, from read submit to compute end.
+	// threadCount is number of threads that admit or release. 0 byteCap disables budget, then every call returns at once.
+	// Not thread safe, call before threads start.
+	void Init(UINT64 byteCap, UINT threadCount);
+
+	// Wait until byteSize fits under cap. File is always admitted when nothing else is, so file larger than cap runs alone.
+	// Admits over cap if every thread is waiting, since none of them could release.
+	void Acquire(UINT64 byteSize);
+
+	// Admit without waiting. Returns FALSE if byteSize doesn't fit now.
+	BOOL TryAcquire(UINT64 byteSize);
+
+	// byteSize must be the one given to Acquire / TryAcquire.
+	void Release(UINT64 byteSize);
+
+	// Return stats of this run. Call after threads are joined.
+	MemoryBudgetStats Shutdown();
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+namespace Rebalancer
+{
+	// Roles controller moves threads between. Same value as READCALL_ONLY / COMPUTE_ONLY.
+	enum RoleType
+	{
+		ROLE_READCALL,
+		ROLE_COMPUTE,
+		ROLE_COUNT,
+		ROLE_EXIT = ROLE_COUNT	// Test is done. Thread should return.
+	};
+
+	struct RebalancerStats
+	{
+		UINT64 SwitchCount;				// Threads moved between roles.
+		UINT64 GrowCount;				// Parked threads given a role.
+		UINT64 ShrinkCount;				// Threads parked.
+		double MeanReadCallThreadCount;	// Time-weighted over test.
+		double MeanComputeThreadCount;
+	};
+
+	// Controller samples queue depth and idle time of roles every interval, then does at most one move.
+	constexpr UINT g_intervalMicroSeconds = 1000;
+
+	// Role is saturated if its threads were idle less than this ratio of interval.
+	constexpr double g_busyIdleRatio = 0.1;
+
+	// Role has spare thread if its threads were idle more than this ratio of interval.
+	constexpr double g_slackIdleRatio = 0.5;
+
+	// Posted by wake function. Thread that takes it passes through Next without doing task.
+	constexpr UINT g_wakeCode = 4294967294;
+
+	// Start controller with role thread counts. Pool is bounded by [minThreadCount, maxThreadCount], every role keeps 1 thread.
+	// wakeFunc must post g_wakeCode to queue of role, so that blocked thread of role sees lowered count.
+	// leaveFunc is called by thread leaving role in Next, before it parks or takes another role. nullptr if not needed.
+	// Not thread safe, call before threads start.
+	void Init(UINT readCallThreadCount, UINT computeThreadCount, UINT minThreadCount, UINT maxThreadCount, void (*wakeFunc)(RoleType role), void (*leaveFunc)(RoleType role));
+
+	// Get role for new thread of pool. Parks until some role needs a thread.
+	RoleType Join();
+
+	// Call between tasks. Returns same role on fast path, another role if role has more threads than wanted.
+	RoleType Next(RoleType role);
+
+	// Wrap blocking wait for task of role. Only idle time is measured, so call them around waits only.
+	void BeginIdle(RoleType role);
+	void EndIdle(RoleType role);
+
+	// Tasks waiting for role. ReadCall task moves its file from ROLE_READCALL to ROLE_COMPUTE.
+	void AddQueueDepth(RoleType role, INT64 count);
+
+	// Last file is done. Parked threads and threads calling Next get ROLE_EXIT.
+	void Stop();
+
+	// Join controller and return stats of this run. Call after threads are joined.
+	RebalancerStats Shutdown();
+}
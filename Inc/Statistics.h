@@ -0,0 +1,24 @@
+#pragma once
+
+namespace Statistics
+{
+	struct Summary
+	{
+		UINT SampleCount;		// Inliers. Mean / stddev / CI are over these.
+		UINT OutlierCount;
+		double Median;
+		double Mean;
+		double StdDev;			// Sample standard deviation.
+		double CiLow;			// 95% confidence interval of mean (Student t).
+		double CiHigh;
+	};
+
+	// Sample is outlier if modified z-score (0.6745 * |x - median| / MAD) is over this (Iglewicz and Hoaglin).
+	constexpr double g_outlierZScore = 3.5;
+
+	// Marks outliers of sampleAry into isOutlierAry (same length), then summarizes inliers.
+	Summary Summarize(const std::vector<double>& sampleAry, std::vector<BOOL>* isOutlierAry);
+
+	// Confidence intervals overlap. Difference between a and b can't be told from noise.
+	BOOL IsOverlapped(const Summary& a, const Summary& b);
+}
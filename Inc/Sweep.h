@@ -0,0 +1,77 @@
+#pragma once
+
+namespace Sweep
+{
+	enum OutputFormatType
+	{
+		OUTPUT_FORMAT_CSV,
+		OUTPUT_FORMAT_JSON		// One object per line.
+	};
+
+	// Page cache state of dataset before every test run.
+	enum CacheModeType
+	{
+		CACHE_MODE_ANY,			// Left as previous run made it.
+		CACHE_MODE_COLD,		// Evicted. Shows device speed for buffered / mmap simulation types.
+		CACHE_MODE_WARM			// Read through once. Shows memory speed for them.
+	};
+
+	// Axes are swept as cartesian product. Axis that doesn't apply to simulation type is not multiplied.
+	struct SweepConfig
+	{
+		std::vector<ThreadSchedule::SimulationType> SimTypeAry;
+		std::vector<UINT> ThreadCountAry;					// Simulation types without roles.
+		std::vector<std::array<UINT, 4>> ThreadRoleAry;		// ROLE_SPECIFIED and IO_URING. Thread count is sum of roles.
+		std::vector<UINT> ReadCallTaskLimitAry;				// ROLE_SPECIFIED only. 0 means file count.
+		std::vector<UINT> ComputeTaskLimitAry;				// ROLE_SPECIFIED only. 0 means file count.
+		std::vector<UINT> TestFileCountAry;					// Runs read first files of dataset.
+		std::vector<UINT64> MemoryBudgetByteSizeAry;		// 0 disables budget.
+		std::vector<ThreadSchedule::DatasetLayoutType> DatasetLayoutAry;	// Generation writes every layout listed.
+		std::vector<ThreadSchedule::PostOrderType> PostOrderAry;
+		std::vector<ThreadSchedule::ThreadPlacementType> ThreadPlacementAry;
+		std::vector<ThreadSchedule::BufferPageType> BufferPageAry;	// Not used by MMAP, STREAMING, or with buffer pool.
+		std::vector<UINT> ArrivalRateAry;					// Files per second, innermost axis. 0 is closed batch.
+
+		UINT RepeatCount;
+		UINT WarmupCount;									// Runs before repeats of every point. Results are dropped.
+		CacheModeType CacheMode;
+		ThreadSchedule::TestArgument BaseArgs;				// Fields that are not swept. UseRebalancer / UseNowaitRead are cleared on points that can't use them.
+
+		UINT64 GenerateFileCount;							// Generate dataset once before sweep. 0 reuses existing one.
+		FileGenerator::FileGenerationArgs GenerationArgs;
+		FileGenerator::GeneratorOptions GeneratorOptions;
+
+		std::string OutputPath;								// Empty writes no rows.
+		OutputFormatType OutputFormat;
+		std::string TraceFilePath;							// TraceFilePath of expanded points points here.
+	};
+
+	// Options are "--key=value" on command line, or "key = value" lines of file given by "--config=path".
+	// List is comma separated, roles are colon separated (1:2:0:0). Later option overrides earlier one.
+	// Without options, config is same as former hardcoded test.
+	SweepConfig ParseArgs(int argc, char** argv);
+
+	// Test arguments of every point. ThreadRoleAry and TraceFilePath point into config, so config must outlive them.
+	std::vector<ThreadSchedule::TestArgument> Expand(const SweepConfig& config);
+
+	// Rows of sweep. Not thread safe.
+	void OpenOutput(const SweepConfig& config);
+	void WriteRow(UINT pointIndex, UINT repeatIndex, const ThreadSchedule::TestArgument& args, const ThreadSchedule::TestResult& result, BOOL isOutlier);
+	void CloseOutput();
+
+	// Bring first fileCount files of dataset into mode. No-op for CACHE_MODE_ANY.
+	void PrepareCache(UINT fileCount, ThreadSchedule::DatasetLayoutType layout, CacheModeType mode);
+
+	const char* GetSimulationName(ThreadSchedule::SimulationType simType);
+
+	const char* GetDatasetLayoutName(ThreadSchedule::DatasetLayoutType layout);
+
+	const char* GetPostOrderName(ThreadSchedule::PostOrderType order);
+
+	const char* GetThreadPlacementName(ThreadSchedule::ThreadPlacementType placement);
+
+	const char* GetBufferPageName(ThreadSchedule::BufferPageType bufferPage);
+
+	// CLOSED if ArrivalRate is 0.
+	const char* GetArrivalName(const ThreadSchedule::TestArgument& args);
+}
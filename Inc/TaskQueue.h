@@ -0,0 +1,167 @@
+#pragma once
+
+namespace ThreadSchedule
+{
+	// Bounded lock-free MPMC FIFO of FIDs (Vyukov ring).
+	// Plays the role of IOCP used as a queue (PostQueuedCompletionStatus / GetQueuedCompletionStatus)
+	// without kernel transition. Idle consumers park on atomic wait (futex on Linux, WaitOnAddress on Windows).
+	class TaskQueue
+	{
+	public:
+		~TaskQueue()
+		{
+			delete[] cellAry;
+		}
+
+		// Capacity is rounded up to power of 2. Not thread safe.
+		void Init(const UINT capacity)
+		{
+			UINT64 size = 2;
+			while (size < capacity)
+				size <<= 1;
+
+			delete[] cellAry;
+			cellAry = new Cell[size];
+			mask = size - 1;
+
+			Clear();
+		}
+
+		// Spin (yield) if queue is full.
+		void Push(const UINT fid)
+		{
+			while (FALSE == TryPush(fid))
+				std::this_thread::yield();
+
+			// Pairs with fence in Pop, so that either producer sees waiter or waiter sees task.
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (waiterCount.load(std::memory_order_relaxed) > 0)
+			{
+				signal.fetch_add(1, std::memory_order_release);
+				signal.notify_one();
+			}
+		}
+
+		// Block until task exists.
+		UINT Pop()
+		{
+			UINT fid;
+
+			while (TRUE)
+			{
+				for (UINT spin = 0; spin < g_spinCount; spin++)
+				{
+					if (TryPop(&fid))
+						return fid;
+				}
+
+				const UINT epoch = signal.load(std::memory_order_acquire);
+				waiterCount.fetch_add(1, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+
+				if (TryPop(&fid))
+				{
+					waiterCount.fetch_sub(1, std::memory_order_relaxed);
+					return fid;
+				}
+
+				// Returns immediately if Push bumped signal after epoch was read.
+				signal.wait(epoch, std::memory_order_acquire);
+				waiterCount.fetch_sub(1, std::memory_order_relaxed);
+			}
+		}
+
+		// Returns FALSE if queue is full.
+		BOOL TryPush(const UINT fid)
+		{
+			UINT64 pos = enqueuePos.load(std::memory_order_relaxed);
+			Cell* cell;
+
+			while (TRUE)
+			{
+				cell = &cellAry[pos & mask];
+				const UINT64 seq = cell->Sequence.load(std::memory_order_acquire);
+				const INT64 diff = static_cast<INT64>(seq) - static_cast<INT64>(pos);
+
+				if (diff == 0)
+				{
+					if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+						break;
+				}
+				else if (diff < 0)
+				{
+					return FALSE;
+				}
+				else
+				{
+					pos = enqueuePos.load(std::memory_order_relaxed);
+				}
+			}
+
+			cell->FID = fid;
+			cell->Sequence.store(pos + 1, std::memory_order_release);
+			return TRUE;
+		}
+
+		// Returns FALSE immediately if no task exists.
+		BOOL TryPop(UINT* fid)
+		{
+			UINT64 pos = dequeuePos.load(std::memory_order_relaxed);
+			Cell* cell;
+
+			while (TRUE)
+			{
+				cell = &cellAry[pos & mask];
+				const UINT64 seq = cell->Sequence.load(std::memory_order_acquire);
+				const INT64 diff = static_cast<INT64>(seq) - static_cast<INT64>(pos + 1);
+
+				if (diff == 0)
+				{
+					if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+						break;
+				}
+				else if (diff < 0)
+				{
+					return FALSE;
+				}
+				else
+				{
+					pos = dequeuePos.load(std::memory_order_relaxed);
+				}
+			}
+
+			*fid = cell->FID;
+			cell->Sequence.store(pos + mask + 1, std::memory_order_release);
+			return TRUE;
+		}
+
+		// Drop every task. Not thread safe.
+		void Clear()
+		{
+			for (UINT64 i = 0; i <= mask && cellAry != nullptr; i++)
+				cellAry[i].Sequence.store(i, std::memory_order_relaxed);
+
+			enqueuePos.store(0, std::memory_order_relaxed);
+			dequeuePos.store(0, std::memory_order_relaxed);
+			waiterCount.store(0, std::memory_order_relaxed);
+		}
+
+	private:
+		// TryPop attempts before parking.
+		static constexpr UINT g_spinCount = 64;
+
+		struct Cell
+		{
+			std::atomic<UINT64> Sequence;
+			UINT FID;
+		};
+
+		Cell* cellAry = nullptr;
+		UINT64 mask = 0;
+
+		alignas(64) std::atomic<UINT64> enqueuePos;
+		alignas(64) std::atomic<UINT64> dequeuePos;
+		alignas(64) std::atomic<UINT> waiterCount;
+		std::atomic<UINT> signal;
+	};
+}
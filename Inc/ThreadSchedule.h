@@ -17,7 +17,7 @@ namespace ThreadSchedule
 		THREAD_TASK_COMPUTE
 	};
 
-	// Define file status. Needs lock.
+	// Define file status. Stored in FileSlot::Status.
 	// Only used when simulation type is MANUAL.
 	enum FileStatusType
 	{
@@ -38,8 +38,85 @@ namespace ThreadSchedule
 		SIM_ROLE_SPECIFIED_THREAD,
 		SIM_SYNC_THREAD,
 		SIM_MMAP_THREAD,
+		SIM_IO_URING_THREAD,
+		SIM_STREAMING_THREAD,
+		SIM_WORK_STEALING_THREAD,
+		SIM_COROUTINE_THREAD,
 	};
 
+	// Access pattern hint given to madvise.
+	// Only used when simulation type is MMAP on Linux.
+	enum MmapAdviceType
+	{
+		MMAP_ADVICE_NONE,
+		MMAP_ADVICE_SEQUENTIAL,
+		MMAP_ADVICE_WILLNEED,
+		MMAP_ADVICE_HUGEPAGE
+	};
+
+	// Byte-sum kernel of compute task. AUTO picks widest one CPU supports.
+	enum ComputeKernelType
+	{
+		COMPUTE_KERNEL_AUTO,
+		COMPUTE_KERNEL_SCALAR,
+		COMPUTE_KERNEL_SSE2,
+		COMPUTE_KERNEL_AVX2,
+		COMPUTE_KERNEL_AVX512
+	};
+
+	// Kind of work done by compute task when UseDefinedComputeTime.
+	enum ComputeProfileType
+	{
+		COMPUTE_PROFILE_MEMORY_STREAM,	// Stream over file buffer with compute kernel.
+		COMPUTE_PROFILE_ALU,			// Dependent integer chain in registers.
+		COMPUTE_PROFILE_CACHE_THRASH,	// Pointer chase over table larger than LLC.
+		COMPUTE_PROFILE_MIXED			// Equal units of the three above.
+	};
+
+	// Where test files are read from.
+	enum DatasetLayoutType
+	{
+		DATASET_LAYOUT_FILES,	// dummy/<fid>, opened per file.
+		DATASET_LAYOUT_PACKED	// Offsets of dummy/packed.dat given by dummy/manifest. Opened once per test.
+	};
+
+	// Order in which FIDs are posted. Every order but FIFO reads dummy/manifest.
+	enum PostOrderType
+	{
+		POST_ORDER_FIFO,		// 0..N-1.
+		POST_ORDER_LPT,			// Largest first, so big files don't start last and run alone at end.
+		POST_ORDER_SPT,			// Smallest first.
+		POST_ORDER_INTERLEAVED	// Largest, smallest, second largest, second smallest, ...
+	};
+
+	// Where threads run and read buffers live. Every type but NONE measures per-node traffic.
+	enum ThreadPlacementType
+	{
+		THREAD_PLACEMENT_NONE,		// Scheduler places threads, buffers land where first touched.
+		THREAD_PLACEMENT_UNPINNED,	// Same as NONE. Baseline of traffic for types below.
+		THREAD_PLACEMENT_CORE,		// Own physical core per thread, filling node by node.
+		THREAD_PLACEMENT_SMT,		// ReadCall thread k and Compute thread k on SMT siblings of one core.
+		THREAD_PLACEMENT_NODE		// ReadCall thread k and Compute thread k on any CPU of node k.
+	};
+
+	// Pages of read buffers. Only used for buffers from AllocateFileBuffer, without UseBufferPool.
+	enum BufferPageType
+	{
+		BUFFER_PAGE_SMALL,		// Pages of default allocator.
+		BUFFER_PAGE_HUGE		// Reserved huge pages, else THP (Linux), else small pages. Sized up to huge page.
+	};
+
+	// Arrival process of files when ArrivalRate > 0. Otherwise every file is posted at start, as closed batch.
+	enum ArrivalType
+	{
+		ARRIVAL_FIXED,		// Evenly spaced.
+		ARRIVAL_POISSON,	// Exponential gaps.
+		ARRIVAL_BURSTY		// Poisson during on part of every period, nothing during off part. Mean rate is kept.
+	};
+
+	// Nodes beyond this count are added to last one in TestResult.
+	constexpr UINT g_maxReportedNodeCount = 8;
+
 	struct ThreadTaskArgs
 	{
 		UINT FID;
@@ -54,6 +131,42 @@ namespace ThreadSchedule
 		UINT ReadCallTaskLimit;
 		UINT ComputeTaskLimit;
 		BOOL UseDefinedComputeTime;
+		UINT IoQueueDepth;			// Max in-flight reads (per thread if WORK_STEALING or COROUTINE). Only used when simulation type is IO_URING, WORK_STEALING or COROUTINE.
+		UINT IoSubmitBatch;			// SQEs per submit call. Only used when simulation type is IO_URING, WORK_STEALING or COROUTINE on Linux.
+		MmapAdviceType MmapAdvice;	// madvise policy. Only used when simulation type is MMAP on Linux.
+		BOOL MmapPopulate;			// Map with MAP_POPULATE. Only used when simulation type is MMAP on Linux.
+		UINT MmapPrefetchByteSize;	// Prefetch distance ahead of compute cursor. 0 disables prefetch thread.
+		UINT StreamSegmentByteSize;	// Read unit of file. Only used when simulation type is STREAMING.
+		UINT StreamInflightCount;	// Segment reads in flight per file. Only used when simulation type is STREAMING.
+		BOOL UseBufferPool;			// Get read buffers from BufferPool instead of VirtualAlloc/posix_memalign.
+		UINT64 BufferPoolByteSize;	// Byte cap of pooled memory. Beyond this, buffers are allocated directly.
+		BOOL BufferPoolPreTouch;	// Commit & touch whole pool before test starts.
+		BOOL UseUserTaskQueue;		// Dispatch ReadCall tasks with lock-free TaskQueue instead of IOCP. Always on Linux.
+		ComputeKernelType ComputeKernel;	// Falls back to widest supported kernel if CPU lacks it.
+		ComputeProfileType ComputeProfile;	// Only used when UseDefinedComputeTime.
+		const char* TraceFilePath;		// Write timeline of test as Chrome trace JSON, overwritten by every test. nullptr disables tracing.
+		BOOL UseRebalancer;			// Move READCALL_ONLY / COMPUTE_ONLY threads between roles at runtime. Only used when simulation type is ROLE_SPECIFIED or IO_URING.
+		UINT MinThreadCount;		// Bounds of READCALL_ONLY + COMPUTE_ONLY threads when UseRebalancer. 0 means 2.
+		UINT MaxThreadCount;		// 0 means initial count of ThreadRoleAry, so pool doesn't grow.
+		UINT64 MemoryBudgetByteSize;	// Cap on buffer bytes of files from read submit to compute end, across all threads. 0 disables. Not used by STREAMING.
+		DatasetLayoutType DatasetLayout;
+		PostOrderType PostOrder;		// File cost is compute time if UseDefinedComputeTime, else size.
+		BOOL UseNowaitRead;			// Try buffered preadv2(RWF_NOWAIT) first, compute inline on page cache hit, else read async. Only used when simulation type is IO_URING on Linux.
+		ThreadPlacementType ThreadPlacement;	// CORE / SMT / NODE also allocate read buffers on node of allocating thread, unless UseBufferPool or BUFFER_PAGE_HUGE.
+		BufferPageType BufferPage;
+		ArrivalType Arrival;
+		UINT ArrivalRate;			// Files per second. Files are posted as they arrive (open loop), and latencies count from scheduled arrival. 0 posts every file at start.
+		UINT ArrivalBurstPeriodMicroSeconds;	// Only used when Arrival is BURSTY.
+		UINT ArrivalBurstOnPercent;	// Part of period in which files arrive.
+	};
+
+	// Stage latency of files (us).
+	struct LatencyPercentiles
+	{
+		double P50;
+		double P90;
+		double P99;
+		double P999;
 	};
 
 	struct TestResult
@@ -61,6 +174,71 @@ namespace ThreadSchedule
 		double ElapsedTime;
 		UINT64 TotalFileSize;
 		SIZE_T PeakMemory;
+		UINT64 SubmitCallCount;		// Number of io_uring_enter submit calls.
+		UINT64 MajorFaultCount;		// Page faults that needed I/O. Always 0 on Windows.
+		UINT64 MinorFaultCount;		// Page faults served from memory. Total page faults on Windows.
+		double MeanTimeToFirstByte;	// From task start to first segment landed (ms). Only filled by STREAMING.
+		double MeanFileLatency;		// From task start to compute end (ms). Only filled by STREAMING.
+		double MaxFileLatency;		// Only filled by STREAMING.
+		UINT64 BufferPoolHitCount;
+		UINT64 BufferPoolMissCount;
+		UINT64 BufferPoolHighWaterByteSize;
+		double DispatchPostNanoSeconds;	// Enqueue cost per task, measured over posting loop.
+		double DispatchGetNanoSeconds;	// Dequeue cost per task, measured when task was ready.
+		UINT64 StealReadCallCount;	// ReadCall tasks taken from another thread. Only filled by WORK_STEALING.
+		UINT64 StealComputeCount;	// Compute tasks taken from another thread. Only filled by WORK_STEALING.
+		UINT64 StealFailCount;		// Idle periods where every victim was empty, counted once per period. Only filled by WORK_STEALING.
+		UINT64 LocalComputeCount;	// Compute tasks done by thread that issued the read. Only filled by WORK_STEALING.
+		double FileSetupTime;		// Building per-file state before timer starts (ms). Only filled by MANUAL or COROUTINE.
+		double FileSyncNanoSeconds;	// Acquire + release of file status per task, waits included. Only filled by MANUAL.
+		UINT64 FileSyncParkCount;	// Times a thread parked on file status. Only filled by MANUAL.
+		ComputeKernelType ComputeKernelUsed;
+		double ComputeUnitsPerMicroSecond;	// Calibrated speed of ComputeProfile. Only filled when UseDefinedComputeTime.
+		double MeanComputeOvershoot;		// Actual - defined compute time (us). Only filled when UseDefinedComputeTime.
+		double MeanComputeTimerCheckCount;	// Clock reads per compute. Only filled when UseDefinedComputeTime.
+		LatencyPercentiles QueueWaitLatency;	// From post to ReadCall start.
+		LatencyPercentiles ReadLatency;			// From ReadCall start to completion observed.
+		LatencyPercentiles ComputeWaitLatency;	// From completion observed to compute start.
+		LatencyPercentiles ComputeLatency;		// From compute start to compute end.
+		LatencyPercentiles TotalLatency;		// From post to compute end.
+		UINT64 TraceEventCount;			// Spans written to TraceFilePath.
+		UINT64 TraceDroppedEventCount;	// Oldest spans overwritten in full ring of thread.
+		UINT64 RebalanceSwitchCount;	// Threads moved between ReadCall and Compute role. Only filled when UseRebalancer.
+		UINT64 RebalanceGrowCount;		// Parked threads given a role. Only filled when UseRebalancer.
+		UINT64 RebalanceShrinkCount;	// Threads parked. Only filled when UseRebalancer.
+		double MeanReadCallThreadCount;	// Time-weighted. Only filled when UseRebalancer.
+		double MeanComputeThreadCount;	// Time-weighted. Only filled when UseRebalancer.
+		UINT64 MemoryBudgetWaitCount;		// Reads held back by MemoryBudgetByteSize.
+		double MemoryBudgetWaitTime;		// Sum of those waits (ms).
+		UINT64 MemoryBudgetOverCommitCount;	// Reads admitted over cap to avoid deadlock.
+		UINT64 MemoryBudgetHighWaterByteSize;	// Peak admitted bytes.
+		UINT64 NowaitHitCount;		// Files read whole by RWF_NOWAIT and computed inline. Only filled when UseNowaitRead.
+		UINT64 NowaitMissCount;		// Files that fell back to async read.
+		LatencyPercentiles NowaitHitReadLatency;
+		LatencyPercentiles NowaitHitTotalLatency;
+		LatencyPercentiles NowaitMissReadLatency;
+		LatencyPercentiles NowaitMissTotalLatency;
+		UINT NodeCount;					// Only filled when ThreadPlacement is not NONE.
+		UINT CoreCount;
+		UINT CpuCount;
+		UINT PinnedThreadCount;
+		UINT64 PlacedBufferCount;		// Buffers allocated on node of allocating thread.
+		UINT64 NodeLocalByteSizeAry[g_maxReportedNodeCount];	// Bytes computed from buffer on node of computing thread. Indexed by that node.
+		UINT64 NodeRemoteByteSizeAry[g_maxReportedNodeCount];	// Bytes computed from buffer on other node.
+		UINT64 CoroutineFrameByteSize;		// State of one file while suspended. Only filled by COROUTINE.
+		UINT64 CoroutinePeakFrameCount;		// Files alive as coroutines at the same time.
+		UINT64 CoroutineFramePoolByteSize;	// Slab bytes reserved for frames.
+		UINT64 CoroutineSuspendCount;		// Suspensions on read completion or memory budget.
+		UINT64 HugePageByteSize;			// Only filled when BufferPage is HUGE.
+		UINT64 HugePageBufferCount;			// Read buffers on reserved huge pages.
+		UINT64 TransparentHugePageBufferCount;	// Fell back to THP. Always 0 on Windows.
+		UINT64 SmallPageBufferCount;		// Fell back to small pages.
+		UINT64 SmallBufferCount;			// Under half of huge page, not tried.
+		BOOL IsDtlbMissCounted;				// FALSE if perf counter is unavailable. Always FALSE on Windows.
+		UINT64 DtlbMissCount;				// User mode dTLB load misses of test threads, over timed part of test. Filled for every BufferPage.
+		double OfferedRate;			// Files per second of arrival schedule. Only filled when ArrivalRate > 0.
+		double MeanArrivalLag;		// Post time - scheduled arrival (us), when posting thread woke late.
+		double MaxArrivalLag;
 	};
 
 	struct TaskMode
@@ -70,39 +248,34 @@ namespace ThreadSchedule
 		BOOL IsComputeTaskTurn;
 	};
 
-	class FileLock
-	{
-	public:
-		HANDLE semLock[3];
-		HANDLE taskEndEvent[3];
-
-		explicit FileLock(UINT fid)
-		{
-			for (UINT i = 0; i < 3; i++)
-			{
-				semLock[i] = 
-					CreateSemaphoreW(
-						NULL, i == 0, 1, 
-						(std::to_wstring(fid) + L"-sem" + std::to_wstring(i)).c_str());
-				taskEndEvent[i] = 
-					CreateEvent(
-						NULL, TRUE, FALSE, 
-						(std::to_wstring(fid) + L"-taskEndEv" + std::to_wstring(i)).c_str());
-			}
-		}
-
-		~FileLock()
-		{
-			for (UINT i = 0; i < 3; i++)
-			{
-				CloseHandle(semLock[i]);
-				CloseHandle(taskEndEvent[i]);
-			}
-		}
+#ifdef _WIN32
+	// Per-file state. Indexed by FID.
+	// Padded to cache line, so that threads working on neighbor FIDs don't false share.
+	// Only used when simulation type is MANUAL or ROLE_SPECIFIED.
+	struct alignas(64) FileSlot
+	{
+		HANDLE FileHandle;
+		HANDLE FileIocp;				// Only used when simulation type is MANUAL. NULL if dataset is packed.
+		OVERLAPPED Overlapped;			// Read of file. hEvent is set only for MANUAL with packed dataset.
+		BYTE* Buffer;
+		UINT BufferSize;
+		std::atomic<UINT> Status;		// FileStatusType | g_fileStatusWaiterBit. Only used when simulation type is MANUAL.
+		std::atomic<BOOL> Published;	// Set (release) after fields above are written by ReadCall task.
 	};
-	
-	constexpr UINT g_exitCode = 4294967295;
+
 	constexpr BOOL g_fileFlag = FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED;
+
+	// Set in FileSlot::Status while some thread is parked on it, so that release can skip wake call.
+	constexpr UINT g_fileStatusWaiterBit = 0x80000000;
+
+	// Status checks before parking on FileSlot::Status.
+	constexpr UINT g_fileStatusSpinCount = 64;
+
+	// Completion key of packed data file. FID is found from OVERLAPPED, which is FileSlot::Overlapped.
+	constexpr UINT g_packedCompletionKey = 4294967293;
+#endif
+
+	constexpr UINT g_exitCode = 4294967295;
 	
 	// Define loop count of checksum (compute task)
 	// Only affects when UseDefinedComputeTime is FALSE.
@@ -111,9 +284,32 @@ namespace ThreadSchedule
 	// Define how much tasks will be dequeued at once.
 	// Only affects when simulation type is MANUAL.
 	constexpr UINT g_taskRemoveCount = 10;
-	
+
+	// Default io_uring queue depth, submit batch when not given.
+	// Only affects when simulation type is IO_URING.
+	constexpr UINT g_defaultIoQueueDepth = 64;
+	constexpr UINT g_defaultIoSubmitBatch = 8;
+
+	// Default segment size, in-flight segment count when not given.
+	// Only affects when simulation type is STREAMING.
+	constexpr UINT g_defaultStreamSegmentByteSize = 256 * 1024;
+	constexpr UINT g_defaultStreamInflightCount = 4;
+
+	// Checksum is computed by this unit, so that MMAP compute cursor can be published.
+	// Only affects when simulation type is MMAP on Linux.
+	constexpr UINT g_mmapComputeChunkSize = 64 * 1024;
+
+	// Work stealing task is (type << 32 | fid).
+	// Only affects when simulation type is WORK_STEALING.
+	constexpr UINT g_taskTypeShift = 32;
+
+	// Buffer & length alignment for O_DIRECT.
+	// Only affects on Linux.
+	constexpr UINT g_directIoAlignment = 4096;
+
+#ifdef _WIN32
 	// Prepare file handle and do ReadFile Call.
-	// Only used when simulation type is MANUAL or ROLE_SPECIFIED.
+	// Only used when simulation type is MANUAL, ROLE_SPECIFIED or WORK_STEALING.
 	void ReadCallTaskWork(UINT fid);
 	
 	// Wait until file read is done using IOCP.
@@ -121,8 +317,12 @@ namespace ThreadSchedule
 	void CompletionTaskWork(UINT fid);
 	
 	// Do compute task and release resources.
-	// Only used when simulation type is MANUAL or ROLE_SPECIFIED.
+	// Only used when simulation type is MANUAL, ROLE_SPECIFIED or WORK_STEALING.
 	void ComputeTaskWork(UINT fid);
+
+	// Get slot of file, waiting until ReadCall task published it.
+	// Only used when simulation type is MANUAL, ROLE_SPECIFIED or WORK_STEALING.
+	FileSlot& AcquireFileSlot(UINT fid);
 	
 	// Do ReadCall task, Compute task once.
 	// Only used when simulation type is MMAP.
@@ -132,9 +332,22 @@ namespace ThreadSchedule
 	// Only used when simulation type is SYNC.
 	void SyncTaskWork(UINT fid);
 
-	// Failed to get lock, which means another thread is processing task.
+	// Read file by segments with several reads in flight, compute segments in order.
+	// Only used when simulation type is STREAMING.
+	void StreamTaskWork(UINT fid, BYTE* slotBuffer, OVERLAPPED* slotOvAry);
+
+	// Add checksum of segment to sum. Spins until timeOverMicroSeconds if UseDefinedComputeTime.
+	// Only used when simulation type is STREAMING.
+	int ComputeSegment(const BYTE* segment, DWORD segmentByteSize, int sum, double timeOverMicroSeconds);
+
+	// Move file status to STARTED of threadTaskType with CAS, waiting on status word while pre-require task runs.
+	// Returns WAIT_TIMEOUT if another thread has taken the task, which means ignore your job.
+	// Only used when simulation type is MANUAL.
+	DWORD AcquireFileTask(UINT fid, UINT threadTaskType);
+
+	// Move file status to WAITING of next task (COMPLETED if last), wake parked threads if any.
 	// Only used when simulation type is MANUAL.
-	DWORD HandleLockAcquireFailure(const UINT fid, const UINT threadTaskType);
+	void ReleaseFileTask(UINT fid, UINT threadTaskType);
 	
 	// Do tasks with task type.
 	// Only used when simulation type is MANUAL.
@@ -144,10 +357,23 @@ namespace ThreadSchedule
 
 	DWORD WINAPI ManualThreadFunc(LPVOID param);
 	DWORD WINAPI RoleSpecifiedThreadFunc(LPVOID param);
+
+	// Take role from Rebalancer, switching between ReadCall and Compute wait at runtime.
+	// Only used when simulation type is ROLE_SPECIFIED with UseRebalancer.
+	DWORD WINAPI RebalancedThreadFunc(LPVOID param);
+
 	DWORD WINAPI MMAPThreadFunc(LPVOID param);
 	DWORD WINAPI SyncThreadFunc(LPVOID param);
+	DWORD WINAPI StreamThreadFunc(LPVOID param);
+	DWORD WINAPI WorkStealingThreadFunc(LPVOID param);
 
-	TestResult StartTest(TestArgument args);
+	// Resume file coroutines on completion of reads on IOCP of thread, start new ones up to queue depth.
+	// Only used when simulation type is COROUTINE.
+	DWORD WINAPI CoroutineThreadFunc(LPVOID param);
+
+	// Move completed reads on thread t's IOCP into its deque as Compute tasks. Returns removed count.
+	// Only used when simulation type is WORK_STEALING.
+	UINT ReapWorkStealingCompletion(UINT t, DWORD timeout);
 
 	// Get aligned byte size using sector size.
 	DWORD GetAlignedByteSize(PLARGE_INTEGER fileByteSize, DWORD sectorSize);
@@ -157,4 +383,79 @@ namespace ThreadSchedule
 	
 	// Post exit code to thread.
 	void PostThreadExit(UINT t);
+#else
+	// Open file with O_DIRECT, allocate aligned buffer and queue read SQE.
+	// Only used when simulation type is IO_URING.
+	void IoUringReadCallTaskWork(UINT fid);
+
+	// Do compute task with completed buffer and release resources.
+	// Only used when simulation type is IO_URING.
+	void IoUringComputeTaskWork(UINT fid, int readResult);
+
+	// Do ReadCall task (pread), Compute task once.
+	// Only used when simulation type is SYNC.
+	void SyncTaskWork(UINT fid);
+
+	// Map file with madvise hint, do Compute task over mapped view.
+	// Only used when simulation type is MMAP.
+	void MMAPTaskWork(UINT t, UINT fid);
+
+	// Open file with O_DIRECT, allocate aligned buffer and queue read SQE on ring of thread t.
+	// Only used when simulation type is WORK_STEALING.
+	void WorkStealingReadCallTaskWork(UINT t, UINT fid);
+
+	// Do compute task with completed buffer and release resources.
+	// Only used when simulation type is WORK_STEALING.
+	void WorkStealingComputeTaskWork(UINT fid);
+
+	// Move completed reads on ring of thread t into its deque as Compute tasks. Returns removed count.
+	// Only used when simulation type is WORK_STEALING.
+	UINT ReapWorkStealingCompletion(UINT t, BOOL wait);
+
+	void IoUringThreadFunc(UINT threadRole);
+
+	// Take role from Rebalancer, switching between ReadCall and Compute loop at runtime.
+	// Only used when simulation type is IO_URING with UseRebalancer.
+	void IoUringRebalancedThreadFunc();
+
+	void SyncThreadFunc();
+	void MMAPThreadFunc(UINT t);
+	void WorkStealingThreadFunc(UINT t);
+
+	// Resume file coroutines on completion of reads on ring of thread t, start new ones up to queue depth.
+	// Only used when simulation type is COROUTINE.
+	void CoroutineThreadFunc(UINT t);
+
+	// Touch pages ahead of MMAP thread t's compute cursor.
+	void MMAPPrefetchThreadFunc(UINT t);
+
+	// Get aligned byte size using sector size.
+	UINT64 GetAlignedByteSize(UINT64 fileByteSize, UINT64 sectorSize);
+
+	// Reset peak RSS (VmHWM) so that each test gets its own peak.
+	void ResetPeakMemory();
+
+	// Get peak RSS from /proc/self/status, or getrusage if unavailable.
+	SIZE_T GetPeakMemory();
+#endif
+
+	// Post ReadCall task (or exit code) to global task queue.
+	// Only used when simulation type is not MANUAL. WORK_STEALING takes arrivals from it only when ArrivalRate > 0.
+	void PostGlobalTask(UINT fid);
+
+	// Get task from global task queue. Returns FALSE if nothing arrived within timeout.
+	// Only used when simulation type is not MANUAL.
+	BOOL GetGlobalTask(UINT* fid, DWORD timeout);
+
+	// Steal task from deque of other threads, starting from random victim.
+	// Only used when simulation type is WORK_STEALING.
+	BOOL StealTask(UINT t, UINT64* task);
+
+	// Get read buffer of alignedByteSize. Uses BufferPool if UseBufferPool.
+	BYTE* AllocateFileBuffer(UINT64 alignedByteSize);
+
+	// Release buffer from AllocateFileBuffer. alignedByteSize must be the same.
+	void ReleaseFileBuffer(BYTE* buffer, UINT64 alignedByteSize);
+
+	TestResult StartTest(TestArgument args);
 }
@@ -0,0 +1,42 @@
+#pragma once
+
+namespace Topology
+{
+	struct TopologyStats
+	{
+		UINT NodeCount;
+		UINT CoreCount;				// Physical cores the process may run on.
+		UINT CpuCount;				// Logical processors the process may run on.
+		UINT PinnedThreadCount;
+		UINT64 PlacedBufferCount;	// Buffers allocated on node of allocating thread.
+		UINT64 LocalByteSizeAry[ThreadSchedule::g_maxReportedNodeCount];	// Indexed by node of computing thread.
+		UINT64 RemoteByteSizeAry[ThreadSchedule::g_maxReportedNodeCount];
+	};
+
+#ifdef _WIN32
+	typedef HANDLE ThreadHandle;
+#else
+	typedef pthread_t ThreadHandle;
+#endif
+
+	// Read CPU / core / node layout of machine, and plan CPUs of each thread by placement.
+	// Layout comes from sysfs on Linux, and from processor group of process on Windows (up to 64 logical processors).
+	// threadRoleAry[t] is ThreadRoleType of thread t. Not thread safe, call before threads start.
+	void Init(ThreadSchedule::ThreadPlacementType placement, const std::vector<UINT>& threadRoleAry);
+
+	// Set affinity of thread t to its planned CPUs. No-op unless placement pins threads.
+	void PinThread(UINT t, ThreadHandle thread);
+
+	// Buffers go to node of allocating thread. FALSE lets caller allocate as usual.
+	BOOL IsPlacingBuffers();
+
+	// Page aligned buffer on node of calling thread. Release by Free.
+	BYTE* Allocate(UINT64 byteSize);
+	void Free(BYTE* buffer, UINT64 byteSize);
+
+	// Count bytes computed by calling thread, local or remote by node of first page of buffer. No-op for NONE.
+	void AddTraffic(const BYTE* buffer, UINT64 byteSize);
+
+	// Call after threads are joined. Returns stats of this run.
+	TopologyStats Shutdown();
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+// Timeline spans. No-op unless Trace::Init got a file path.
+#define SERIES_INIT(name) \
+	Trace::SetThreadName(name)
+#define SPAN_INIT \
+	Trace::Span s
+#define SPAN_START(cat, name, ...) \
+	s = Trace::Begin(cat, name, ##__VA_ARGS__)
+#define SPAN_END \
+	Trace::End(s)
+
+namespace Trace
+{
+	// Same value as ThreadTaskType for task categories.
+	enum CategoryType
+	{
+		CATEGORY_READ_CALL,
+		CATEGORY_COMPLETION,
+		CATEGORY_COMPUTE,
+		CATEGORY_TEST
+	};
+
+	// Open span. Lives on stack of thread until End.
+	struct Span
+	{
+		const char* Name;	// nullptr if tracing is disabled.
+		UINT64 Start;
+		UINT Arg;
+		UINT Category;
+	};
+
+	struct TraceStats
+	{
+		UINT64 EventCount;			// Events written to file.
+		UINT64 DroppedEventCount;	// Oldest events overwritten in full ring.
+	};
+
+	// Ring of each thread. Holds most recent events when thread records more.
+	constexpr UINT g_threadEventCapacity = 64 * 1024;
+
+	constexpr UINT g_noArg = 0xFFFFFFFF;
+
+	// Enable tracing into filePath (Chrome trace JSON, also opened by Perfetto UI). nullptr disables.
+	// Not thread safe, call before threads start.
+	void Init(const char* filePath);
+
+	// Name of calling thread in trace. name must outlive Shutdown.
+	void SetThreadName(const char* name);
+
+	// name must outlive Shutdown. Only pointer is recorded, no formatting on hot path.
+	Span Begin(UINT category, const char* name, UINT arg = g_noArg);
+	void End(const Span& span);
+
+	// Write events of every thread and release rings. Call after threads are joined.
+	TraceStats Shutdown();
+}
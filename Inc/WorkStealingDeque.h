@@ -0,0 +1,90 @@
+#pragma once
+
+namespace ThreadSchedule
+{
+	// Fixed capacity Chase-Lev deque of tasks (C11 memory model version by Le et al.).
+	// Owner thread pushes/pops at bottom (LIFO), other threads steal at top (FIFO).
+	class WorkStealingDeque
+	{
+	public:
+		~WorkStealingDeque()
+		{
+			delete[] taskAry;
+		}
+
+		// Capacity is rounded up to power of 2. Not thread safe.
+		void Init(const UINT64 capacity)
+		{
+			UINT64 size = 2;
+			while (size < capacity)
+				size <<= 1;
+
+			delete[] taskAry;
+			taskAry = new std::atomic<UINT64>[size];
+			mask = size - 1;
+
+			top.store(0, std::memory_order_relaxed);
+			bottom.store(0, std::memory_order_relaxed);
+		}
+
+		// Owner only. Returns FALSE if deque is full.
+		BOOL Push(const UINT64 task)
+		{
+			const INT64 b = bottom.load(std::memory_order_relaxed);
+			const INT64 t = top.load(std::memory_order_acquire);
+
+			if (b - t > static_cast<INT64>(mask))
+				return FALSE;
+
+			taskAry[b & mask].store(task, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return TRUE;
+		}
+
+		// Owner only. Returns FALSE if deque is empty, or last task was stolen.
+		BOOL Pop(UINT64* task)
+		{
+			const INT64 b = bottom.load(std::memory_order_relaxed) - 1;
+			bottom.store(b, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			INT64 t = top.load(std::memory_order_relaxed);
+
+			if (t > b)
+			{
+				bottom.store(b + 1, std::memory_order_relaxed);
+				return FALSE;
+			}
+
+			*task = taskAry[b & mask].load(std::memory_order_relaxed);
+			if (t < b)
+				return TRUE;
+
+			// Last task. Race against thieves.
+			const BOOL won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return won;
+		}
+
+		// Any thread. Returns FALSE if deque is empty, or lost race with owner or other thief.
+		BOOL Steal(UINT64* task)
+		{
+			INT64 t = top.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const INT64 b = bottom.load(std::memory_order_acquire);
+
+			if (t >= b)
+				return FALSE;
+
+			*task = taskAry[t & mask].load(std::memory_order_relaxed);
+			return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		}
+
+	private:
+		std::atomic<UINT64>* taskAry = nullptr;
+		UINT64 mask = 0;
+
+		alignas(64) std::atomic<INT64> top;
+		alignas(64) std::atomic<INT64> bottom;
+	};
+}
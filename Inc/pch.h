@@ -2,25 +2,54 @@
 #define PCH_H
 
 #include <iostream>
-#include <windows.h>
 #include <random>
 #include <string>
 #include <unordered_map>
 #include <set>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <array>
+#include <coroutine>
+
+#ifdef _WIN32
+#include <windows.h>
 #include <Psapi.h>
+#else
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <time.h>
+
+// Windows type aliases, so shared headers can be used on Linux.
+typedef unsigned int UINT;
+typedef unsigned long long UINT64;
+typedef unsigned char BYTE;
+typedef int BOOL;
+typedef unsigned long DWORD;
+typedef size_t SIZE_T;
+typedef long long INT64;
 
-#ifdef _DEBUG
-#include "cvmarkersobj.h"
-#define SERIES_INIT(name) \
-	marker_series series(name)
-#define SPAN_INIT \
-	span* s = nullptr
-#define SPAN_START(cat, name, ...) \
-	s = new span(series, cat, name, __VA_ARGS__)
-#define SPAN_END \
-    delete s
+#ifndef TRUE
+#define TRUE 1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+#define INFINITE 0xFFFFFFFF
 #endif
 
+#ifdef _WIN32
 #define TIMER_INIT \
     LARGE_INTEGER freq; \
     LARGE_INTEGER st,en; \
@@ -41,5 +70,25 @@
 #define SAFE_CLOSE_HANDLE(h) if (h != INVALID_HANDLE_VALUE) CloseHandle(h)
 
 #define THROW_ERROR(msg) { MessageBox(NULL, msg, L"Critical Error", MB_OK | MB_ICONERROR | MB_SYSTEMMODAL); ExitProcess(-1); }
+#else
+#define TIMER_INIT \
+    timespec st,en; \
+    double el
+
+#define TIMER_START clock_gettime(CLOCK_MONOTONIC, &st)
+
+#define TIMER_STOP \
+    clock_gettime(CLOCK_MONOTONIC, &en); \
+    el=(en.tv_sec-st.tv_sec)+(en.tv_nsec-st.tv_nsec)/1e9
+
+#define TIMER_STOP_PRINT \
+    clock_gettime(CLOCK_MONOTONIC, &en); \
+    el=(en.tv_sec-st.tv_sec)+(en.tv_nsec-st.tv_nsec)/1e9; \
+    std::wcout<<el*1000<<L" ms\n"
+
+#define SAFE_CLOSE_FD(fd) if (fd >= 0) close(fd)
+
+#define THROW_ERROR(msg) { fwprintf(stderr, L"Critical Error: %ls (errno %d)\n", msg, errno); exit(-1); }
+#endif
 
-#endif // PCH_H
\ No newline at end of file
+#endif // PCH_H
@@ -0,0 +1,147 @@
+#include "pch.h"
+#include "ThreadSchedule.h"
+#include "Arrival.h"
+#include "Latency.h"
+
+#include <cmath>
+
+using namespace ThreadSchedule;
+using namespace Arrival;
+
+// Offset of each arrival from Start (ns).
+static std::vector<UINT64> g_offsetAry;
+static UINT64 g_startNanoSeconds;
+
+// Offset of arrival after last file, rounded up to whole period if BURSTY. Offered rate is counted over it.
+static UINT64 g_spanNanoSeconds;
+
+// Stats.
+static double g_postLagSum;
+static double g_maxPostLag;
+
+#ifdef _WIN32
+// Sleep has scheduler tick granularity (up to 15.6 ms). NULL if high resolution timer is unsupported.
+static HANDLE g_waitTimer;
+#endif
+
+// Sleep until GetNanoSeconds reaches dueNanoSeconds.
+static void SleepUntil(const UINT64 dueNanoSeconds)
+{
+	const UINT64 now = Latency::GetNanoSeconds();
+	if (now >= dueNanoSeconds)
+		return;
+
+#ifdef _WIN32
+	if (g_waitTimer != NULL)
+	{
+		// Negative is relative, in 100 ns.
+		LARGE_INTEGER dueTime;
+		dueTime.QuadPart = -static_cast<LONGLONG>((dueNanoSeconds - now + 99) / 100);
+		SetWaitableTimer(g_waitTimer, &dueTime, 0, NULL, NULL, FALSE);
+		WaitForSingleObject(g_waitTimer, INFINITE);
+	}
+	else
+	{
+		Sleep(static_cast<DWORD>((dueNanoSeconds - now + 999999) / 1000000));
+	}
+#else
+	// Same clock as Latency, so absolute sleep doesn't drift over test.
+	timespec due;
+	due.tv_sec = static_cast<time_t>(dueNanoSeconds / 1000000000ULL);
+	due.tv_nsec = static_cast<long>(dueNanoSeconds % 1000000000ULL);
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, nullptr) == EINTR);
+#endif
+}
+
+void Arrival::Init(const ArrivalType type, const UINT rate, const UINT fileCount, const UINT burstPeriodMicroSeconds, const UINT burstOnPercent)
+{
+	if (rate == 0)
+		THROW_ERROR(L"Arrival rate must be positive.");
+	if (type == ARRIVAL_BURSTY && (burstPeriodMicroSeconds == 0 || burstOnPercent == 0 || burstOnPercent > 100))
+		THROW_ERROR(L"Bursty arrival needs period > 0 and 0 < on percent <= 100.");
+
+	// One more arrival than files, to find span.
+	g_offsetAry.resize(fileCount + 1);
+	g_postLagSum = 0;
+	g_maxPostLag = 0;
+
+	std::mt19937_64 engine(g_arrivalSeed);
+
+	// BURSTY is Poisson on time line of on parts only, then spread over periods.
+	const double onRatio = type == ARRIVAL_BURSTY ? burstOnPercent / 100.0 : 1.0;
+	std::exponential_distribution<double> gapDistribution(rate / onRatio / 1e9);
+
+	double onTime = 0;
+	for (UINT i = 0; i <= fileCount; i++)
+	{
+		switch (type)
+		{
+		case ARRIVAL_FIXED:
+			g_offsetAry[i] = static_cast<UINT64>(i * 1e9 / rate);
+			break;
+
+		case ARRIVAL_POISSON:
+			g_offsetAry[i] = static_cast<UINT64>(onTime);
+			onTime += gapDistribution(engine);
+			break;
+
+		case ARRIVAL_BURSTY:
+		{
+			const double periodNanoSeconds = burstPeriodMicroSeconds * 1000.0;
+			const double onNanoSeconds = periodNanoSeconds * onRatio;
+			const double burstIndex = std::floor(onTime / onNanoSeconds);
+			g_offsetAry[i] = static_cast<UINT64>(burstIndex * periodNanoSeconds + (onTime - burstIndex * onNanoSeconds));
+			onTime += gapDistribution(engine);
+			break;
+		}
+		}
+	}
+
+	g_spanNanoSeconds = g_offsetAry[fileCount];
+	g_offsetAry.pop_back();
+
+	if (type == ARRIVAL_BURSTY)
+	{
+		const UINT64 periodNanoSeconds = burstPeriodMicroSeconds * 1000ULL;
+		g_spanNanoSeconds = (g_spanNanoSeconds + periodNanoSeconds - 1) / periodNanoSeconds * periodNanoSeconds;
+	}
+
+#ifdef _WIN32
+	if (g_waitTimer == NULL)
+		g_waitTimer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+#endif
+}
+
+void Arrival::Start()
+{
+	g_startNanoSeconds = Latency::GetNanoSeconds();
+}
+
+UINT64 Arrival::WaitArrival(const UINT index)
+{
+	const UINT64 dueNanoSeconds = g_startNanoSeconds + g_offsetAry[index];
+	SleepUntil(dueNanoSeconds);
+
+	const UINT64 now = Latency::GetNanoSeconds();
+	const double postLag = now > dueNanoSeconds ? (now - dueNanoSeconds) / 1000.0 : 0;
+	g_postLagSum += postLag;
+	g_maxPostLag = std::max<double>(g_maxPostLag, postLag);
+
+	return dueNanoSeconds;
+}
+
+ArrivalStats Arrival::Shutdown()
+{
+	ArrivalStats stats = { 0 };
+
+	const size_t fileCount = g_offsetAry.size();
+	if (g_spanNanoSeconds > 0)
+		stats.OfferedRate = fileCount * 1e9 / g_spanNanoSeconds;
+	if (fileCount > 0)
+		stats.MeanPostLag = g_postLagSum / fileCount;
+	stats.MaxPostLag = g_maxPostLag;
+
+	g_offsetAry.clear();
+
+	return stats;
+}
@@ -0,0 +1,316 @@
+#include "pch.h"
+#include "BufferPool.h"
+
+using namespace BufferPool;
+
+struct SharedFreeList
+{
+	std::mutex Lock;
+	std::vector<BYTE*> BufferAry;
+};
+
+// Arena. Pooled buffers are carved out of single reserved range,
+// so that Release can tell pooled buffer from direct one by address.
+static BYTE* g_arenaBase;
+static UINT64 g_arenaByteSize;
+static UINT64 g_arenaUsedByteSize;
+static BOOL g_arenaCommitted;
+static std::mutex g_arenaLock;
+static UINT g_generation = 1;
+
+static SharedFreeList g_sharedFreeListAry[g_classCount];
+
+// Stats.
+static std::atomic<UINT64> g_hitCount;
+static std::atomic<UINT64> g_missCount;
+static std::atomic<UINT64> g_directAllocCount;
+static std::atomic<UINT64> g_inUseByteSize;
+static std::atomic<UINT64> g_highWaterByteSize;
+
+static void PushShared(const UINT sizeClass, BYTE** bufferAry, const UINT count)
+{
+	SharedFreeList& freeList = g_sharedFreeListAry[sizeClass];
+
+	std::lock_guard<std::mutex> lock(freeList.Lock);
+	freeList.BufferAry.insert(freeList.BufferAry.end(), bufferAry, bufferAry + count);
+}
+
+struct ThreadCache
+{
+	UINT Generation = 0;
+	UINT CountAry[g_classCount] = { 0 };
+	BYTE* BufferAry[g_classCount][g_threadCacheCount];
+
+	// Buffers of previous arena must not be used.
+	void Validate()
+	{
+		if (Generation == g_generation)
+			return;
+
+		Generation = g_generation;
+		memset(CountAry, 0, sizeof(CountAry));
+	}
+
+	// Give cached buffers back when thread exits.
+	~ThreadCache()
+	{
+		if (Generation != g_generation || g_arenaBase == nullptr)
+			return;
+
+		for (UINT c = 0; c < g_classCount; c++)
+		{
+			if (CountAry[c] > 0)
+				PushShared(c, BufferAry[c], CountAry[c]);
+		}
+	}
+};
+
+static thread_local ThreadCache t_threadCache;
+
+static UINT64 GetClassByteSize(const UINT sizeClass)
+{
+	return g_minClassByteSize << sizeClass;
+}
+
+// Returns g_classCount if byteSize is larger than every class.
+static UINT GetSizeClass(const UINT64 byteSize)
+{
+	UINT sizeClass = 0;
+	while (sizeClass < g_classCount && GetClassByteSize(sizeClass) < byteSize)
+		sizeClass++;
+
+	return sizeClass;
+}
+
+static void AddInUse(const UINT64 byteSize)
+{
+	const UINT64 inUse = g_inUseByteSize.fetch_add(byteSize) + byteSize;
+
+	UINT64 highWater = g_highWaterByteSize.load(std::memory_order_relaxed);
+	while (inUse > highWater && FALSE == g_highWaterByteSize.compare_exchange_weak(highWater, inUse))
+	{
+	}
+}
+
+static BYTE* AllocateDirect(const UINT64 byteSize)
+{
+#ifdef _WIN32
+	return static_cast<BYTE*>(VirtualAlloc(NULL, byteSize, MEM_COMMIT, PAGE_READWRITE));
+#else
+	BYTE* buffer = nullptr;
+	if (0 != posix_memalign(reinterpret_cast<void**>(&buffer), g_minClassByteSize, byteSize))
+		return nullptr;
+	return buffer;
+#endif
+}
+
+static void FreeDirect(BYTE* buffer)
+{
+#ifdef _WIN32
+	VirtualFree(buffer, 0, MEM_RELEASE);
+#else
+	free(buffer);
+#endif
+}
+
+static BOOL IsArenaBuffer(const BYTE* buffer)
+{
+	return g_arenaBase != nullptr && g_arenaBase <= buffer && buffer < g_arenaBase + g_arenaByteSize;
+}
+
+// Carve new slab out of arena. First buffer is returned, others go to shared free list.
+static BYTE* CarveSlab(const UINT sizeClass)
+{
+	const UINT64 classByteSize = GetClassByteSize(sizeClass);
+	const UINT64 slabByteSize = classByteSize > g_slabByteSize ? classByteSize : g_slabByteSize;
+
+	BYTE* slab = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(g_arenaLock);
+		if (g_arenaBase == nullptr || g_arenaUsedByteSize + slabByteSize > g_arenaByteSize)
+			return nullptr;
+
+		slab = g_arenaBase + g_arenaUsedByteSize;
+		g_arenaUsedByteSize += slabByteSize;
+	}
+
+#ifdef _WIN32
+	if (FALSE == g_arenaCommitted && NULL == VirtualAlloc(slab, slabByteSize, MEM_COMMIT, PAGE_READWRITE))
+		return nullptr;
+#endif
+
+	const UINT64 bufferCount = slabByteSize / classByteSize;
+	if (bufferCount > 1)
+	{
+		std::vector<BYTE*> restAry;
+		restAry.reserve(bufferCount - 1);
+		for (UINT64 i = 1; i < bufferCount; i++)
+			restAry.push_back(slab + i * classByteSize);
+
+		PushShared(sizeClass, restAry.data(), static_cast<UINT>(restAry.size()));
+	}
+
+	return slab;
+}
+
+void BufferPool::Init(const UINT64 byteCap, const BOOL preTouch)
+{
+	g_hitCount = 0;
+	g_missCount = 0;
+	g_directAllocCount = 0;
+	g_inUseByteSize = 0;
+	g_highWaterByteSize = 0;
+
+	g_arenaByteSize = (byteCap + g_slabByteSize - 1) / g_slabByteSize * g_slabByteSize;
+	g_arenaUsedByteSize = 0;
+	g_arenaCommitted = FALSE;
+	g_arenaBase = nullptr;
+
+	if (g_arenaByteSize == 0)
+		return;
+
+#ifdef _WIN32
+	g_arenaBase = static_cast<BYTE*>(VirtualAlloc(NULL, g_arenaByteSize, preTouch ? MEM_RESERVE | MEM_COMMIT : MEM_RESERVE, PAGE_READWRITE));
+	if (g_arenaBase == NULL)
+		THROW_ERROR(L"Failed to reserve buffer pool.");
+	g_arenaCommitted = preTouch;
+#else
+	void* arena = mmap(NULL, g_arenaByteSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (arena == MAP_FAILED)
+		THROW_ERROR(L"Failed to reserve buffer pool.");
+	g_arenaBase = static_cast<BYTE*>(arena);
+#endif
+
+	// Take page faults (and zeroing) now, not on hot path.
+	if (preTouch)
+	{
+		for (UINT64 offset = 0; offset < g_arenaByteSize; offset += g_minClassByteSize)
+			g_arenaBase[offset] = 0;
+	}
+}
+
+BYTE* BufferPool::Acquire(const UINT64 byteSize)
+{
+	const UINT sizeClass = GetSizeClass(byteSize);
+
+	// Too large for any class.
+	if (sizeClass == g_classCount)
+	{
+		const UINT64 directByteSize = (byteSize + g_minClassByteSize - 1) / g_minClassByteSize * g_minClassByteSize;
+
+		g_missCount++;
+		g_directAllocCount++;
+		AddInUse(directByteSize);
+		return AllocateDirect(directByteSize);
+	}
+
+	const UINT64 classByteSize = GetClassByteSize(sizeClass);
+	AddInUse(classByteSize);
+
+	// 1. Thread cache.
+	ThreadCache& cache = t_threadCache;
+	cache.Validate();
+
+	if (cache.CountAry[sizeClass] > 0)
+	{
+		g_hitCount++;
+		return cache.BufferAry[sizeClass][--cache.CountAry[sizeClass]];
+	}
+
+	// 2. Shared free list. Refill half of thread cache at once.
+	{
+		SharedFreeList& freeList = g_sharedFreeListAry[sizeClass];
+
+		std::lock_guard<std::mutex> lock(freeList.Lock);
+		if (FALSE == freeList.BufferAry.empty())
+		{
+			BYTE* buffer = freeList.BufferAry.back();
+			freeList.BufferAry.pop_back();
+
+			while (cache.CountAry[sizeClass] < g_threadCacheCount / 2 && FALSE == freeList.BufferAry.empty())
+			{
+				cache.BufferAry[sizeClass][cache.CountAry[sizeClass]++] = freeList.BufferAry.back();
+				freeList.BufferAry.pop_back();
+			}
+
+			g_hitCount++;
+			return buffer;
+		}
+	}
+
+	// 3. New slab, or OS if arena is exhausted.
+	g_missCount++;
+
+	BYTE* buffer = CarveSlab(sizeClass);
+	if (buffer == nullptr)
+	{
+		g_directAllocCount++;
+		buffer = AllocateDirect(classByteSize);
+	}
+
+	return buffer;
+}
+
+void BufferPool::Release(BYTE* buffer, const UINT64 byteSize)
+{
+	if (buffer == nullptr)
+		return;
+
+	const UINT sizeClass = GetSizeClass(byteSize);
+
+	if (sizeClass == g_classCount)
+		g_inUseByteSize -= (byteSize + g_minClassByteSize - 1) / g_minClassByteSize * g_minClassByteSize;
+	else
+		g_inUseByteSize -= GetClassByteSize(sizeClass);
+
+	if (FALSE == IsArenaBuffer(buffer))
+	{
+		FreeDirect(buffer);
+		return;
+	}
+
+	ThreadCache& cache = t_threadCache;
+	cache.Validate();
+
+	// Thread cache is full. Move half to shared free list.
+	if (cache.CountAry[sizeClass] == g_threadCacheCount)
+	{
+		constexpr UINT moveCount = g_threadCacheCount / 2;
+
+		cache.CountAry[sizeClass] -= moveCount;
+		PushShared(sizeClass, &cache.BufferAry[sizeClass][cache.CountAry[sizeClass]], moveCount);
+	}
+
+	cache.BufferAry[sizeClass][cache.CountAry[sizeClass]++] = buffer;
+}
+
+BufferPoolStats BufferPool::Shutdown()
+{
+	for (UINT c = 0; c < g_classCount; c++)
+	{
+		std::lock_guard<std::mutex> lock(g_sharedFreeListAry[c].Lock);
+		g_sharedFreeListAry[c].BufferAry.clear();
+	}
+
+	if (g_arenaBase != nullptr)
+	{
+#ifdef _WIN32
+		VirtualFree(g_arenaBase, 0, MEM_RELEASE);
+#else
+		munmap(g_arenaBase, g_arenaByteSize);
+#endif
+	}
+
+	g_arenaBase = nullptr;
+	g_arenaByteSize = 0;
+	g_arenaUsedByteSize = 0;
+	g_generation++;
+
+	BufferPoolStats stats;
+	stats.HitCount = g_hitCount;
+	stats.MissCount = g_missCount;
+	stats.DirectAllocCount = g_directAllocCount;
+	stats.HighWaterByteSize = g_highWaterByteSize;
+
+	return stats;
+}
@@ -0,0 +1,219 @@
+#include "pch.h"
+#include "ThreadSchedule.h"
+#include "ComputeKernel.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define COMPUTE_KERNEL_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC emits any intrinsic without flags. GCC/Clang need target per function.
+#if defined(COMPUTE_KERNEL_X86) && !defined(_MSC_VER)
+#define KERNEL_TARGET(isa) __attribute__((target(isa)))
+#else
+#define KERNEL_TARGET(isa)
+#endif
+
+using namespace ThreadSchedule;
+
+typedef UINT64(*ByteSumFunc)(const BYTE*, UINT64);
+
+static UINT64 ByteSumScalar(const BYTE* data, const UINT64 byteSize)
+{
+	UINT64 sum = 0;
+	for (UINT64 i = 0; i < byteSize; i++)
+		sum += data[i];
+
+	return sum;
+}
+
+#ifdef COMPUTE_KERNEL_X86
+// _mm_sad_epu8 against zero sums 8 bytes into each 64-bit lane, so accumulators never overflow.
+KERNEL_TARGET("sse2")
+static UINT64 ByteSumSSE2(const BYTE* data, const UINT64 byteSize)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i acc0 = _mm_setzero_si128();
+	__m128i acc1 = _mm_setzero_si128();
+
+	UINT64 i = 0;
+	for (; i + 32 <= byteSize; i += 32)
+	{
+		acc0 = _mm_add_epi64(acc0, _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)), zero));
+		acc1 = _mm_add_epi64(acc1, _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 16)), zero));
+	}
+
+	acc0 = _mm_add_epi64(acc0, acc1);
+	acc0 = _mm_add_epi64(acc0, _mm_unpackhi_epi64(acc0, acc0));
+
+	return static_cast<UINT64>(_mm_cvtsi128_si64(acc0)) + ByteSumScalar(data + i, byteSize - i);
+}
+
+KERNEL_TARGET("avx2")
+static UINT64 ByteSumAVX2(const BYTE* data, const UINT64 byteSize)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i acc0 = _mm256_setzero_si256();
+	__m256i acc1 = _mm256_setzero_si256();
+
+	UINT64 i = 0;
+	for (; i + 64 <= byteSize; i += 64)
+	{
+		acc0 = _mm256_add_epi64(acc0, _mm256_sad_epu8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)), zero));
+		acc1 = _mm256_add_epi64(acc1, _mm256_sad_epu8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 32)), zero));
+	}
+
+	acc0 = _mm256_add_epi64(acc0, acc1);
+	__m128i acc = _mm_add_epi64(_mm256_castsi256_si128(acc0), _mm256_extracti128_si256(acc0, 1));
+	acc = _mm_add_epi64(acc, _mm_unpackhi_epi64(acc, acc));
+
+	return static_cast<UINT64>(_mm_cvtsi128_si64(acc)) + ByteSumScalar(data + i, byteSize - i);
+}
+
+KERNEL_TARGET("avx512f,avx512bw")
+static UINT64 ByteSumAVX512(const BYTE* data, const UINT64 byteSize)
+{
+	const __m512i zero = _mm512_setzero_si512();
+	__m512i acc0 = _mm512_setzero_si512();
+	__m512i acc1 = _mm512_setzero_si512();
+
+	UINT64 i = 0;
+	for (; i + 128 <= byteSize; i += 128)
+	{
+		acc0 = _mm512_add_epi64(acc0, _mm512_sad_epu8(_mm512_loadu_si512(data + i), zero));
+		acc1 = _mm512_add_epi64(acc1, _mm512_sad_epu8(_mm512_loadu_si512(data + i + 64), zero));
+	}
+
+	// Masked load for tail, so no scalar loop is needed.
+	for (; i < byteSize; i += 64)
+	{
+		const UINT64 restByteSize = byteSize - i;
+		const __mmask64 mask = restByteSize >= 64 ? ~0ULL : (1ULL << restByteSize) - 1;
+		acc0 = _mm512_add_epi64(acc0, _mm512_sad_epu8(_mm512_maskz_loadu_epi8(mask, data + i), zero));
+	}
+
+	alignas(64) UINT64 laneAry[8];
+	_mm512_store_si512(laneAry, _mm512_add_epi64(acc0, acc1));
+
+	UINT64 sum = 0;
+	for (UINT lane = 0; lane < 8; lane++)
+		sum += laneAry[lane];
+
+	return sum;
+}
+
+#ifdef _MSC_VER
+static BOOL IsCpuSupported(const ComputeKernelType kernel)
+{
+	int info[4];
+
+	__cpuid(info, 0);
+	const int maxLeaf = info[0];
+
+	__cpuid(info, 1);
+	const BOOL hasSSE2 = (info[3] >> 26) & 1;
+	const BOOL hasOSXSAVE = (info[2] >> 27) & 1;
+
+	if (kernel == COMPUTE_KERNEL_SSE2)
+		return hasSSE2;
+
+	// OS must save YMM (and ZMM) state.
+	if (FALSE == hasOSXSAVE || maxLeaf < 7)
+		return FALSE;
+
+	const UINT64 xcr0 = _xgetbv(0);
+
+	__cpuidex(info, 7, 0);
+	if (kernel == COMPUTE_KERNEL_AVX2)
+		return ((xcr0 & 0x6) == 0x6) && ((info[1] >> 5) & 1);
+
+	if (kernel == COMPUTE_KERNEL_AVX512)
+		return ((xcr0 & 0xE6) == 0xE6) && ((info[1] >> 16) & 1) && ((info[1] >> 30) & 1);
+
+	return FALSE;
+}
+#else
+static BOOL IsCpuSupported(const ComputeKernelType kernel)
+{
+	// Also checks OS support (XCR0).
+	__builtin_cpu_init();
+
+	switch (kernel)
+	{
+	case COMPUTE_KERNEL_SSE2:
+		return __builtin_cpu_supports("sse2");
+	case COMPUTE_KERNEL_AVX2:
+		return __builtin_cpu_supports("avx2");
+	case COMPUTE_KERNEL_AVX512:
+		return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+	default:
+		return FALSE;
+	}
+}
+#endif
+#endif
+
+static ByteSumFunc g_byteSumFunc = ByteSumScalar;
+
+BOOL ComputeKernel::IsSupported(const ComputeKernelType kernel)
+{
+	if (kernel == COMPUTE_KERNEL_SCALAR)
+		return TRUE;
+
+#ifdef COMPUTE_KERNEL_X86
+	return IsCpuSupported(kernel);
+#else
+	return FALSE;
+#endif
+}
+
+ComputeKernelType ComputeKernel::Init(const ComputeKernelType kernel)
+{
+	// Walk down from requested (or widest) kernel until CPU supports it.
+	ComputeKernelType selected = kernel == COMPUTE_KERNEL_AUTO ? COMPUTE_KERNEL_AVX512 : kernel;
+	while (selected != COMPUTE_KERNEL_SCALAR && FALSE == IsSupported(selected))
+		selected = static_cast<ComputeKernelType>(selected - 1);
+
+	switch (selected)
+	{
+#ifdef COMPUTE_KERNEL_X86
+	case COMPUTE_KERNEL_SSE2:
+		g_byteSumFunc = ByteSumSSE2;
+		break;
+	case COMPUTE_KERNEL_AVX2:
+		g_byteSumFunc = ByteSumAVX2;
+		break;
+	case COMPUTE_KERNEL_AVX512:
+		g_byteSumFunc = ByteSumAVX512;
+		break;
+#endif
+	default:
+		g_byteSumFunc = ByteSumScalar;
+		break;
+	}
+
+	return selected;
+}
+
+UINT64 ComputeKernel::ByteSum(const BYTE* data, const UINT64 byteSize)
+{
+	return g_byteSumFunc(data, byteSize);
+}
+
+int ComputeKernel::FoldChecksum(const int sum)
+{
+	int checkSum = sum;
+	checkSum = checkSum & 0xFF;
+	checkSum = ~checkSum + 1;
+
+	const int res = checkSum + sum;
+	return res & 0xFF;
+}
+
+int ComputeKernel::Checksum(const BYTE* data, const UINT64 byteSize)
+{
+	return FoldChecksum(static_cast<int>(ByteSum(data, byteSize)));
+}
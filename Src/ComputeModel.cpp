@@ -0,0 +1,202 @@
+#include "pch.h"
+#include "ThreadSchedule.h"
+#include "ComputeKernel.h"
+#include "ComputeModel.h"
+
+using namespace ThreadSchedule;
+using namespace ComputeModel;
+
+// One cache line per entry, so that every hop of pointer chase touches new line.
+struct alignas(64) ThrashLine
+{
+	UINT Next;
+};
+
+static ComputeProfileType g_profile;
+static double g_unitsPerMicroSecond;
+
+// Calibration result lands here, so that it can't be optimized away.
+static volatile UINT64 g_calibrationSink;
+
+static ThrashLine* g_thrashTable;
+static UINT g_thrashLineCount;
+
+// Stats.
+static std::atomic<UINT64> g_runCount;
+static std::atomic<INT64> g_overshootNanoSeconds;
+static std::atomic<UINT64> g_timerCheckCount;
+
+// ALU unit. Dependent multiply / xor-shift chain, stays in registers.
+static UINT64 DoAluUnits(const UINT64 unitCount, UINT64 state)
+{
+	for (UINT64 u = 0; u < unitCount; u++)
+	{
+		for (UINT i = 0; i < 256; i++)
+		{
+			state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+			state ^= state >> 29;
+		}
+	}
+
+	return state;
+}
+
+// MEMORY_STREAM unit. Sums next g_streamUnitByteSize bytes of buffer, wraps around at end.
+static UINT64 DoStreamUnits(const UINT64 unitCount, const BYTE* buffer, const UINT64 byteSize, UINT64* cursor)
+{
+	if (byteSize == 0)
+		return DoAluUnits(unitCount, 1);
+
+	UINT64 sum = 0;
+	for (UINT64 u = 0; u < unitCount; u++)
+	{
+		const UINT64 chunkByteSize = std::min<UINT64>(g_streamUnitByteSize, byteSize - *cursor);
+		sum += ComputeKernel::ByteSum(buffer + *cursor, chunkByteSize);
+
+		*cursor += chunkByteSize;
+		if (*cursor >= byteSize)
+			*cursor = 0;
+	}
+
+	return sum;
+}
+
+// CACHE_THRASH unit. 64 dependent loads over table larger than LLC.
+static UINT64 DoThrashUnits(const UINT64 unitCount)
+{
+	// Each thread walks from its own position of the cycle.
+	static thread_local UINT t_cursor = static_cast<UINT>(std::hash<std::thread::id>()(std::this_thread::get_id()) % g_thrashLineCount);
+
+	UINT cursor = t_cursor;
+	for (UINT64 u = 0; u < unitCount; u++)
+	{
+		for (UINT i = 0; i < 64; i++)
+			cursor = g_thrashTable[cursor].Next;
+	}
+
+	t_cursor = cursor;
+	return cursor;
+}
+
+static UINT64 DoUnits(const UINT64 unitCount, const BYTE* buffer, const UINT64 byteSize, UINT64* cursor)
+{
+	switch (g_profile)
+	{
+	case COMPUTE_PROFILE_ALU:
+		return DoAluUnits(unitCount, unitCount);
+	case COMPUTE_PROFILE_CACHE_THRASH:
+		return DoThrashUnits(unitCount);
+	case COMPUTE_PROFILE_MIXED:
+		// One unit of each kind.
+		return DoAluUnits(unitCount, unitCount) + DoStreamUnits(unitCount, buffer, byteSize, cursor) + DoThrashUnits(unitCount);
+	default:
+		return DoStreamUnits(unitCount, buffer, byteSize, cursor);
+	}
+}
+
+// Single random cycle over every line (Sattolo), so that chase never falls into short loop.
+static void BuildThrashTable()
+{
+	g_thrashLineCount = static_cast<UINT>(g_thrashTableByteSize / sizeof(ThrashLine));
+	g_thrashTable = new ThrashLine[g_thrashLineCount];
+
+	std::vector<UINT> orderAry(g_thrashLineCount);
+	for (UINT i = 0; i < g_thrashLineCount; i++)
+		orderAry[i] = i;
+
+	std::mt19937 engine(0);
+	for (UINT i = g_thrashLineCount - 1; i > 0; i--)
+	{
+		std::uniform_int_distribution<UINT> dist(0, i - 1);
+		std::swap(orderAry[i], orderAry[dist(engine)]);
+	}
+
+	for (UINT i = 0; i < g_thrashLineCount; i++)
+		g_thrashTable[orderAry[i]].Next = orderAry[(i + 1) % g_thrashLineCount];
+}
+
+void ComputeModel::Init(const ComputeProfileType profile)
+{
+	g_profile = profile;
+	g_runCount = 0;
+	g_overshootNanoSeconds = 0;
+	g_timerCheckCount = 0;
+
+	if ((profile == COMPUTE_PROFILE_CACHE_THRASH || profile == COMPUTE_PROFILE_MIXED) && g_thrashTable == nullptr)
+		BuildThrashTable();
+
+	std::vector<BYTE> calibrationBuffer(g_calibrationByteSize);
+	std::mt19937 engine(0);
+	for (UINT64 i = 0; i < g_calibrationByteSize; i++)
+		calibrationBuffer[i] = static_cast<BYTE>(engine());
+
+	// Warm up, then double batch until calibration time is covered.
+	UINT64 cursor = 0;
+	g_calibrationSink = DoUnits(16, calibrationBuffer.data(), g_calibrationByteSize, &cursor);
+
+	UINT64 unitCount = 0;
+	UINT64 batchUnitCount = 16;
+	double elapsedMicroSeconds = 0;
+
+	TIMER_INIT;
+	TIMER_START;
+
+	while (elapsedMicroSeconds < g_calibrationMicroSeconds)
+	{
+		g_calibrationSink = DoUnits(batchUnitCount, calibrationBuffer.data(), g_calibrationByteSize, &cursor);
+		unitCount += batchUnitCount;
+		batchUnitCount *= 2;
+
+		TIMER_STOP;
+		elapsedMicroSeconds = el * 1000 * 1000;
+	}
+
+	g_unitsPerMicroSecond = unitCount / elapsedMicroSeconds;
+}
+
+int ComputeModel::Run(const BYTE* buffer, const UINT64 byteSize, const double targetMicroSeconds)
+{
+	TIMER_INIT;
+	TIMER_START;
+
+	UINT64 sum = 0;
+	UINT64 cursor = 0;
+	UINT64 timerCheckCount = 0;
+	double elapsedMicroSeconds = 0;
+
+	// Each batch is sized to end at next check point, or at target if it comes first.
+	while (elapsedMicroSeconds < targetMicroSeconds)
+	{
+		const double batchMicroSeconds = std::min<double>(targetMicroSeconds - elapsedMicroSeconds, g_checkIntervalMicroSeconds);
+		const UINT64 batchUnitCount = std::max<UINT64>(1, static_cast<UINT64>(batchMicroSeconds * g_unitsPerMicroSecond));
+
+		sum += DoUnits(batchUnitCount, buffer, byteSize, &cursor);
+
+		TIMER_STOP;
+		elapsedMicroSeconds = el * 1000 * 1000;
+		timerCheckCount++;
+	}
+
+	g_runCount.fetch_add(1, std::memory_order_relaxed);
+	g_overshootNanoSeconds.fetch_add(static_cast<INT64>((elapsedMicroSeconds - targetMicroSeconds) * 1000), std::memory_order_relaxed);
+	g_timerCheckCount.fetch_add(timerCheckCount, std::memory_order_relaxed);
+
+	return ComputeKernel::FoldChecksum(static_cast<int>(sum));
+}
+
+ComputeModelStats ComputeModel::Shutdown()
+{
+	delete[] g_thrashTable;
+	g_thrashTable = nullptr;
+
+	ComputeModelStats stats = { 0 };
+	stats.UnitsPerMicroSecond = g_unitsPerMicroSecond;
+
+	if (g_runCount > 0)
+	{
+		stats.MeanOvershoot = g_overshootNanoSeconds / 1000.0 / g_runCount;
+		stats.MeanTimerCheckCount = static_cast<double>(g_timerCheckCount) / g_runCount;
+	}
+
+	return stats;
+}
@@ -0,0 +1,206 @@
+#include "pch.h"
+#include "Coroutine.h"
+
+using namespace Coroutine;
+
+struct SharedFreeList
+{
+	std::mutex Lock;
+	std::vector<void*> FrameAry;
+};
+
+// Slabs live until Shutdown. Frames are never given back to OS one by one.
+static std::vector<BYTE*> g_slabAry;
+static std::mutex g_slabLock;
+static UINT g_generation = 1;
+
+static SharedFreeList g_sharedFreeListAry[g_frameClassCount];
+
+// Stats.
+static std::atomic<UINT64> g_frameByteSize;
+static std::atomic<UINT64> g_frameCount;
+static std::atomic<UINT64> g_liveFrameCount;
+static std::atomic<UINT64> g_peakFrameCount;
+static std::atomic<UINT64> g_heapFrameCount;
+
+static void PushShared(const UINT frameClass, void** frameAry, const UINT count)
+{
+	SharedFreeList& freeList = g_sharedFreeListAry[frameClass];
+
+	std::lock_guard<std::mutex> lock(freeList.Lock);
+	freeList.FrameAry.insert(freeList.FrameAry.end(), frameAry, frameAry + count);
+}
+
+struct FrameThreadCache
+{
+	UINT Generation = 0;
+	UINT CountAry[g_frameClassCount] = { 0 };
+	void* FrameAry[g_frameClassCount][g_frameThreadCacheCount];
+
+	// Frames of previous slabs must not be used.
+	void Validate()
+	{
+		if (Generation == g_generation)
+			return;
+
+		Generation = g_generation;
+		memset(CountAry, 0, sizeof(CountAry));
+	}
+
+	// Give cached frames back when thread exits.
+	~FrameThreadCache()
+	{
+		if (Generation != g_generation)
+			return;
+
+		for (UINT c = 0; c < g_frameClassCount; c++)
+		{
+			if (CountAry[c] > 0)
+				PushShared(c, FrameAry[c], CountAry[c]);
+		}
+	}
+};
+
+static thread_local FrameThreadCache t_frameThreadCache;
+
+static UINT64 GetClassByteSize(const UINT frameClass)
+{
+	return g_frameClassByteSize * (frameClass + 1);
+}
+
+// Returns g_frameClassCount if byteSize is larger than every class.
+static UINT GetFrameClass(const size_t byteSize)
+{
+	const UINT64 frameClass = (byteSize + g_frameClassByteSize - 1) / g_frameClassByteSize;
+	return frameClass == 0 ? 0 : (frameClass > g_frameClassCount ? g_frameClassCount : static_cast<UINT>(frameClass - 1));
+}
+
+static void AddLive()
+{
+	g_frameCount.fetch_add(1, std::memory_order_relaxed);
+	const UINT64 liveCount = g_liveFrameCount.fetch_add(1, std::memory_order_relaxed) + 1;
+
+	UINT64 peakCount = g_peakFrameCount.load(std::memory_order_relaxed);
+	while (liveCount > peakCount && FALSE == g_peakFrameCount.compare_exchange_weak(peakCount, liveCount, std::memory_order_relaxed))
+	{
+	}
+}
+
+// Move half of thread cache worth of frames from shared free list, carving new slab if it is empty.
+static void Refill(const UINT frameClass, FrameThreadCache& cache)
+{
+	SharedFreeList& freeList = g_sharedFreeListAry[frameClass];
+	const UINT refillCount = g_frameThreadCacheCount / 2;
+
+	std::lock_guard<std::mutex> lock(freeList.Lock);
+
+	if (freeList.FrameAry.empty())
+	{
+		BYTE* slab = static_cast<BYTE*>(malloc(g_frameSlabByteSize));
+		if (slab == nullptr)
+			THROW_ERROR(L"Failed to allocate coroutine frame slab.");
+
+		{
+			std::lock_guard<std::mutex> slabLock(g_slabLock);
+			g_slabAry.push_back(slab);
+		}
+
+		// Pushed in reverse, so frames are handed out in address order.
+		const UINT64 classByteSize = GetClassByteSize(frameClass);
+		for (UINT64 i = g_frameSlabByteSize / classByteSize; i-- > 0;)
+			freeList.FrameAry.push_back(slab + i * classByteSize);
+	}
+
+	const UINT moveCount = static_cast<UINT>(std::min<size_t>(refillCount, freeList.FrameAry.size()));
+	memcpy(cache.FrameAry[frameClass], freeList.FrameAry.data() + freeList.FrameAry.size() - moveCount, moveCount * sizeof(void*));
+	freeList.FrameAry.resize(freeList.FrameAry.size() - moveCount);
+	cache.CountAry[frameClass] = moveCount;
+}
+
+void Coroutine::Init()
+{
+	g_frameByteSize = 0;
+	g_frameCount = 0;
+	g_liveFrameCount = 0;
+	g_peakFrameCount = 0;
+	g_heapFrameCount = 0;
+}
+
+void* Coroutine::AllocateFrame(const size_t byteSize)
+{
+	UINT64 frameByteSize = g_frameByteSize.load(std::memory_order_relaxed);
+	while (byteSize > frameByteSize && FALSE == g_frameByteSize.compare_exchange_weak(frameByteSize, byteSize, std::memory_order_relaxed))
+	{
+	}
+
+	AddLive();
+
+	const UINT frameClass = GetFrameClass(byteSize);
+	if (frameClass == g_frameClassCount)
+	{
+		g_heapFrameCount.fetch_add(1, std::memory_order_relaxed);
+		return ::operator new(byteSize);
+	}
+
+	FrameThreadCache& cache = t_frameThreadCache;
+	cache.Validate();
+
+	if (cache.CountAry[frameClass] == 0)
+		Refill(frameClass, cache);
+
+	return cache.FrameAry[frameClass][--cache.CountAry[frameClass]];
+}
+
+void Coroutine::FreeFrame(void* frame, const size_t byteSize)
+{
+	g_liveFrameCount.fetch_sub(1, std::memory_order_relaxed);
+
+	const UINT frameClass = GetFrameClass(byteSize);
+	if (frameClass == g_frameClassCount)
+	{
+		::operator delete(frame);
+		return;
+	}
+
+	FrameThreadCache& cache = t_frameThreadCache;
+	cache.Validate();
+
+	// Thread cache is full. Give older half to shared free list.
+	if (cache.CountAry[frameClass] == g_frameThreadCacheCount)
+	{
+		const UINT half = g_frameThreadCacheCount / 2;
+		PushShared(frameClass, cache.FrameAry[frameClass], half);
+		memmove(cache.FrameAry[frameClass], cache.FrameAry[frameClass] + half, (g_frameThreadCacheCount - half) * sizeof(void*));
+		cache.CountAry[frameClass] -= half;
+	}
+
+	cache.FrameAry[frameClass][cache.CountAry[frameClass]++] = frame;
+}
+
+FramePoolStats Coroutine::Shutdown()
+{
+	FramePoolStats stats = { 0 };
+	stats.FrameByteSize = g_frameByteSize;
+	stats.FrameCount = g_frameCount;
+	stats.PeakFrameCount = g_peakFrameCount;
+	stats.SlabByteSize = g_slabAry.size() * g_frameSlabByteSize;
+	stats.HeapFrameCount = g_heapFrameCount;
+
+	if (g_liveFrameCount != 0)
+		THROW_ERROR(L"Coroutine frame is still alive.");
+
+	for (BYTE* slab : g_slabAry)
+		free(slab);
+	g_slabAry.clear();
+
+	for (UINT c = 0; c < g_frameClassCount; c++)
+	{
+		g_sharedFreeListAry[c].FrameAry.clear();
+		g_sharedFreeListAry[c].FrameAry.shrink_to_fit();
+	}
+
+	// Cached frames of living threads point into released slabs.
+	g_generation++;
+
+	return stats;
+}
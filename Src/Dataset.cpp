@@ -0,0 +1,94 @@
+#include "pch.h"
+#include "ThreadSchedule.h"
+#include "Dataset.h"
+
+#include <fstream>
+
+using namespace Dataset;
+using namespace ThreadSchedule;
+
+static std::vector<ManifestEntry> g_entryAry;
+
+void Dataset::LoadManifest(const UINT fileCount)
+{
+	std::ifstream file(g_manifestPath, std::ios::in | std::ios::binary);
+	if (FALSE == file.is_open())
+		THROW_ERROR(L"Failed to open dataset manifest.");
+
+	ManifestHeader header;
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (FALSE == file.good() || header.Magic != g_manifestMagic)
+		THROW_ERROR(L"Dataset manifest is broken.");
+
+	if (header.FileCount < fileCount)
+		THROW_ERROR(L"Dataset manifest has fewer files than test file count.");
+
+	// Later entries are not read by this test.
+	g_entryAry.resize(fileCount);
+	file.read(reinterpret_cast<char*>(g_entryAry.data()), sizeof(ManifestEntry) * fileCount);
+	if (FALSE == file.good())
+		THROW_ERROR(L"Dataset manifest is broken.");
+}
+
+const ManifestEntry& Dataset::GetEntry(const UINT fid)
+{
+	return g_entryAry[fid];
+}
+
+void Dataset::WriteManifest(const std::vector<ManifestEntry>& entryAry)
+{
+	std::ofstream file(g_manifestPath, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (FALSE == file.is_open())
+		THROW_ERROR(L"Failed to open dataset manifest.");
+
+	const ManifestHeader header = { g_manifestMagic, entryAry.size() };
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(entryAry.data()), sizeof(ManifestEntry) * entryAry.size());
+
+	if (FALSE == file.good())
+		THROW_ERROR(L"Failed to write dataset manifest.");
+}
+
+void Dataset::UnloadManifest()
+{
+	g_entryAry.clear();
+	g_entryAry.shrink_to_fit();
+}
+
+std::vector<UINT> Dataset::GetPostOrder(const UINT fileCount, const PostOrderType order, const BOOL byComputeTime)
+{
+	std::vector<UINT> fidAry(fileCount);
+	for (UINT fid = 0; fid < fileCount; fid++)
+		fidAry[fid] = fid;
+
+	if (order == POST_ORDER_FIFO)
+		return fidAry;
+
+	auto getCost = [byComputeTime](const UINT fid)
+	{
+		return byComputeTime ? g_entryAry[fid].ComputeMicroSeconds : g_entryAry[fid].ByteSize;
+	};
+
+	// Stable, so files of same cost keep FID order.
+	if (order == POST_ORDER_SPT)
+	{
+		// Smallest first.
+		std::stable_sort(fidAry.begin(), fidAry.end(), [&](const UINT a, const UINT b) { return getCost(a) < getCost(b); });
+		return fidAry;
+	}
+
+	// Largest first.
+	std::stable_sort(fidAry.begin(), fidAry.end(), [&](const UINT a, const UINT b) { return getCost(a) > getCost(b); });
+
+	if (order == POST_ORDER_INTERLEAVED)
+	{
+		// Largest, smallest, second largest, second smallest, ...
+		std::vector<UINT> sortedAry;
+		sortedAry.swap(fidAry);
+
+		for (UINT i = 0; i < fileCount; i++)
+			fidAry.push_back(i % 2 == 0 ? sortedAry[i / 2] : sortedAry[fileCount - 1 - i / 2]);
+	}
+
+	return fidAry;
+}
@@ -1,44 +1,359 @@
 #include "pch.h"
+#include "ThreadSchedule.h"
+#include "Dataset.h"
 #include "FileGenerator.h"
 
-void FileGenerator::GenerateDummyFiles(const FileGenerationArgs args)
+#ifdef __linux__
+#include "IoUring.h"
+#endif
+
+using namespace FileGenerator;
+
+#ifdef _WIN32
+typedef HANDLE GeneratorFile;
+#else
+typedef int GeneratorFile;
+#endif
+
+// Write of one file, or of range of one file in packed data file. Holds slot until its chunks complete.
+struct WriteJob
 {
-	CreateDirectoryW(L"dummy", NULL);
+	GeneratorFile File;
+	UINT64 ByteSize;		// Written padded, then truncated to this if not packed.
+	UINT PendingCount;		// Chunks in flight, plus 1 while chunks are issued.
+	BOOL IsPacked;
+	BOOL IsLastOfFile;		// File is counted in progress when this job is done.
+	BYTE* HeadChunk;		// First chunk. Compute time, then zero.
+};
 
-	// Write distribution info file.
+// Chunk write in flight.
+struct ChunkWrite
+{
+#ifdef _WIN32
+	OVERLAPPED Overlapped;	// First member, so completion gives chunk back.
+#endif
+	UINT Slot;
+	UINT ByteSize;
+};
+
+// Progress of writers, read by readout.
+static std::atomic<UINT64> g_writtenFileCount;
+static std::atomic<UINT64> g_writtenByteSize;
+
+// Source of every chunk after first one of file. Never written.
+static BYTE* g_zeroChunk;
+
+// Page aligned and zero filled, for unbuffered writes.
+static BYTE* AllocateChunk()
+{
+#ifdef _WIN32
+	BYTE* chunk = static_cast<BYTE*>(VirtualAlloc(NULL, g_generatorChunkByteSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+	if (chunk == NULL)
+		THROW_ERROR(L"Failed to allocate chunk.");
+#else
+	BYTE* chunk = static_cast<BYTE*>(mmap(NULL, g_generatorChunkByteSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+	if (chunk == MAP_FAILED)
+		THROW_ERROR(L"Failed to allocate chunk.");
+#endif
+
+	return chunk;
+}
+
+static void ReleaseChunk(BYTE* chunk)
+{
+#ifdef _WIN32
+	VirtualFree(chunk, 0, MEM_RELEASE);
+#else
+	munmap(chunk, g_generatorChunkByteSize);
+#endif
+}
+
+static UINT64 GetPaddedByteSize(const UINT64 byteSize)
+{
+	return (byteSize + Dataset::g_packedAlignment - 1) / Dataset::g_packedAlignment * Dataset::g_packedAlignment;
+}
+
+// Reserve blocks of file, so chunk writes don't allocate. Best effort, file system may not support it.
+static void PreallocateFile(const GeneratorFile file, const UINT64 byteSize)
+{
+	if (byteSize == 0)
+		return;
+
+#ifdef _WIN32
+	FILE_ALLOCATION_INFO allocationInfo;
+	allocationInfo.AllocationSize.QuadPart = byteSize;
+	SetFileInformationByHandle(file, FileAllocationInfo, &allocationInfo, sizeof(allocationInfo));
+#else
+	fallocate(file, 0, 0, byteSize);
+#endif
+}
+
+// Issues chunk writes of one thread async, up to queue depth at once. Head chunks of slots are reused by every file.
+class ChunkWriter
+{
+public:
+	void Init(const UINT queueDepth, const BOOL openPacked)
+	{
+		jobAry.resize(queueDepth);
+		chunkAry.resize(queueDepth);
+
+		for (UINT i = 0; i < queueDepth; i++)
+		{
+			jobAry[i].HeadChunk = AllocateChunk();
+			freeSlotAry.push_back(i);
+			freeChunkAry.push_back(i);
+		}
+
+#ifdef _WIN32
+		iocp = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+
+		// Handle is bound to one IOCP, so each thread writes packed data file by own handle.
+		if (openPacked)
+		{
+			packedFile = CreateFileW(Dataset::g_packedDataPath, GENERIC_WRITE, FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED, NULL);
+			if (packedFile == INVALID_HANDLE_VALUE)
+				THROW_ERROR(L"Failed to open packed data file.");
+
+			CreateIoCompletionPort(packedFile, iocp, 0, 0);
+		}
+#else
+		if (FALSE == ring.Init(queueDepth))
+			THROW_ERROR(L"Failed to setup io_uring.");
+
+		if (openPacked)
+		{
+			packedFile = open(Dataset::g_packedDataPath, O_WRONLY | O_DIRECT);
+			if (packedFile < 0)
+				THROW_ERROR(L"Failed to open packed data file.");
+		}
+#endif
+	}
+
+	// Create dummy/<fid>, preallocated to padded size.
+	GeneratorFile CreateDatasetFile(const UINT64 fid, const UINT64 paddedByteSize)
 	{
-		const HANDLE distFileHandle = 
+#ifdef _WIN32
+		const HANDLE file =
 			CreateFileW(
-				L"dummy\\distribution",
+				(L"dummy\\" + std::to_wstring(fid)).c_str(),
 				GENERIC_WRITE,
 				0,
 				NULL,
 				CREATE_ALWAYS,
-				FILE_FLAG_WRITE_THROUGH,
+				FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED,
 				NULL);
 
-		BYTE* buffer = static_cast<BYTE*>(HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(FileGenerationArgs)));
-		memcpy(buffer, &args, sizeof(FileGenerationArgs));
+		if (file == INVALID_HANDLE_VALUE)
+			THROW_ERROR(L"Failed to create file.");
 
-		if (FALSE == WriteFile(distFileHandle, buffer, sizeof(FileGenerationArgs), NULL, NULL))
+		CreateIoCompletionPort(file, iocp, 0, 0);
+#else
+		const int file = open(("dummy/" + std::to_string(fid)).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+		if (file < 0)
+			THROW_ERROR(L"Failed to create file.");
+#endif
+
+		PreallocateFile(file, paddedByteSize);
+		return file;
+	}
+
+	GeneratorFile GetPackedFile() const
+	{
+		return packedFile;
+	}
+
+	// Write file of byteSize, zero padded to aligned size, at offset of file.
+	void Write(const GeneratorFile file, const UINT64 offset, const UINT64 byteSize, const UINT computeMicroSeconds, const BOOL isPacked, const BOOL isLastOfFile)
+	{
+		while (freeSlotAry.empty())
+			Reap();
+
+		const UINT slot = freeSlotAry.back();
+		freeSlotAry.pop_back();
+
+		WriteJob& job = jobAry[slot];
+		job.File = file;
+		job.ByteSize = byteSize;
+		job.PendingCount = 1;
+		job.IsPacked = isPacked;
+		job.IsLastOfFile = isLastOfFile;
+		memcpy(job.HeadChunk, &computeMicroSeconds, sizeof(UINT));
+
+		const UINT64 paddedByteSize = GetPaddedByteSize(byteSize);
+		for (UINT64 position = 0; position < paddedByteSize; position += g_generatorChunkByteSize)
+		{
+			const UINT chunkByteSize = static_cast<UINT>(std::min<UINT64>(g_generatorChunkByteSize, paddedByteSize - position));
+			Issue(slot, position == 0 ? job.HeadChunk : g_zeroChunk, chunkByteSize, offset + position);
+		}
+
+		job.PendingCount--;
+		if (job.PendingCount == 0)
+			Finish(slot);
+	}
+
+	// Wait until every write is done, then release resources.
+	void Exit()
+	{
+		while (inflightCount > 0)
+			Reap();
+
+		for (WriteJob& job : jobAry)
+			ReleaseChunk(job.HeadChunk);
+
+#ifdef _WIN32
+		SAFE_CLOSE_HANDLE(packedFile);
+		CloseHandle(iocp);
+#else
+		SAFE_CLOSE_FD(packedFile);
+		ring.Exit();
+#endif
+	}
+
+private:
+	void Issue(const UINT slot, const BYTE* chunk, const UINT byteSize, const UINT64 offset)
+	{
+		while (freeChunkAry.empty())
+			Reap();
+
+		const UINT c = freeChunkAry.back();
+		freeChunkAry.pop_back();
+
+		chunkAry[c].Slot = slot;
+		chunkAry[c].ByteSize = byteSize;
+		jobAry[slot].PendingCount++;
+		inflightCount++;
+
+#ifdef _WIN32
+		OVERLAPPED& ov = chunkAry[c].Overlapped;
+		ov = { 0 };
+		ov.Offset = static_cast<DWORD>(offset);
+		ov.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+		if (FALSE == WriteFile(jobAry[slot].File, chunk, byteSize, NULL, &ov) && GetLastError() != ERROR_IO_PENDING)
 			THROW_ERROR(L"Failed to call WriteFile.");
+#else
+		// Staged until reap, so writes issued between two reaps go in one submit.
+		io_uring_sqe* sqe = ring.GetSqe();
+		if (sqe == nullptr)
+			THROW_ERROR(L"io_uring submission queue is full.");
 
-		CloseHandle(distFileHandle);
-		HeapFree(GetProcessHeap(), MEM_RELEASE, buffer);
+		sqe->opcode = IORING_OP_WRITE;
+		sqe->fd = jobAry[slot].File;
+		sqe->addr = reinterpret_cast<UINT64>(chunk);
+		sqe->len = byteSize;
+		sqe->off = offset;
+		sqe->user_data = c;
+#endif
+	}
+
+	// Wait for at least one chunk write, then take every completed one.
+	void Reap()
+	{
+#ifdef _WIN32
+		OVERLAPPED_ENTRY entryAry[64];
+		ULONG entRemoved = 0;
+
+		if (FALSE == GetQueuedCompletionStatusEx(iocp, entryAry, 64, &entRemoved, INFINITE, FALSE))
+			THROW_ERROR(L"Failed to wait write.");
+
+		for (ULONG i = 0; i < entRemoved; i++)
+		{
+			ChunkWrite* chunk = reinterpret_cast<ChunkWrite*>(entryAry[i].lpOverlapped);
+
+			DWORD transferred = 0;
+			if (FALSE == GetOverlappedResult(jobAry[chunk->Slot].File, &chunk->Overlapped, &transferred, FALSE) || transferred != chunk->ByteSize)
+				THROW_ERROR(L"Failed to write chunk.");
+
+			Complete(static_cast<UINT>(chunk - chunkAry.data()));
+		}
+#else
+		if (ring.PendingCount() > 0)
+			ring.Submit();
+
+		io_uring_cqe* cqe = ring.WaitCqe();
+		while (cqe != nullptr)
+		{
+			const UINT c = static_cast<UINT>(cqe->user_data);
+			if (cqe->res < 0 || static_cast<UINT>(cqe->res) != chunkAry[c].ByteSize)
+			{
+				errno = cqe->res < 0 ? -cqe->res : 0;
+				THROW_ERROR(L"Failed to write chunk.");
+			}
+
+			ring.SeenCqe();
+			Complete(c);
+
+			cqe = ring.PeekCqe();
+		}
+#endif
+	}
+
+	void Complete(const UINT c)
+	{
+		const UINT slot = chunkAry[c].Slot;
+		freeChunkAry.push_back(c);
+		inflightCount--;
+
+		jobAry[slot].PendingCount--;
+		if (jobAry[slot].PendingCount == 0)
+			Finish(slot);
+	}
+
+	// Every chunk of job is written. Cut padding of file and close it.
+	void Finish(const UINT slot)
+	{
+		WriteJob& job = jobAry[slot];
+
+		if (FALSE == job.IsPacked)
+		{
+#ifdef _WIN32
+			FILE_END_OF_FILE_INFO endOfFileInfo;
+			endOfFileInfo.EndOfFile.QuadPart = job.ByteSize;
+			if (FALSE == SetFileInformationByHandle(job.File, FileEndOfFileInfo, &endOfFileInfo, sizeof(endOfFileInfo)))
+				THROW_ERROR(L"Failed to set file size.");
+
+			CloseHandle(job.File);
+#else
+			if (0 != ftruncate(job.File, job.ByteSize))
+				THROW_ERROR(L"Failed to set file size.");
+
+			close(job.File);
+#endif
+		}
+
+		g_writtenByteSize.fetch_add(job.ByteSize, std::memory_order_relaxed);
+		if (job.IsLastOfFile)
+			g_writtenFileCount.fetch_add(1, std::memory_order_relaxed);
+
+		freeSlotAry.push_back(slot);
 	}
 
-	std::random_device rd;
-	std::mt19937 generator(rd());
+	std::vector<WriteJob> jobAry;		// Indexed by slot.
+	std::vector<ChunkWrite> chunkAry;
+	std::vector<UINT> freeSlotAry;
+	std::vector<UINT> freeChunkAry;
+	UINT inflightCount = 0;
+
+#ifdef _WIN32
+	HANDLE iocp = NULL;
+	HANDLE packedFile = INVALID_HANDLE_VALUE;
+#else
+	IoUring::Ring ring;
+	int packedFile = -1;
+#endif
+};
+
+// Draw size and compute time of [beginFid, endFid) from RNG stream of thread t.
+static void PlanFiles(const FileGenerationArgs& args, const UINT64 seed, const UINT t, const UINT64 beginFid, const UINT64 endFid, Dataset::ManifestEntry* entryAry)
+{
+	std::seed_seq seedSeq = { static_cast<UINT>(seed), static_cast<UINT>(seed >> 32), t };
+	std::mt19937 generator(seedSeq);
 	std::normal_distribution<double> sizeNormalDist(args.FileSize.Mean, args.FileSize.Variance);
 	std::exponential_distribution<double> sizeExpDist(1.0 / args.FileSize.Mean);
 	std::normal_distribution<double> computeNormalDist(args.FileCompute.Mean, args.FileCompute.Variance);
 
-	// Generate dummy files.
-	for (UINT fid = 0; fid < args.TotalFileCount; fid++)
+	for (UINT64 fid = beginFid; fid < endFid; fid++)
 	{
-		if (fid % 1000 == 0)
-			printf("%d th file creation completed.\n", fid);
-
 		UINT64 fileByteSize = args.FileSize.MinByte;
 		switch (args.FileSizeModel)
 		{
@@ -46,10 +361,10 @@ void FileGenerator::GenerateDummyFiles(const FileGenerationArgs args)
 			fileByteSize = args.FileSize.Mean;
 			break;
 		case NORMAL_DIST:
-			fileByteSize = sizeNormalDist(generator);
+			fileByteSize = static_cast<UINT64>(std::max<double>(0, sizeNormalDist(generator)));
 			break;
 		case EXP:
-			fileByteSize = sizeExpDist(generator);
+			fileByteSize = static_cast<UINT64>(sizeExpDist(generator));
 			break;
 		case SIZE_EVAL:
 			fileByteSize = args.FileSize.MaxByte / pow(4, args.TotalFileCount - 1 - fid);
@@ -57,14 +372,91 @@ void FileGenerator::GenerateDummyFiles(const FileGenerationArgs args)
 		}
 
 		if (args.FileSizeModel != SIZE_EVAL)
-			fileByteSize = max(args.FileSize.MinByte, min(args.FileSize.MaxByte, fileByteSize));
+			fileByteSize = std::max<UINT64>(args.FileSize.MinByte, std::min<UINT64>(args.FileSize.MaxByte, fileByteSize));
+
+		UINT fileComputeTime = static_cast<UINT>(std::max<double>(0, computeNormalDist(generator)));
+		fileComputeTime = std::max<UINT>(args.FileCompute.MinMicroSeconds, std::min<UINT>(args.FileCompute.MaxMicroSeconds, fileComputeTime));
+
+		entryAry[fid] = { 0, fileByteSize, fileComputeTime, 0 };
+	}
+}
+
+// Write [beginFid, endFid) in every layout asked.
+static void WriteFiles(const UINT queueDepth, const UINT64 beginFid, const UINT64 endFid, const Dataset::ManifestEntry* entryAry, const BOOL writeFiles, const BOOL writePacked)
+{
+	ChunkWriter writer;
+	writer.Init(queueDepth, writePacked);
+
+	for (UINT64 fid = beginFid; fid < endFid; fid++)
+	{
+		const Dataset::ManifestEntry& entry = entryAry[fid];
+
+		if (writeFiles)
+		{
+			const GeneratorFile file = writer.CreateDatasetFile(fid, GetPaddedByteSize(entry.ByteSize));
+			writer.Write(file, 0, entry.ByteSize, entry.ComputeMicroSeconds, FALSE, FALSE == writePacked);
+		}
+
+		if (writePacked)
+			writer.Write(writer.GetPackedFile(), entry.Offset, entry.ByteSize, entry.ComputeMicroSeconds, TRUE, TRUE);
+	}
+
+	writer.Exit();
+}
+
+// Print progress every second until every writer is done, then totals.
+static void ReportProgress(const UINT64 totalFileCount, const UINT threadCount, const std::atomic<UINT>& doneThreadCount)
+{
+	TIMER_INIT;
+	TIMER_START;
+
+	double lastTime = 0;
+	UINT64 lastFileCount = 0;
+	UINT64 lastByteSize = 0;
+
+	while (doneThreadCount.load() < threadCount)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+		TIMER_STOP;
+		if (el - lastTime < 1.0)
+			continue;
+
+		const UINT64 fileCount = g_writtenFileCount.load(std::memory_order_relaxed);
+		const UINT64 byteSize = g_writtenByteSize.load(std::memory_order_relaxed);
 
-		UINT fileComputeTime = computeNormalDist(generator);
-		fileComputeTime = max(args.FileCompute.MinMicroSeconds, min(args.FileCompute.MaxMicroSeconds, fileComputeTime));
+		printf("Generating: %llu / %llu files (%.1f%%), %.2f MiB/s, %.0f files/s\n",
+			fileCount,
+			totalFileCount,
+			totalFileCount == 0 ? 100.0 : fileCount * 100.0 / totalFileCount,
+			(byteSize - lastByteSize) / (1024.0 * 1024.0) / (el - lastTime),
+			(fileCount - lastFileCount) / (el - lastTime));
 
-		const HANDLE fileHandle = 
+		lastTime = el;
+		lastFileCount = fileCount;
+		lastByteSize = byteSize;
+	}
+
+	TIMER_STOP;
+
+	printf("Generated %llu files, %.2f MiB in %.2f s. %.2f MiB/s, %.0f files/s.\n\n",
+		g_writtenFileCount.load(),
+		g_writtenByteSize.load() / (1024.0 * 1024.0),
+		el,
+		el > 0 ? g_writtenByteSize.load() / (1024.0 * 1024.0) / el : 0,
+		el > 0 ? g_writtenFileCount.load() / el : 0);
+}
+
+void FileGenerator::GenerateDummyFiles(const FileGenerationArgs args, const GeneratorOptions options, const BOOL writeFiles, const BOOL writePacked)
+{
+	// Write distribution info file.
+#ifdef _WIN32
+	CreateDirectoryW(L"dummy", NULL);
+
+	{
+		const HANDLE distFileHandle =
 			CreateFileW(
-				(L"dummy\\" + std::to_wstring(fid)).c_str(),
+				L"dummy\\distribution",
 				GENERIC_WRITE,
 				0,
 				NULL,
@@ -72,13 +464,120 @@ void FileGenerator::GenerateDummyFiles(const FileGenerationArgs args)
 				FILE_FLAG_WRITE_THROUGH,
 				NULL);
 
-		BYTE* buffer = static_cast<BYTE*>(HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, fileByteSize));
-		memcpy(buffer, &fileComputeTime, sizeof(UINT));
-
-		if (FALSE == WriteFile(fileHandle, buffer, fileByteSize, NULL, NULL))
+		if (FALSE == WriteFile(distFileHandle, &args, sizeof(FileGenerationArgs), NULL, NULL))
 			THROW_ERROR(L"Failed to call WriteFile.");
 
-		CloseHandle(fileHandle);
-		HeapFree(GetProcessHeap(), MEM_RELEASE, buffer);
+		CloseHandle(distFileHandle);
+	}
+#else
+	mkdir("dummy", 0755);
+
+	{
+		const int distFd = open("dummy/distribution", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (distFd < 0 || write(distFd, &args, sizeof(FileGenerationArgs)) != sizeof(FileGenerationArgs))
+			THROW_ERROR(L"Failed to write distribution file.");
+
+		close(distFd);
+	}
+#endif
+
+	const UINT threadCount = options.ThreadCount > 0 ? options.ThreadCount : std::max<UINT>(1, std::thread::hardware_concurrency());
+	const UINT queueDepth = options.QueueDepth > 0 ? options.QueueDepth : g_defaultGeneratorQueueDepth;
+
+	UINT64 seed = options.Seed;
+	if (seed == 0)
+	{
+		std::random_device rd;
+		seed = (static_cast<UINT64>(rd()) << 32) | rd();
 	}
-}
\ No newline at end of file
+
+	printf("Generating %llu files by %u threads. Queue depth(%u) / Seed(%llu)\n", args.TotalFileCount, threadCount, queueDepth, seed);
+
+	// Thread t owns contiguous range of FIDs in both phases.
+	auto getBeginFid = [&](const UINT t) { return args.TotalFileCount * t / threadCount; };
+
+	// Draw every file first, so offsets in packed data file are known before writes.
+	std::vector<Dataset::ManifestEntry> entryAry(args.TotalFileCount);
+	{
+		std::vector<std::thread> threadAry;
+		for (UINT t = 0; t < threadCount; t++)
+			threadAry.emplace_back(PlanFiles, std::cref(args), seed, t, getBeginFid(t), getBeginFid(t + 1), entryAry.data());
+
+		for (std::thread& thread : threadAry)
+			thread.join();
+	}
+
+	UINT64 packedByteSize = 0;
+	for (Dataset::ManifestEntry& entry : entryAry)
+	{
+		entry.Offset = packedByteSize;
+		packedByteSize += GetPaddedByteSize(entry.ByteSize);
+	}
+
+	// Size packed data file once. Writers open it by themselves.
+	if (writePacked)
+	{
+#ifdef _WIN32
+		const HANDLE packedFile = CreateFileW(Dataset::g_packedDataPath, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, NULL);
+		if (packedFile == INVALID_HANDLE_VALUE)
+			THROW_ERROR(L"Failed to create packed data file.");
+
+		PreallocateFile(packedFile, packedByteSize);
+
+		FILE_END_OF_FILE_INFO endOfFileInfo;
+		endOfFileInfo.EndOfFile.QuadPart = packedByteSize;
+		if (FALSE == SetFileInformationByHandle(packedFile, FileEndOfFileInfo, &endOfFileInfo, sizeof(endOfFileInfo)))
+			THROW_ERROR(L"Failed to set packed data file size.");
+
+		CloseHandle(packedFile);
+#else
+		const int packedFile = open(Dataset::g_packedDataPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (packedFile < 0)
+			THROW_ERROR(L"Failed to create packed data file.");
+
+		PreallocateFile(packedFile, packedByteSize);
+		if (0 != ftruncate(packedFile, packedByteSize))
+			THROW_ERROR(L"Failed to set packed data file size.");
+
+		close(packedFile);
+#endif
+	}
+
+	g_writtenFileCount = 0;
+	g_writtenByteSize = 0;
+	g_zeroChunk = AllocateChunk();
+
+	std::atomic<UINT> doneThreadCount(0);
+	{
+		std::vector<std::thread> threadAry;
+		for (UINT t = 0; t < threadCount; t++)
+		{
+			threadAry.emplace_back([&, t]
+			{
+				WriteFiles(queueDepth, getBeginFid(t), getBeginFid(t + 1), entryAry.data(), writeFiles, writePacked);
+				doneThreadCount++;
+			});
+		}
+
+		ReportProgress(args.TotalFileCount, threadCount, doneThreadCount);
+
+		for (std::thread& thread : threadAry)
+			thread.join();
+	}
+
+	ReleaseChunk(g_zeroChunk);
+	g_zeroChunk = nullptr;
+
+	// Packed data file of older dataset doesn't match new manifest.
+	if (FALSE == writePacked)
+	{
+#ifdef _WIN32
+		DeleteFileW(Dataset::g_packedDataPath);
+#else
+		unlink(Dataset::g_packedDataPath);
+#endif
+	}
+
+	// Manifest is written last, so broken generation doesn't leave manifest of missing data.
+	Dataset::WriteManifest(entryAry);
+}
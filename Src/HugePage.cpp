@@ -0,0 +1,236 @@
+#include "pch.h"
+#include "HugePage.h"
+
+#ifndef _WIN32
+#include <fstream>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#endif
+
+using namespace HugePage;
+
+static UINT64 g_hugePageByteSize;
+
+// Stats.
+static std::atomic<UINT64> g_hugeTlbCount;
+static std::atomic<UINT64> g_transparentCount;
+static std::atomic<UINT64> g_smallPageCount;
+static std::atomic<UINT64> g_smallBufferCount;
+
+// Huge pages only pay off when rounding wastes less than the buffer itself.
+static BOOL IsSmallBuffer(const UINT64 byteSize)
+{
+	return g_hugePageByteSize == 0 || byteSize < g_hugePageByteSize / 2;
+}
+
+static UINT64 GetMapByteSize(const UINT64 byteSize)
+{
+	return (byteSize + g_hugePageByteSize - 1) / g_hugePageByteSize * g_hugePageByteSize;
+}
+
+#ifdef _WIN32
+// Large pages need SeLockMemoryPrivilege, which must be granted to account by policy first.
+static BOOL EnableLockMemoryPrivilege()
+{
+	HANDLE token;
+	if (FALSE == OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+		return FALSE;
+
+	TOKEN_PRIVILEGES privileges = { 0 };
+	privileges.PrivilegeCount = 1;
+	privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+	// AdjustTokenPrivileges succeeds with ERROR_NOT_ALL_ASSIGNED if account lacks privilege.
+	const BOOL result =
+		LookupPrivilegeValue(NULL, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid) &&
+		AdjustTokenPrivileges(token, FALSE, &privileges, 0, NULL, NULL) &&
+		GetLastError() == ERROR_SUCCESS;
+
+	CloseHandle(token);
+	return result;
+}
+
+void HugePage::Init(const BOOL useHugePage)
+{
+	g_hugePageByteSize = GetLargePageMinimum();
+
+	// Without privilege, every large page allocation falls back and is counted.
+	if (useHugePage && g_hugePageByteSize > 0)
+		EnableLockMemoryPrivilege();
+}
+
+void HugePage::StartDtlbCount()
+{
+	// No user mode PMU access on Windows.
+}
+
+BYTE* HugePage::Allocate(const UINT64 byteSize)
+{
+	if (IsSmallBuffer(byteSize))
+	{
+		g_smallBufferCount++;
+		return static_cast<BYTE*>(VirtualAlloc(NULL, byteSize, MEM_COMMIT, PAGE_READWRITE));
+	}
+
+	const UINT64 mapByteSize = GetMapByteSize(byteSize);
+
+	void* buffer = VirtualAlloc(NULL, mapByteSize, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+	if (buffer != NULL)
+	{
+		g_hugeTlbCount++;
+		return static_cast<BYTE*>(buffer);
+	}
+
+	// Windows has no transparent huge page, so fall back to small pages.
+	g_smallPageCount++;
+	return static_cast<BYTE*>(VirtualAlloc(NULL, mapByteSize, MEM_COMMIT, PAGE_READWRITE));
+}
+
+void HugePage::Free(BYTE* buffer, const UINT64 byteSize)
+{
+	VirtualFree(buffer, 0, MEM_RELEASE);
+}
+
+HugePageStats HugePage::Shutdown()
+{
+	HugePageStats stats = { 0 };
+	stats.HugePageByteSize = g_hugePageByteSize;
+	stats.HugeTlbCount = g_hugeTlbCount;
+	stats.TransparentCount = g_transparentCount;
+	stats.SmallPageCount = g_smallPageCount;
+	stats.SmallBufferCount = g_smallBufferCount;
+
+	g_hugeTlbCount = 0;
+	g_transparentCount = 0;
+	g_smallPageCount = 0;
+	g_smallBufferCount = 0;
+
+	return stats;
+}
+#else
+static int g_dtlbFd = -1;
+
+// Default huge page size of MAP_HUGETLB. 0 if kernel has no hugetlbfs.
+static UINT64 ReadHugePageByteSize()
+{
+	std::ifstream file("/proc/meminfo");
+
+	std::string key;
+	UINT64 value;
+	std::string unit;
+	while (file >> key >> value)
+	{
+		std::getline(file, unit);
+		if (key == "Hugepagesize:")
+			return value * 1024;
+	}
+
+	return 0;
+}
+
+void HugePage::Init(const BOOL useHugePage)
+{
+	// Size is only needed by Allocate, which is not called when huge pages are off.
+	g_hugePageByteSize = useHugePage ? ReadHugePageByteSize() : 0;
+
+	// Counter of this thread is inherited by threads created afterwards, and their counts are added back when they exit.
+	perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HW_CACHE;
+	attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	attr.disabled = 1;
+	attr.inherit = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	g_dtlbFd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+void HugePage::StartDtlbCount()
+{
+	// Enabling parent enables inherited counters of running threads too.
+	if (g_dtlbFd >= 0)
+		ioctl(g_dtlbFd, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+BYTE* HugePage::Allocate(const UINT64 byteSize)
+{
+	if (IsSmallBuffer(byteSize))
+	{
+		g_smallBufferCount++;
+
+		BYTE* buffer = nullptr;
+		if (0 != posix_memalign(reinterpret_cast<void**>(&buffer), 4096, byteSize))
+			return nullptr;
+		return buffer;
+	}
+
+	const UINT64 mapByteSize = GetMapByteSize(byteSize);
+
+	void* buffer = mmap(nullptr, mapByteSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (buffer != MAP_FAILED)
+	{
+		g_hugeTlbCount++;
+		return static_cast<BYTE*>(buffer);
+	}
+
+	// No reserved huge page left. Map one extra page and trim, so THP can back whole buffer.
+	BYTE* base = static_cast<BYTE*>(mmap(nullptr, mapByteSize + g_hugePageByteSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+	if (base == MAP_FAILED)
+		return nullptr;
+
+	BYTE* aligned = reinterpret_cast<BYTE*>((reinterpret_cast<UINT64>(base) + g_hugePageByteSize - 1) / g_hugePageByteSize * g_hugePageByteSize);
+	if (aligned > base)
+		munmap(base, aligned - base);
+	munmap(aligned + mapByteSize, base + g_hugePageByteSize - aligned);
+
+	// Fails if THP is disabled, or built out of kernel.
+	if (madvise(aligned, mapByteSize, MADV_HUGEPAGE) == 0)
+		g_transparentCount++;
+	else
+		g_smallPageCount++;
+
+	return aligned;
+}
+
+void HugePage::Free(BYTE* buffer, const UINT64 byteSize)
+{
+	if (IsSmallBuffer(byteSize))
+		free(buffer);
+	else
+		munmap(buffer, GetMapByteSize(byteSize));
+}
+
+HugePageStats HugePage::Shutdown()
+{
+	HugePageStats stats = { 0 };
+	stats.HugePageByteSize = g_hugePageByteSize;
+	stats.HugeTlbCount = g_hugeTlbCount;
+	stats.TransparentCount = g_transparentCount;
+	stats.SmallPageCount = g_smallPageCount;
+	stats.SmallBufferCount = g_smallBufferCount;
+
+	if (g_dtlbFd >= 0)
+	{
+		ioctl(g_dtlbFd, PERF_EVENT_IOC_DISABLE, 0);
+
+		UINT64 count;
+		if (read(g_dtlbFd, &count, sizeof(count)) == sizeof(count))
+		{
+			stats.IsDtlbCounted = TRUE;
+			stats.DtlbMissCount = count;
+		}
+
+		SAFE_CLOSE_FD(g_dtlbFd);
+		g_dtlbFd = -1;
+	}
+
+	g_hugeTlbCount = 0;
+	g_transparentCount = 0;
+	g_smallPageCount = 0;
+	g_smallBufferCount = 0;
+
+	return stats;
+}
+#endif
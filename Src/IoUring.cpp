@@ -0,0 +1,161 @@
+#include "pch.h"
+#include "IoUring.h"
+
+#ifdef __linux__
+using namespace IoUring;
+
+BOOL Ring::Init(const UINT entries)
+{
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+
+	ringFd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+	if (ringFd < 0)
+		return FALSE;
+
+	sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+	// Kernel 5.4+ maps SQ and CQ rings with single mmap.
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if (cqRingSize > sqRingSize)
+			sqRingSize = cqRingSize;
+		cqRingSize = sqRingSize;
+	}
+
+	sqRingPtr = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+	if (sqRingPtr == MAP_FAILED)
+		return FALSE;
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		cqRingPtr = sqRingPtr;
+	}
+	else
+	{
+		cqRingPtr = mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+		if (cqRingPtr == MAP_FAILED)
+			return FALSE;
+	}
+
+	sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+	sqes = static_cast<io_uring_sqe*>(mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES));
+	if (sqes == MAP_FAILED)
+		return FALSE;
+
+	BYTE* sq = static_cast<BYTE*>(sqRingPtr);
+	sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+	sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+	sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+	sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+	sqEntries = params.sq_entries;
+
+	BYTE* cq = static_cast<BYTE*>(cqRingPtr);
+	cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+	cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+	cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+	cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+	sqeHead = sqeTail = 0;
+
+	return TRUE;
+}
+
+void Ring::Exit()
+{
+	if (sqes != nullptr && sqes != MAP_FAILED)
+		munmap(sqes, sqesSize);
+	if (cqRingPtr != nullptr && cqRingPtr != MAP_FAILED && cqRingPtr != sqRingPtr)
+		munmap(cqRingPtr, cqRingSize);
+	if (sqRingPtr != nullptr && sqRingPtr != MAP_FAILED)
+		munmap(sqRingPtr, sqRingSize);
+
+	SAFE_CLOSE_FD(ringFd);
+
+	ringFd = -1;
+	sqes = nullptr;
+	sqRingPtr = cqRingPtr = nullptr;
+}
+
+io_uring_sqe* Ring::GetSqe()
+{
+	const unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+	if (sqeTail - head >= sqEntries)
+		return nullptr;
+
+	io_uring_sqe* sqe = &sqes[sqeTail & *sqMask];
+	sqeTail++;
+
+	memset(sqe, 0, sizeof(io_uring_sqe));
+	return sqe;
+}
+
+UINT Ring::PendingCount() const
+{
+	return sqeTail - sqeHead;
+}
+
+int Ring::Submit(const UINT waitCount)
+{
+	// Publish prepared SQEs to SQ ring.
+	const unsigned toSubmit = sqeTail - sqeHead;
+	unsigned tail = *sqTail;
+
+	while (sqeHead != sqeTail)
+	{
+		sqArray[tail & *sqMask] = sqeHead & *sqMask;
+		tail++;
+		sqeHead++;
+	}
+
+	__atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+
+	if (toSubmit == 0 && waitCount == 0)
+		return 0;
+
+	int ret;
+	do
+	{
+		ret = static_cast<int>(syscall(
+			__NR_io_uring_enter, ringFd, toSubmit, waitCount,
+			waitCount > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0));
+	} while (ret < 0 && errno == EINTR);
+
+	return ret;
+}
+
+io_uring_cqe* Ring::PeekCqe()
+{
+	const unsigned head = *cqHead;
+	if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE))
+		return nullptr;
+
+	return &cqes[head & *cqMask];
+}
+
+io_uring_cqe* Ring::WaitCqe()
+{
+	io_uring_cqe* cqe = PeekCqe();
+	while (cqe == nullptr)
+	{
+		int ret;
+		do
+		{
+			ret = static_cast<int>(syscall(__NR_io_uring_enter, ringFd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0));
+		} while (ret < 0 && errno == EINTR);
+
+		if (ret < 0)
+			return nullptr;
+
+		cqe = PeekCqe();
+	}
+
+	return cqe;
+}
+
+void Ring::SeenCqe()
+{
+	__atomic_store_n(cqHead, *cqHead + 1, __ATOMIC_RELEASE);
+}
+#endif
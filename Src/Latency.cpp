@@ -0,0 +1,215 @@
+#include "pch.h"
+#include "ThreadSchedule.h"
+#include "Latency.h"
+
+#include <bit>
+#include <cmath>
+
+using namespace ThreadSchedule;
+using namespace Latency;
+
+enum SpanType
+{
+	SPAN_QUEUE_WAIT,
+	SPAN_READ,
+	SPAN_COMPUTE_WAIT,
+	SPAN_COMPUTE,
+	SPAN_TOTAL,
+	SPAN_COUNT
+};
+
+// Padded to cache line, so that threads stamping neighbor FIDs don't false share.
+struct alignas(64) FileStamp
+{
+	UINT64 StampAry[STAGE_COUNT];
+	UINT Path;
+};
+
+struct Histogram
+{
+	UINT64 CountAry[SPAN_COUNT][g_bucketCount];
+	UINT64 PathReadCountAry[PATH_COUNT][g_bucketCount];
+	UINT64 PathTotalCountAry[PATH_COUNT][g_bucketCount];
+};
+
+static FileStamp* g_fileStampAry;
+
+// Histogram of each thread. List is locked only when thread records first time.
+static std::vector<Histogram*> g_histogramList;
+static std::mutex g_histogramListLock;
+static UINT g_generation = 1;
+
+struct ThreadHistogram
+{
+	UINT Generation = 0;
+	Histogram* Data = nullptr;
+
+	// Histograms of previous test were released by Shutdown.
+	Histogram* Get()
+	{
+		if (Generation == g_generation)
+			return Data;
+
+		Generation = g_generation;
+		Data = new Histogram();
+
+		std::lock_guard<std::mutex> lock(g_histogramListLock);
+		g_histogramList.push_back(Data);
+
+		return Data;
+	}
+};
+
+static thread_local ThreadHistogram t_threadHistogram;
+
+UINT64 Latency::GetNanoSeconds()
+{
+#ifdef _WIN32
+	static LARGE_INTEGER freq = [] { LARGE_INTEGER f; QueryPerformanceFrequency(&f); return f; }();
+
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return static_cast<UINT64>(counter.QuadPart / freq.QuadPart * 1000000000ULL + counter.QuadPart % freq.QuadPart * 1000000000ULL / freq.QuadPart);
+#else
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return static_cast<UINT64>(now.tv_sec) * 1000000000ULL + now.tv_nsec;
+#endif
+}
+
+static UINT GetBucket(const UINT64 value)
+{
+	if (value < g_subBucketCount)
+		return static_cast<UINT>(value);
+
+	const UINT shift = static_cast<UINT>(std::bit_width(value)) - 1 - g_subBucketBits;
+	return (shift + 1) * g_subBucketCount + static_cast<UINT>(value >> shift) - g_subBucketCount;
+}
+
+// Middle of bucket range.
+static double GetBucketValue(const UINT bucket)
+{
+	if (bucket < g_subBucketCount)
+		return bucket;
+
+	const UINT shift = bucket / g_subBucketCount - 1;
+	const UINT64 lower = static_cast<UINT64>(g_subBucketCount + bucket % g_subBucketCount) << shift;
+	return lower + ((1ULL << shift) - 1) / 2.0;
+}
+
+static LatencyPercentiles GetPercentiles(const UINT64* countAry)
+{
+	constexpr double percentileAry[4] = { 0.5, 0.9, 0.99, 0.999 };
+	double valueAry[4] = { 0 };
+
+	UINT64 totalCount = 0;
+	for (UINT b = 0; b < g_bucketCount; b++)
+		totalCount += countAry[b];
+
+	if (totalCount > 0)
+	{
+		UINT64 cumulativeCount = 0;
+		UINT p = 0;
+
+		for (UINT b = 0; b < g_bucketCount && p < 4; b++)
+		{
+			cumulativeCount += countAry[b];
+			while (p < 4 && cumulativeCount >= static_cast<UINT64>(std::ceil(percentileAry[p] * totalCount)))
+				valueAry[p++] = GetBucketValue(b) / 1000.0;
+		}
+	}
+
+	return { valueAry[0], valueAry[1], valueAry[2], valueAry[3] };
+}
+
+void Latency::Init(const UINT fileCount)
+{
+	g_fileStampAry = new FileStamp[fileCount]();
+}
+
+void Latency::Stamp(const UINT fid, const StageType stage)
+{
+	g_fileStampAry[fid].StampAry[stage] = GetNanoSeconds();
+}
+
+void Latency::StampAt(const UINT fid, const StageType stage, const UINT64 nanoSeconds)
+{
+	g_fileStampAry[fid].StampAry[stage] = nanoSeconds;
+}
+
+void Latency::SetPath(const UINT fid, const PathType path)
+{
+	g_fileStampAry[fid].Path = path;
+}
+
+void Latency::Complete(const UINT fid)
+{
+	Stamp(fid, STAGE_COMPUTE_END);
+
+	// Simulation without some stage leaves it 0. Treat as same time as previous stage.
+	UINT64 stampAry[STAGE_COUNT];
+	for (UINT s = 0; s < STAGE_COUNT; s++)
+		stampAry[s] = (g_fileStampAry[fid].StampAry[s] == 0 && s > 0) ? stampAry[s - 1] : g_fileStampAry[fid].StampAry[s];
+
+	Histogram* histogram = t_threadHistogram.Get();
+
+	// Stages are stamped by different threads. Clamp if clocks of cores disagree slightly.
+	for (UINT s = 0; s < SPAN_TOTAL; s++)
+		histogram->CountAry[s][GetBucket(stampAry[s + 1] > stampAry[s] ? stampAry[s + 1] - stampAry[s] : 0)]++;
+
+	const UINT readBucket = GetBucket(stampAry[STAGE_READ_COMPLETE] > stampAry[STAGE_READ_START] ? stampAry[STAGE_READ_COMPLETE] - stampAry[STAGE_READ_START] : 0);
+	const UINT totalBucket = GetBucket(stampAry[STAGE_COMPUTE_END] - stampAry[STAGE_POST]);
+	const UINT path = g_fileStampAry[fid].Path;
+
+	histogram->CountAry[SPAN_TOTAL][totalBucket]++;
+	histogram->PathReadCountAry[path][readBucket]++;
+	histogram->PathTotalCountAry[path][totalBucket]++;
+}
+
+LatencyStats Latency::Shutdown()
+{
+	Histogram* merged = new Histogram();
+
+	for (Histogram* histogram : g_histogramList)
+	{
+		for (UINT s = 0; s < SPAN_COUNT; s++)
+		{
+			for (UINT b = 0; b < g_bucketCount; b++)
+				merged->CountAry[s][b] += histogram->CountAry[s][b];
+		}
+
+		for (UINT p = 0; p < PATH_COUNT; p++)
+		{
+			for (UINT b = 0; b < g_bucketCount; b++)
+			{
+				merged->PathReadCountAry[p][b] += histogram->PathReadCountAry[p][b];
+				merged->PathTotalCountAry[p][b] += histogram->PathTotalCountAry[p][b];
+			}
+		}
+
+		delete histogram;
+	}
+
+	g_histogramList.clear();
+	g_generation++;
+
+	delete[] g_fileStampAry;
+	g_fileStampAry = nullptr;
+
+	LatencyStats stats;
+	stats.QueueWait = GetPercentiles(merged->CountAry[SPAN_QUEUE_WAIT]);
+	stats.Read = GetPercentiles(merged->CountAry[SPAN_READ]);
+	stats.ComputeWait = GetPercentiles(merged->CountAry[SPAN_COMPUTE_WAIT]);
+	stats.Compute = GetPercentiles(merged->CountAry[SPAN_COMPUTE]);
+	stats.Total = GetPercentiles(merged->CountAry[SPAN_TOTAL]);
+
+	for (UINT p = 0; p < PATH_COUNT; p++)
+	{
+		stats.PathRead[p] = GetPercentiles(merged->PathReadCountAry[p]);
+		stats.PathTotal[p] = GetPercentiles(merged->PathTotalCountAry[p]);
+	}
+
+	delete merged;
+
+	return stats;
+}
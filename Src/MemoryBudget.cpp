@@ -0,0 +1,98 @@
+#include "pch.h"
+#include "MemoryBudget.h"
+
+using namespace MemoryBudget;
+
+static UINT64 g_byteCap;
+static UINT g_threadCount;
+
+// Below are locked by g_lock.
+static std::mutex g_lock;
+static std::condition_variable g_releaseCv;
+static UINT64 g_admittedByteSize;
+static UINT g_waiterCount;
+static MemoryBudgetStats g_stats;
+
+// Must hold g_lock.
+static BOOL IsFit(const UINT64 byteSize)
+{
+	return g_admittedByteSize == 0 || g_admittedByteSize + byteSize <= g_byteCap;
+}
+
+// Must hold g_lock.
+static void Admit(const UINT64 byteSize)
+{
+	g_admittedByteSize += byteSize;
+	g_stats.HighWaterByteSize = std::max<UINT64>(g_stats.HighWaterByteSize, g_admittedByteSize);
+}
+
+void MemoryBudget::Init(const UINT64 byteCap, const UINT threadCount)
+{
+	g_byteCap = byteCap;
+	g_threadCount = threadCount;
+	g_admittedByteSize = 0;
+	g_waiterCount = 0;
+	g_stats = { 0 };
+}
+
+void MemoryBudget::Acquire(const UINT64 byteSize)
+{
+	if (g_byteCap == 0)
+		return;
+
+	std::unique_lock<std::mutex> lock(g_lock);
+
+	if (IsFit(byteSize))
+	{
+		Admit(byteSize);
+		return;
+	}
+
+	const std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+
+	// Last thread to wait can't be released by anyone. Let it in over cap.
+	g_waiterCount++;
+	if (g_waiterCount == g_threadCount)
+		g_stats.OverCommitCount++;
+	else
+		g_releaseCv.wait(lock, [byteSize] { return IsFit(byteSize); });
+	g_waiterCount--;
+
+	Admit(byteSize);
+
+	g_stats.WaitCount++;
+	g_stats.WaitTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - waitStart).count();
+}
+
+BOOL MemoryBudget::TryAcquire(const UINT64 byteSize)
+{
+	if (g_byteCap == 0)
+		return TRUE;
+
+	std::lock_guard<std::mutex> lock(g_lock);
+
+	if (FALSE == IsFit(byteSize))
+		return FALSE;
+
+	Admit(byteSize);
+	return TRUE;
+}
+
+void MemoryBudget::Release(const UINT64 byteSize)
+{
+	if (g_byteCap == 0)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(g_lock);
+		g_admittedByteSize -= byteSize;
+	}
+
+	// Waiters need different sizes, so one release may fit any of them.
+	g_releaseCv.notify_all();
+}
+
+MemoryBudgetStats MemoryBudget::Shutdown()
+{
+	return g_stats;
+}
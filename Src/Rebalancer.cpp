@@ -0,0 +1,303 @@
+#include "pch.h"
+#include "ThreadSchedule.h"
+#include "Rebalancer.h"
+#include "Trace.h"
+
+using namespace Rebalancer;
+
+// Waiting thread count and sum of their start stamps share one word, so that controller reads them together.
+constexpr UINT g_waiterCountShift = 48;
+constexpr UINT64 g_waiterStampMask = (1ull << g_waiterCountShift) - 1;
+
+// Counts are written under g_lock, read without lock on fast path of Next.
+// Threads still waiting are counted with their start stamps, so that wait over whole interval is not missed.
+struct alignas(64) RoleState
+{
+	std::atomic<UINT> TargetCount;
+	std::atomic<UINT> CurrentCount;
+	std::atomic<INT64> QueueDepth;
+	std::atomic<UINT64> IdleWaiter;			// Threads in BeginIdle / EndIdle << g_waiterCountShift | sum of start stamps.
+	std::atomic<UINT64> IdleDoneSum;		// Length of finished waits.
+};
+
+static RoleState g_roleStateAry[ROLE_COUNT];
+static UINT g_minThreadCount;
+static UINT g_maxThreadCount;
+static void (*g_wakeFunc)(RoleType role);
+static void (*g_leaveFunc)(RoleType role);
+
+static std::mutex g_lock;
+static std::condition_variable g_parkCv;
+static std::condition_variable g_controllerCv;
+static BOOL g_stop;						// Written under g_lock.
+static std::atomic<BOOL> g_stopped;		// Same as g_stop, for fast path of Next.
+static std::thread g_controllerThread;
+static RebalancerStats g_stats;
+static std::chrono::steady_clock::time_point g_baseTime;
+
+static thread_local UINT64 t_idleStart;
+
+static const char* const g_moveNameAry[ROLE_COUNT] = { "Switch To ReadCall", "Switch To Compute" };
+static const char* const g_growNameAry[ROLE_COUNT] = { "Grow ReadCall", "Grow Compute" };
+static const char* const g_shrinkNameAry[ROLE_COUNT] = { "Shrink ReadCall", "Shrink Compute" };
+
+// Since Init (us). Small enough that start stamps of every thread sum under g_waiterStampMask.
+static UINT64 GetMicroSeconds()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - g_baseTime).count();
+}
+
+// Idle time of role until now (us).
+// EndIdle adds to done sum after leaving waiters, so wait ending in between is counted in next interval, never twice.
+static INT64 GetIdleMicroSeconds(const RoleState& state, const UINT64 now)
+{
+	const UINT64 doneSum = state.IdleDoneSum.load(std::memory_order_acquire);
+	const UINT64 waiter = state.IdleWaiter.load(std::memory_order_acquire);
+
+	return static_cast<INT64>(doneSum + (waiter >> g_waiterCountShift) * now - (waiter & g_waiterStampMask));
+}
+
+// Give role whose thread count is under target. Must hold g_lock. Returns ROLE_COUNT if none.
+static RoleType TakeRole()
+{
+	for (UINT r = 0; r < ROLE_COUNT; r++)
+	{
+		RoleState& state = g_roleStateAry[r];
+		if (state.CurrentCount.load(std::memory_order_relaxed) < state.TargetCount.load(std::memory_order_relaxed))
+		{
+			state.CurrentCount.fetch_add(1, std::memory_order_relaxed);
+			return static_cast<RoleType>(r);
+		}
+	}
+
+	return ROLE_COUNT;
+}
+
+// Lower target of role. Blocked thread needs token only if queue of role is empty, otherwise it passes Next soon.
+// Must hold g_lock.
+static void LowerTarget(const RoleType role)
+{
+	RoleState& state = g_roleStateAry[role];
+	state.TargetCount.fetch_sub(1, std::memory_order_relaxed);
+
+	if (state.QueueDepth.load(std::memory_order_relaxed) <= 0)
+		g_wakeFunc(role);
+}
+
+static void ControllerFunc()
+{
+	SERIES_INIT("Rebalancer");
+	SPAN_INIT;
+
+	const UINT64 startTime = GetMicroSeconds();
+	UINT64 lastTime = startTime;
+
+	INT64 lastIdleAry[ROLE_COUNT];
+	double countTimeSumAry[ROLE_COUNT] = { 0 };
+	for (UINT r = 0; r < ROLE_COUNT; r++)
+		lastIdleAry[r] = GetIdleMicroSeconds(g_roleStateAry[r], startTime);
+
+	std::unique_lock<std::mutex> lock(g_lock);
+	while (FALSE == g_controllerCv.wait_for(lock, std::chrono::microseconds(g_intervalMicroSeconds), [] { return g_stop; }))
+	{
+		const UINT64 now = GetMicroSeconds();
+		const double interval = static_cast<double>(now - lastTime);
+		lastTime = now;
+
+		double idleRatioAry[ROLE_COUNT];
+		UINT targetAry[ROLE_COUNT];
+		BOOL isSettled = TRUE;
+
+		for (UINT r = 0; r < ROLE_COUNT; r++)
+		{
+			const RoleState& state = g_roleStateAry[r];
+			const UINT currentCount = state.CurrentCount.load(std::memory_order_relaxed);
+			const INT64 idle = GetIdleMicroSeconds(state, now);
+
+			targetAry[r] = state.TargetCount.load(std::memory_order_relaxed);
+			isSettled &= currentCount == targetAry[r];
+			countTimeSumAry[r] += currentCount * interval;
+
+			idleRatioAry[r] = currentCount == 0 ? 0 : static_cast<double>(idle - lastIdleAry[r]) / (interval * currentCount);
+			idleRatioAry[r] = std::min<double>(std::max<double>(idleRatioAry[r], 0), 1);
+			lastIdleAry[r] = idle;
+		}
+
+		// Last move is not taken by threads yet. Deciding again would stack moves on stale samples.
+		if (FALSE == isSettled)
+			continue;
+
+		const double readIdle = idleRatioAry[ROLE_READCALL];
+		const double computeIdle = idleRatioAry[ROLE_COMPUTE];
+		const UINT threadCount = targetAry[ROLE_READCALL] + targetAry[ROLE_COMPUTE];
+		const INT64 readDepth = g_roleStateAry[ROLE_READCALL].QueueDepth.load(std::memory_order_relaxed);
+		const INT64 computeDepth = g_roleStateAry[ROLE_COMPUTE].QueueDepth.load(std::memory_order_relaxed);
+
+		// Compute depth includes reads in flight. More of them than compute threads means completions wait.
+		const BOOL hasBacklog = readDepth > 0 || computeDepth > static_cast<INT64>(targetAry[ROLE_COMPUTE]);
+
+		RoleType from = ROLE_COUNT;
+		RoleType to = ROLE_COUNT;
+
+		if (readIdle > g_slackIdleRatio && computeIdle < g_busyIdleRatio && targetAry[ROLE_READCALL] > 1)
+		{
+			from = ROLE_READCALL;
+			to = ROLE_COMPUTE;
+		}
+		else if (computeIdle > g_slackIdleRatio && readIdle < g_busyIdleRatio && readDepth > 0 && targetAry[ROLE_COMPUTE] > 1)
+		{
+			from = ROLE_COMPUTE;
+			to = ROLE_READCALL;
+		}
+		else if (readIdle < g_busyIdleRatio && computeIdle < g_busyIdleRatio && hasBacklog && threadCount < g_maxThreadCount)
+		{
+			to = readDepth > 0 && readIdle <= computeIdle ? ROLE_READCALL : ROLE_COMPUTE;
+		}
+		else if (readIdle > g_slackIdleRatio && computeIdle > g_slackIdleRatio && threadCount > g_minThreadCount)
+		{
+			from = readIdle >= computeIdle ? ROLE_READCALL : ROLE_COMPUTE;
+			if (targetAry[from] == 1)
+				from = from == ROLE_READCALL ? ROLE_COMPUTE : ROLE_READCALL;
+			if (targetAry[from] == 1)
+				continue;
+		}
+		else
+		{
+			continue;
+		}
+
+		if (from != ROLE_COUNT)
+			LowerTarget(from);
+
+		if (to != ROLE_COUNT)
+		{
+			g_roleStateAry[to].TargetCount.fetch_add(1, std::memory_order_relaxed);
+			g_parkCv.notify_one();
+		}
+
+		const char* name =
+			from != ROLE_COUNT && to != ROLE_COUNT ? g_moveNameAry[to] :
+			to != ROLE_COUNT ? g_growNameAry[to] : g_shrinkNameAry[from];
+
+		SPAN_START(Trace::CATEGORY_TEST, name);
+		SPAN_END;
+
+		if (from != ROLE_COUNT && to != ROLE_COUNT)
+			g_stats.SwitchCount++;
+		else if (to != ROLE_COUNT)
+			g_stats.GrowCount++;
+		else
+			g_stats.ShrinkCount++;
+	}
+
+	const double elapsed = static_cast<double>(std::max<UINT64>(lastTime - startTime, 1));
+	g_stats.MeanReadCallThreadCount = countTimeSumAry[ROLE_READCALL] / elapsed;
+	g_stats.MeanComputeThreadCount = countTimeSumAry[ROLE_COMPUTE] / elapsed;
+}
+
+void Rebalancer::Init(const UINT readCallThreadCount, const UINT computeThreadCount, const UINT minThreadCount, const UINT maxThreadCount, void (*wakeFunc)(RoleType role), void (*leaveFunc)(RoleType role))
+{
+	g_stats = { 0 };
+	g_minThreadCount = minThreadCount;
+	g_maxThreadCount = maxThreadCount;
+	g_wakeFunc = wakeFunc;
+	g_leaveFunc = leaveFunc;
+	g_stop = FALSE;
+	g_stopped = FALSE;
+	g_baseTime = std::chrono::steady_clock::now();
+
+	for (RoleState& state : g_roleStateAry)
+	{
+		state.CurrentCount = 0;
+		state.QueueDepth = 0;
+		state.IdleWaiter = 0;
+		state.IdleDoneSum = 0;
+	}
+
+	g_roleStateAry[ROLE_READCALL].TargetCount = readCallThreadCount;
+	g_roleStateAry[ROLE_COMPUTE].TargetCount = computeThreadCount;
+
+	g_controllerThread = std::thread(ControllerFunc);
+}
+
+RoleType Rebalancer::Join()
+{
+	std::unique_lock<std::mutex> lock(g_lock);
+
+	while (TRUE)
+	{
+		if (g_stop)
+			return ROLE_EXIT;
+
+		const RoleType role = TakeRole();
+		if (role != ROLE_COUNT)
+			return role;
+
+		g_parkCv.wait(lock);
+	}
+}
+
+RoleType Rebalancer::Next(const RoleType role)
+{
+	if (g_stopped.load(std::memory_order_relaxed))
+		return ROLE_EXIT;
+
+	RoleState& state = g_roleStateAry[role];
+	if (state.CurrentCount.load(std::memory_order_relaxed) <= state.TargetCount.load(std::memory_order_relaxed))
+		return role;
+
+	{
+		std::lock_guard<std::mutex> lock(g_lock);
+
+		// Another thread of role left first.
+		if (state.CurrentCount.load(std::memory_order_relaxed) <= state.TargetCount.load(std::memory_order_relaxed))
+			return role;
+
+		state.CurrentCount.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	if (g_leaveFunc != nullptr)
+		g_leaveFunc(role);
+
+	return Join();
+}
+
+void Rebalancer::BeginIdle(const RoleType role)
+{
+	RoleState& state = g_roleStateAry[role];
+
+	t_idleStart = GetMicroSeconds();
+	state.IdleWaiter.fetch_add(1ull << g_waiterCountShift | t_idleStart, std::memory_order_release);
+}
+
+void Rebalancer::EndIdle(const RoleType role)
+{
+	RoleState& state = g_roleStateAry[role];
+
+	const UINT64 now = GetMicroSeconds();
+	state.IdleWaiter.fetch_sub(1ull << g_waiterCountShift | t_idleStart, std::memory_order_release);
+	state.IdleDoneSum.fetch_add(now - t_idleStart, std::memory_order_release);
+}
+
+void Rebalancer::AddQueueDepth(const RoleType role, const INT64 count)
+{
+	g_roleStateAry[role].QueueDepth.fetch_add(count, std::memory_order_relaxed);
+}
+
+void Rebalancer::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(g_lock);
+		g_stop = TRUE;
+		g_stopped = TRUE;
+	}
+
+	g_parkCv.notify_all();
+	g_controllerCv.notify_all();
+}
+
+RebalancerStats Rebalancer::Shutdown()
+{
+	g_controllerThread.join();
+	return g_stats;
+}
@@ -0,0 +1,101 @@
+#include "pch.h"
+#include "Statistics.h"
+
+#include <cmath>
+
+using namespace Statistics;
+
+static double GetMedian(std::vector<double> valueAry)
+{
+	if (valueAry.empty())
+		return 0;
+
+	std::sort(valueAry.begin(), valueAry.end());
+
+	const size_t half = valueAry.size() / 2;
+	return valueAry.size() % 2 == 1 ? valueAry[half] : (valueAry[half - 1] + valueAry[half]) / 2;
+}
+
+// Two-sided 95% Student t quantile.
+static double GetTQuantile(const UINT degreeOfFreedom)
+{
+	static const double quantileAry[] =
+	{
+		12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+		2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+		2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+	};
+
+	if (degreeOfFreedom == 0)
+		return 0;
+	if (degreeOfFreedom <= 30)
+		return quantileAry[degreeOfFreedom - 1];
+	if (degreeOfFreedom <= 40)
+		return 2.021;
+	if (degreeOfFreedom <= 60)
+		return 2.000;
+	if (degreeOfFreedom <= 120)
+		return 1.980;
+
+	return 1.960;
+}
+
+Summary Statistics::Summarize(const std::vector<double>& sampleAry, std::vector<BOOL>* isOutlierAry)
+{
+	Summary summary = { 0 };
+	isOutlierAry->assign(sampleAry.size(), FALSE);
+
+	if (sampleAry.empty())
+		return summary;
+
+	// Median absolute deviation. 0 if half of samples are same, then nothing is outlier.
+	const double median = GetMedian(sampleAry);
+
+	std::vector<double> deviationAry;
+	for (const double sample : sampleAry)
+		deviationAry.push_back(std::fabs(sample - median));
+
+	const double mad = GetMedian(deviationAry);
+
+	std::vector<double> inlierAry;
+	for (size_t i = 0; i < sampleAry.size(); i++)
+	{
+		if (mad > 0 && 0.6745 * deviationAry[i] / mad > g_outlierZScore)
+			(*isOutlierAry)[i] = TRUE;
+		else
+			inlierAry.push_back(sampleAry[i]);
+	}
+
+	summary.SampleCount = static_cast<UINT>(inlierAry.size());
+	summary.OutlierCount = static_cast<UINT>(sampleAry.size() - inlierAry.size());
+	summary.Median = GetMedian(inlierAry);
+
+	for (const double sample : inlierAry)
+		summary.Mean += sample;
+	summary.Mean /= summary.SampleCount;
+
+	if (summary.SampleCount > 1)
+	{
+		double squareSum = 0;
+		for (const double sample : inlierAry)
+			squareSum += (sample - summary.Mean) * (sample - summary.Mean);
+
+		summary.StdDev = std::sqrt(squareSum / (summary.SampleCount - 1));
+	}
+
+	// Single sample has no interval. Spread it to whole line, so that it overlaps everything.
+	const double halfWidth =
+		summary.SampleCount > 1 ?
+		GetTQuantile(summary.SampleCount - 1) * summary.StdDev / std::sqrt(static_cast<double>(summary.SampleCount)) :
+		HUGE_VAL;
+
+	summary.CiLow = summary.Mean - halfWidth;
+	summary.CiHigh = summary.Mean + halfWidth;
+
+	return summary;
+}
+
+BOOL Statistics::IsOverlapped(const Summary& a, const Summary& b)
+{
+	return a.CiLow <= b.CiHigh && b.CiLow <= a.CiHigh;
+}
@@ -0,0 +1,773 @@
+#include "pch.h"
+#include "FileGenerator.h"
+#include "ThreadSchedule.h"
+#include "Dataset.h"
+#include "Sweep.h"
+
+#include <fstream>
+
+using namespace FileGenerator;
+using namespace ThreadSchedule;
+using namespace Sweep;
+
+// Indexed by enum value.
+static const char* const g_simulationNameAry[] = { "MANUAL", "ROLE_SPECIFIED", "SYNC", "MMAP", "IO_URING", "STREAMING", "WORK_STEALING", "COROUTINE" };
+static const char* const g_computeKernelNameAry[] = { "AUTO", "SCALAR", "SSE2", "AVX2", "AVX512" };
+static const char* const g_computeProfileNameAry[] = { "MEMORY_STREAM", "ALU", "CACHE_THRASH", "MIXED" };
+static const char* const g_mmapAdviceNameAry[] = { "NONE", "SEQUENTIAL", "WILLNEED", "HUGEPAGE" };
+static const char* const g_fileSizeModelNameAry[] = { "IDENTICAL", "NORMAL_DIST", "EXP", "SIZE_EVAL" };
+static const char* const g_cacheModeNameAry[] = { "ANY", "COLD", "WARM" };
+static const char* const g_datasetLayoutNameAry[] = { "FILES", "PACKED" };
+static const char* const g_postOrderNameAry[] = { "FIFO", "LPT", "SPT", "INTERLEAVED" };
+static const char* const g_threadPlacementNameAry[] = { "NONE", "UNPINNED", "CORE", "SMT", "NODE" };
+static const char* const g_bufferPageNameAry[] = { "SMALL", "HUGE" };
+static const char* const g_arrivalNameAry[] = { "FIXED", "POISSON", "BURSTY" };
+
+static std::ofstream g_outputFile;
+static OutputFormatType g_outputFormat;
+static CacheModeType g_cacheMode;
+static BOOL g_isHeaderWritten;
+
+static void FailOption(const std::string& key, const char* reason)
+{
+	fprintf(stderr, "Sweep option '%s': %s\n", key.c_str(), reason);
+	THROW_ERROR(L"Invalid sweep option.");
+}
+
+static std::string Trim(const std::string& value)
+{
+	const size_t begin = value.find_first_not_of(" \t\r\n");
+	if (begin == std::string::npos)
+		return "";
+
+	const size_t end = value.find_last_not_of(" \t\r\n");
+	return value.substr(begin, end - begin + 1);
+}
+
+static std::vector<std::string> Split(const std::string& value, const char delimiter)
+{
+	std::vector<std::string> itemAry;
+
+	size_t begin = 0;
+	while (TRUE)
+	{
+		const size_t end = value.find(delimiter, begin);
+		itemAry.push_back(Trim(value.substr(begin, end == std::string::npos ? std::string::npos : end - begin)));
+
+		if (end == std::string::npos)
+			break;
+
+		begin = end + 1;
+	}
+
+	return itemAry;
+}
+
+static UINT64 ParseNumber(const std::string& key, const std::string& value)
+{
+	char* end = nullptr;
+	const UINT64 number = strtoull(value.c_str(), &end, 0);
+
+	if (value.empty() || *end != '\0')
+		FailOption(key, "not a number");
+
+	return number;
+}
+
+static std::vector<UINT> ParseNumberList(const std::string& key, const std::string& value)
+{
+	std::vector<UINT> numberAry;
+	for (const std::string& item : Split(value, ','))
+		numberAry.push_back(static_cast<UINT>(ParseNumber(key, item)));
+
+	return numberAry;
+}
+
+static BOOL ParseBool(const std::string& key, const std::string& value)
+{
+	if (value == "1" || value == "true" || value == "TRUE")
+		return TRUE;
+	if (value == "0" || value == "false" || value == "FALSE")
+		return FALSE;
+
+	FailOption(key, "not 0 / 1");
+	return FALSE;
+}
+
+// Case-insensitive. Returns index of name.
+template <size_t N>
+static UINT ParseName(const std::string& key, const std::string& value, const char* const (&nameAry)[N])
+{
+	std::string upper = value;
+	std::transform(upper.begin(), upper.end(), upper.begin(), [](const unsigned char c) { return static_cast<char>(toupper(c)); });
+
+	for (UINT i = 0; i < N; i++)
+	{
+		if (upper == nameAry[i])
+			return i;
+	}
+
+	FailOption(key, "unknown name");
+	return 0;
+}
+
+static void ApplyConfigFile(SweepConfig* config, const std::string& path);
+
+static void ApplyOption(SweepConfig* config, const std::string& key, const std::string& value)
+{
+	TestArgument& args = config->BaseArgs;
+
+	// Swept axes.
+	if (key == "sim")
+	{
+		config->SimTypeAry.clear();
+		for (const std::string& item : Split(value, ','))
+			config->SimTypeAry.push_back(static_cast<SimulationType>(ParseName(key, item, g_simulationNameAry)));
+	}
+	else if (key == "threads")
+		config->ThreadCountAry = ParseNumberList(key, value);
+	else if (key == "roles")
+	{
+		config->ThreadRoleAry.clear();
+		for (const std::string& item : Split(value, ','))
+		{
+			const std::vector<std::string> roleItemAry = Split(item, ':');
+			if (roleItemAry.size() != 4)
+				FailOption(key, "role mix needs 4 counts");
+
+			std::array<UINT, 4> roleMix;
+			for (UINT r = 0; r < 4; r++)
+				roleMix[r] = static_cast<UINT>(ParseNumber(key, roleItemAry[r]));
+
+			config->ThreadRoleAry.push_back(roleMix);
+		}
+	}
+	else if (key == "readcall-limit")
+		config->ReadCallTaskLimitAry = ParseNumberList(key, value);
+	else if (key == "compute-limit")
+		config->ComputeTaskLimitAry = ParseNumberList(key, value);
+	else if (key == "files")
+		config->TestFileCountAry = ParseNumberList(key, value);
+	else if (key == "layout")
+	{
+		config->DatasetLayoutAry.clear();
+		for (const std::string& item : Split(value, ','))
+			config->DatasetLayoutAry.push_back(static_cast<DatasetLayoutType>(ParseName(key, item, g_datasetLayoutNameAry)));
+	}
+	else if (key == "order")
+	{
+		config->PostOrderAry.clear();
+		for (const std::string& item : Split(value, ','))
+			config->PostOrderAry.push_back(static_cast<PostOrderType>(ParseName(key, item, g_postOrderNameAry)));
+	}
+	else if (key == "placement")
+	{
+		config->ThreadPlacementAry.clear();
+		for (const std::string& item : Split(value, ','))
+			config->ThreadPlacementAry.push_back(static_cast<ThreadPlacementType>(ParseName(key, item, g_threadPlacementNameAry)));
+	}
+	else if (key == "pages")
+	{
+		config->BufferPageAry.clear();
+		for (const std::string& item : Split(value, ','))
+			config->BufferPageAry.push_back(static_cast<BufferPageType>(ParseName(key, item, g_bufferPageNameAry)));
+	}
+	else if (key == "rate")
+		config->ArrivalRateAry = ParseNumberList(key, value);
+	else if (key == "memory-budget")
+	{
+		// Byte caps. 0 disables budget.
+		config->MemoryBudgetByteSizeAry.clear();
+		for (const std::string& item : Split(value, ','))
+			config->MemoryBudgetByteSizeAry.push_back(ParseNumber(key, item));
+	}
+
+	// Fixed test arguments.
+	else if (key == "repeat")
+	{
+		config->RepeatCount = static_cast<UINT>(ParseNumber(key, value));
+		if (config->RepeatCount < 1)
+			FailOption(key, "needs at least 1 repeat");
+	}
+	else if (key == "warmup")
+		config->WarmupCount = static_cast<UINT>(ParseNumber(key, value));
+	else if (key == "cache")
+		config->CacheMode = static_cast<CacheModeType>(ParseName(key, value, g_cacheModeNameAry));
+	else if (key == "defined-compute")
+		args.UseDefinedComputeTime = ParseBool(key, value);
+	else if (key == "queue-depth")
+		args.IoQueueDepth = static_cast<UINT>(ParseNumber(key, value));
+	else if (key == "submit-batch")
+		args.IoSubmitBatch = static_cast<UINT>(ParseNumber(key, value));
+	else if (key == "mmap-advice")
+		args.MmapAdvice = static_cast<MmapAdviceType>(ParseName(key, value, g_mmapAdviceNameAry));
+	else if (key == "mmap-populate")
+		args.MmapPopulate = ParseBool(key, value);
+	else if (key == "mmap-prefetch")
+		args.MmapPrefetchByteSize = ParseNumber(key, value);
+	else if (key == "stream-segment")
+		args.StreamSegmentByteSize = static_cast<UINT>(ParseNumber(key, value));
+	else if (key == "stream-inflight")
+		args.StreamInflightCount = static_cast<UINT>(ParseNumber(key, value));
+	else if (key == "buffer-pool")
+	{
+		// Cap in bytes. 0 disables pool.
+		args.BufferPoolByteSize = ParseNumber(key, value);
+		args.UseBufferPool = args.BufferPoolByteSize > 0;
+	}
+	else if (key == "buffer-pool-pretouch")
+		args.BufferPoolPreTouch = ParseBool(key, value);
+	else if (key == "user-task-queue")
+		args.UseUserTaskQueue = ParseBool(key, value);
+	else if (key == "kernel")
+		args.ComputeKernel = static_cast<ComputeKernelType>(ParseName(key, value, g_computeKernelNameAry));
+	else if (key == "profile")
+		args.ComputeProfile = static_cast<ComputeProfileType>(ParseName(key, value, g_computeProfileNameAry));
+	else if (key == "trace")
+		config->TraceFilePath = value;
+	else if (key == "rebalance")
+		args.UseRebalancer = ParseBool(key, value);
+	else if (key == "min-threads")
+		args.MinThreadCount = static_cast<UINT>(ParseNumber(key, value));
+	else if (key == "max-threads")
+		args.MaxThreadCount = static_cast<UINT>(ParseNumber(key, value));
+	else if (key == "nowait-read")
+		args.UseNowaitRead = ParseBool(key, value);
+	else if (key == "arrival")
+		args.Arrival = static_cast<ArrivalType>(ParseName(key, value, g_arrivalNameAry));
+	else if (key == "burst-period")
+		args.ArrivalBurstPeriodMicroSeconds = static_cast<UINT>(ParseNumber(key, value));
+	else if (key == "burst-on")
+		args.ArrivalBurstOnPercent = static_cast<UINT>(ParseNumber(key, value));
+
+	// Dataset.
+	else if (key == "generate")
+		config->GenerateFileCount = ParseNumber(key, value);
+	else if (key == "size-model")
+		config->GenerationArgs.FileSizeModel = static_cast<FileSizeModelType>(ParseName(key, value, g_fileSizeModelNameAry));
+	else if (key == "size-min")
+		config->GenerationArgs.FileSize.MinByte = ParseNumber(key, value);
+	else if (key == "size-max")
+		config->GenerationArgs.FileSize.MaxByte = ParseNumber(key, value);
+	else if (key == "size-mean")
+		config->GenerationArgs.FileSize.Mean = ParseNumber(key, value);
+	else if (key == "size-variance")
+		config->GenerationArgs.FileSize.Variance = ParseNumber(key, value);
+	else if (key == "compute-min")
+		config->GenerationArgs.FileCompute.MinMicroSeconds = static_cast<UINT>(ParseNumber(key, value));
+	else if (key == "compute-max")
+		config->GenerationArgs.FileCompute.MaxMicroSeconds = static_cast<UINT>(ParseNumber(key, value));
+	else if (key == "compute-mean")
+		config->GenerationArgs.FileCompute.Mean = static_cast<UINT>(ParseNumber(key, value));
+	else if (key == "compute-variance")
+		config->GenerationArgs.FileCompute.Variance = static_cast<UINT>(ParseNumber(key, value));
+	else if (key == "gen-threads")
+		config->GeneratorOptions.ThreadCount = static_cast<UINT>(ParseNumber(key, value));
+	else if (key == "gen-queue-depth")
+		config->GeneratorOptions.QueueDepth = static_cast<UINT>(ParseNumber(key, value));
+	else if (key == "gen-seed")
+		config->GeneratorOptions.Seed = ParseNumber(key, value);
+
+	// Output.
+	else if (key == "output")
+	{
+		// Format follows extension. Later format option overrides it.
+		config->OutputPath = value;
+		config->OutputFormat = value.size() >= 5 && value.compare(value.size() - 5, 5, ".json") == 0 ? OUTPUT_FORMAT_JSON : OUTPUT_FORMAT_CSV;
+	}
+	else if (key == "format")
+	{
+		if (value != "csv" && value != "json")
+			FailOption(key, "not csv / json");
+
+		config->OutputFormat = value == "json" ? OUTPUT_FORMAT_JSON : OUTPUT_FORMAT_CSV;
+	}
+	else if (key == "config")
+		ApplyConfigFile(config, value);
+	else
+		FailOption(key, "unknown option");
+
+	if (config->SimTypeAry.empty() || config->ThreadCountAry.empty() || config->ThreadRoleAry.empty() ||
+		config->ReadCallTaskLimitAry.empty() || config->ComputeTaskLimitAry.empty() || config->TestFileCountAry.empty() ||
+		config->MemoryBudgetByteSizeAry.empty() || config->DatasetLayoutAry.empty() || config->PostOrderAry.empty() ||
+		config->ThreadPlacementAry.empty() || config->BufferPageAry.empty() || config->ArrivalRateAry.empty())
+		FailOption(key, "empty list");
+}
+
+static void ApplyConfigFile(SweepConfig* config, const std::string& path)
+{
+	std::ifstream file(path);
+	if (FALSE == file.is_open())
+		FailOption("config", "failed to open file");
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		line = Trim(line.substr(0, line.find('#')));
+		if (line.empty())
+			continue;
+
+		const size_t separator = line.find('=');
+		if (separator == std::string::npos)
+			FailOption(line, "needs key = value");
+
+		ApplyOption(config, Trim(line.substr(0, separator)), Trim(line.substr(separator + 1)));
+	}
+}
+
+SweepConfig Sweep::ParseArgs(const int argc, char** argv)
+{
+	SweepConfig config;
+
+	// Former default test. ROLE_SPECIFIED is Windows only, so Linux runs same roles on io_uring.
+#ifdef _WIN32
+	config.SimTypeAry = { SIM_ROLE_SPECIFIED_THREAD };
+#else
+	config.SimTypeAry = { SIM_IO_URING_THREAD };
+#endif
+	config.ThreadCountAry = { 3 };
+	config.ThreadRoleAry = { { 1, 2, 0, 0 } };
+	config.ReadCallTaskLimitAry = { 0 };
+	config.ComputeTaskLimitAry = { 0 };
+	config.TestFileCountAry = { 50 };
+	config.MemoryBudgetByteSizeAry = { 0 };
+	config.DatasetLayoutAry = { DATASET_LAYOUT_FILES };
+	config.PostOrderAry = { POST_ORDER_FIFO };
+	config.ThreadPlacementAry = { THREAD_PLACEMENT_NONE };
+	config.BufferPageAry = { BUFFER_PAGE_SMALL };
+	config.ArrivalRateAry = { 0 };
+	config.RepeatCount = 10;
+	config.WarmupCount = 1;
+	config.CacheMode = CACHE_MODE_ANY;
+
+	config.BaseArgs =
+	{
+		SIM_ROLE_SPECIFIED_THREAD,							// Simulation type (swept)
+		0,													// Number of files to test (swept)
+		0,													// Number of threads (swept)
+		nullptr,											// Role of thread (swept)
+		0,													// ReadCall task limit (swept)
+		0,													// Compute task limit (swept)
+		TRUE,												// Use defined compute time?
+		64,													// io_uring queue depth
+		8,													// io_uring submit batch
+		MMAP_ADVICE_NONE,									// mmap madvise policy
+		FALSE,												// mmap MAP_POPULATE?
+		0,													// mmap prefetch distance (byte)
+		256 * 1024,											// Streaming segment size (byte)
+		4,													// Streaming in-flight segment count
+		FALSE,												// Use buffer pool?
+		(UINT64)256 * 1024 * 1024,							// Buffer pool cap (byte)
+		FALSE,												// Pre-touch buffer pool?
+		FALSE,												// Use lock-free task queue instead of IOCP?
+		COMPUTE_KERNEL_AUTO,								// Checksum kernel
+		COMPUTE_PROFILE_MEMORY_STREAM,						// Compute profile (defined compute time)
+		nullptr,											// Trace file path (set by Expand)
+		FALSE,												// Rebalance ReadCall / Compute threads?
+		0,													// Rebalancer min thread count (0 means 2)
+		0,													// Rebalancer max thread count (0 means initial count)
+		0,													// Memory budget (swept)
+		DATASET_LAYOUT_FILES,								// Dataset layout (swept)
+		POST_ORDER_FIFO,									// Post order (swept)
+		FALSE,												// Try RWF_NOWAIT read before io_uring?
+		THREAD_PLACEMENT_NONE,								// Thread placement (swept)
+		BUFFER_PAGE_SMALL,									// Read buffer pages (swept)
+		ARRIVAL_POISSON,									// Arrival process (when rate > 0)
+		0,													// Arrival rate, files per second (swept)
+		100 * 1000,											// Bursty arrival period (us)
+		25													// Bursty arrival on part of period (%)
+	};
+
+	config.GenerateFileCount = 0;
+	config.GenerationArgs =
+	{
+		0,													// TotalFileCount (generate option)
+		{
+			(UINT64)1 * 1024,								// MinByte
+			(UINT64)2 * 1024 * 1024,						// MaxByte
+			(UINT64)1 * 1024 * 1024,						// Mean
+			(UINT64)512 * 1024								// Variance
+		},
+		NORMAL_DIST,										// FileSizeModelType
+		{
+			100u,											// MinMicroSeconds
+			5000u,											// MaxMicroSeconds
+			2000u,											// Mean
+			2000u											// Variance
+		}
+	};
+
+	config.GeneratorOptions =
+	{
+		0,													// ThreadCount (0 means hardware thread count)
+		0,													// QueueDepth (0 means default)
+		0													// Seed (0 draws one)
+	};
+
+	config.OutputFormat = OUTPUT_FORMAT_CSV;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string option = argv[i];
+		if (option.rfind("--", 0) != 0)
+			FailOption(option, "needs --key=value");
+
+		const size_t separator = option.find('=');
+		if (separator == std::string::npos)
+			FailOption(option, "needs --key=value");
+
+		ApplyOption(&config, option.substr(2, separator - 2), option.substr(separator + 1));
+	}
+
+	return config;
+}
+
+std::vector<TestArgument> Sweep::Expand(const SweepConfig& config)
+{
+	std::vector<TestArgument> pointAry;
+
+	for (const SimulationType simType : config.SimTypeAry)
+	{
+		const BOOL useRoles = simType == SIM_ROLE_SPECIFIED_THREAD || simType == SIM_IO_URING_THREAD;
+		const BOOL useLimits = simType == SIM_ROLE_SPECIFIED_THREAD;
+
+		// StartTest fails on rebalancer or RWF_NOWAIT with other types, so mixed sweeps turn them off on those.
+#ifdef _WIN32
+		const BOOL useRebalancer = config.BaseArgs.UseRebalancer && simType == SIM_ROLE_SPECIFIED_THREAD;
+#else
+		const BOOL useRebalancer = config.BaseArgs.UseRebalancer && simType == SIM_IO_URING_THREAD;
+#endif
+		const BOOL useNowaitRead = config.BaseArgs.UseNowaitRead && simType == SIM_IO_URING_THREAD;
+
+		// Threads axis for simulation types without roles, roles axis otherwise.
+		const size_t threadOptionCount = useRoles ? config.ThreadRoleAry.size() : config.ThreadCountAry.size();
+		const std::vector<UINT> unusedLimitAry = { 0 };
+
+		for (const DatasetLayoutType datasetLayout : config.DatasetLayoutAry)
+		{
+			for (const PostOrderType postOrder : config.PostOrderAry)
+			{
+				for (const ThreadPlacementType threadPlacement : config.ThreadPlacementAry)
+				{
+					for (const BufferPageType bufferPage : config.BufferPageAry)
+					{
+						for (const UINT fileCount : config.TestFileCountAry)
+						{
+							for (const UINT64 memoryBudgetByteSize : config.MemoryBudgetByteSizeAry)
+							{
+								for (size_t threadOption = 0; threadOption < threadOptionCount; threadOption++)
+								{
+									for (const UINT readCallTaskLimit : useLimits ? config.ReadCallTaskLimitAry : unusedLimitAry)
+									{
+										for (const UINT computeTaskLimit : useLimits ? config.ComputeTaskLimitAry : unusedLimitAry)
+										{
+											// Rates of one configuration are adjacent, so saturation knee can be found from consecutive points.
+											for (const UINT arrivalRate : config.ArrivalRateAry)
+											{
+												TestArgument args = config.BaseArgs;
+												args.SimType = simType;
+												args.TestFileCount = fileCount;
+												args.ReadCallTaskLimit = readCallTaskLimit == 0 ? fileCount : readCallTaskLimit;
+												args.ComputeTaskLimit = computeTaskLimit == 0 ? fileCount : computeTaskLimit;
+												args.MemoryBudgetByteSize = memoryBudgetByteSize;
+												args.DatasetLayout = datasetLayout;
+												args.PostOrder = postOrder;
+												args.ThreadPlacement = threadPlacement;
+												args.BufferPage = bufferPage;
+												args.ArrivalRate = arrivalRate;
+												args.UseRebalancer = useRebalancer;
+												args.UseNowaitRead = useNowaitRead;
+												args.TraceFilePath = config.TraceFilePath.empty() ? nullptr : config.TraceFilePath.c_str();
+
+												if (useRoles)
+												{
+													const std::array<UINT, 4>& roleMix = config.ThreadRoleAry[threadOption];
+													args.ThreadRoleAry = const_cast<UINT*>(roleMix.data());
+													args.ThreadCount = roleMix[0] + roleMix[1] + roleMix[2] + roleMix[3];
+												}
+												else
+												{
+													args.ThreadRoleAry = nullptr;
+													args.ThreadCount = config.ThreadCountAry[threadOption];
+												}
+
+												pointAry.push_back(args);
+											}
+										}
+									}
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	return pointAry;
+}
+
+void Sweep::OpenOutput(const SweepConfig& config)
+{
+	g_outputFormat = config.OutputFormat;
+	g_cacheMode = config.CacheMode;
+	g_isHeaderWritten = FALSE;
+
+	if (config.OutputPath.empty())
+		return;
+
+	g_outputFile.open(config.OutputPath, std::ios::out | std::ios::trunc);
+	if (FALSE == g_outputFile.is_open())
+		THROW_ERROR(L"Failed to open sweep output file.");
+}
+
+void Sweep::WriteRow(const UINT pointIndex, const UINT repeatIndex, const TestArgument& args, const TestResult& result, const BOOL isOutlier)
+{
+	if (FALSE == g_outputFile.is_open())
+		return;
+
+	char roles[64] = "";
+	if (args.ThreadRoleAry != nullptr)
+		snprintf(roles, sizeof(roles), "%u:%u:%u:%u", args.ThreadRoleAry[0], args.ThreadRoleAry[1], args.ThreadRoleAry[2], args.ThreadRoleAry[3]);
+
+	const double throughput = result.ElapsedTime > 0 ? result.TotalFileSize / (1024.0 * 1024.0) / (result.ElapsedTime / 1000.0) : 0;
+
+	// Name, value, is string.
+	struct Column
+	{
+		const char* Name;
+		std::string Value;
+		BOOL IsString;
+	};
+
+	// Traffic summed over nodes.
+	UINT64 localByteSize = 0;
+	UINT64 remoteByteSize = 0;
+	for (UINT n = 0; n < g_maxReportedNodeCount; n++)
+	{
+		localByteSize += result.NodeLocalByteSizeAry[n];
+		remoteByteSize += result.NodeRemoteByteSizeAry[n];
+	}
+
+	auto number = [](const double value) { char text[64]; snprintf(text, sizeof(text), "%.3f", value); return std::string(text); };
+
+	const Column columnAry[] =
+	{
+		{ "point", std::to_string(pointIndex), FALSE },
+		{ "repeat", std::to_string(repeatIndex), FALSE },
+		{ "sim", GetSimulationName(args.SimType), TRUE },
+		{ "files", std::to_string(args.TestFileCount), FALSE },
+		{ "layout", GetDatasetLayoutName(args.DatasetLayout), TRUE },
+		{ "order", GetPostOrderName(args.PostOrder), TRUE },
+		{ "placement", GetThreadPlacementName(args.ThreadPlacement), TRUE },
+		{ "pages", GetBufferPageName(args.BufferPage), TRUE },
+		{ "arrival", GetArrivalName(args), TRUE },
+		{ "arrival_rate", std::to_string(args.ArrivalRate), FALSE },
+		{ "threads", std::to_string(args.ThreadCount), FALSE },
+		{ "roles", roles, TRUE },
+		{ "readcall_limit", std::to_string(args.ReadCallTaskLimit), FALSE },
+		{ "compute_limit", std::to_string(args.ComputeTaskLimit), FALSE },
+		{ "defined_compute", std::to_string(args.UseDefinedComputeTime), FALSE },
+		{ "cache", g_cacheModeNameAry[g_cacheMode], TRUE },
+		{ "outlier", std::to_string(isOutlier), FALSE },
+		{ "elapsed_ms", number(result.ElapsedTime), FALSE },
+		{ "total_bytes", std::to_string(result.TotalFileSize), FALSE },
+		{ "throughput_mib_s", number(throughput), FALSE },
+		{ "peak_memory_mib", number(result.PeakMemory / (1024.0 * 1024.0)), FALSE },
+		{ "major_faults", std::to_string(result.MajorFaultCount), FALSE },
+		{ "minor_faults", std::to_string(result.MinorFaultCount), FALSE },
+		{ "dispatch_post_ns", number(result.DispatchPostNanoSeconds), FALSE },
+		{ "dispatch_get_ns", number(result.DispatchGetNanoSeconds), FALSE },
+		{ "queue_wait_p99_us", number(result.QueueWaitLatency.P99), FALSE },
+		{ "read_p99_us", number(result.ReadLatency.P99), FALSE },
+		{ "compute_wait_p99_us", number(result.ComputeWaitLatency.P99), FALSE },
+		{ "compute_p99_us", number(result.ComputeLatency.P99), FALSE },
+		{ "total_p50_us", number(result.TotalLatency.P50), FALSE },
+		{ "total_p90_us", number(result.TotalLatency.P90), FALSE },
+		{ "total_p99_us", number(result.TotalLatency.P99), FALSE },
+		{ "total_p999_us", number(result.TotalLatency.P999), FALSE },
+		{ "rebalance_switches", std::to_string(result.RebalanceSwitchCount), FALSE },
+		{ "rebalance_grows", std::to_string(result.RebalanceGrowCount), FALSE },
+		{ "rebalance_shrinks", std::to_string(result.RebalanceShrinkCount), FALSE },
+		{ "mean_readcall_threads", number(result.MeanReadCallThreadCount), FALSE },
+		{ "mean_compute_threads", number(result.MeanComputeThreadCount), FALSE },
+		{ "memory_budget_bytes", std::to_string(args.MemoryBudgetByteSize), FALSE },
+		{ "budget_waits", std::to_string(result.MemoryBudgetWaitCount), FALSE },
+		{ "budget_wait_ms", number(result.MemoryBudgetWaitTime), FALSE },
+		{ "budget_overcommits", std::to_string(result.MemoryBudgetOverCommitCount), FALSE },
+		{ "budget_high_water_mib", number(result.MemoryBudgetHighWaterByteSize / (1024.0 * 1024.0)), FALSE },
+		{ "nowait_read", std::to_string(args.UseNowaitRead), FALSE },
+		{ "nowait_hits", std::to_string(result.NowaitHitCount), FALSE },
+		{ "nowait_misses", std::to_string(result.NowaitMissCount), FALSE },
+		{ "nowait_hit_total_p50_us", number(result.NowaitHitTotalLatency.P50), FALSE },
+		{ "nowait_hit_total_p99_us", number(result.NowaitHitTotalLatency.P99), FALSE },
+		{ "nowait_miss_total_p50_us", number(result.NowaitMissTotalLatency.P50), FALSE },
+		{ "nowait_miss_total_p99_us", number(result.NowaitMissTotalLatency.P99), FALSE },
+		{ "nodes", std::to_string(result.NodeCount), FALSE },
+		{ "pinned_threads", std::to_string(result.PinnedThreadCount), FALSE },
+		{ "placed_buffers", std::to_string(result.PlacedBufferCount), FALSE },
+		{ "local_mib", number(localByteSize / (1024.0 * 1024.0)), FALSE },
+		{ "remote_mib", number(remoteByteSize / (1024.0 * 1024.0)), FALSE },
+		{ "coroutine_frame_bytes", std::to_string(result.CoroutineFrameByteSize), FALSE },
+		{ "coroutine_peak_frames", std::to_string(result.CoroutinePeakFrameCount), FALSE },
+		{ "coroutine_pool_mib", number(result.CoroutineFramePoolByteSize / (1024.0 * 1024.0)), FALSE },
+		{ "coroutine_suspends", std::to_string(result.CoroutineSuspendCount), FALSE },
+		{ "huge_page_buffers", std::to_string(result.HugePageBufferCount), FALSE },
+		{ "thp_buffers", std::to_string(result.TransparentHugePageBufferCount), FALSE },
+		{ "small_page_buffers", std::to_string(result.SmallPageBufferCount), FALSE },
+		{ "small_buffers", std::to_string(result.SmallBufferCount), FALSE },
+		{ "dtlb_misses", result.IsDtlbMissCounted ? std::to_string(result.DtlbMissCount) : "-1", FALSE },
+		{ "dtlb_misses_per_mib", number(result.IsDtlbMissCounted && result.TotalFileSize > 0 ? result.DtlbMissCount / (result.TotalFileSize / (1024.0 * 1024.0)) : -1), FALSE },
+		{ "offered_rate", number(result.OfferedRate), FALSE },
+		{ "completion_rate", number(result.ElapsedTime > 0 ? args.TestFileCount / (result.ElapsedTime / 1000.0) : 0), FALSE },
+		{ "arrival_lag_mean_us", number(result.MeanArrivalLag), FALSE },
+		{ "arrival_lag_max_us", number(result.MaxArrivalLag), FALSE },
+	};
+
+	if (g_outputFormat == OUTPUT_FORMAT_CSV)
+	{
+		if (FALSE == g_isHeaderWritten)
+		{
+			for (const Column& column : columnAry)
+				g_outputFile << (&column == columnAry ? "" : ",") << column.Name;
+			g_outputFile << "\n";
+			g_isHeaderWritten = TRUE;
+		}
+
+		for (const Column& column : columnAry)
+			g_outputFile << (&column == columnAry ? "" : ",") << column.Value;
+		g_outputFile << "\n";
+	}
+	else
+	{
+		g_outputFile << "{";
+		for (const Column& column : columnAry)
+		{
+			g_outputFile << (&column == columnAry ? "\"" : ",\"") << column.Name << "\":";
+			g_outputFile << (column.IsString ? "\"" : "") << column.Value << (column.IsString ? "\"" : "");
+		}
+		g_outputFile << "}\n";
+	}
+
+	// Keep finished rows if long sweep is stopped.
+	g_outputFile.flush();
+}
+
+void Sweep::CloseOutput()
+{
+	if (g_outputFile.is_open())
+		g_outputFile.close();
+}
+
+void Sweep::PrepareCache(const UINT fileCount, const DatasetLayoutType layout, const CacheModeType mode)
+{
+	if (mode == CACHE_MODE_ANY)
+		return;
+
+	std::vector<BYTE> buffer(1024 * 1024);
+
+	// Whole packed data file is brought into mode, files of later points included.
+	if (layout == DATASET_LAYOUT_PACKED)
+	{
+#ifdef _WIN32
+		const HANDLE fileHandle =
+			CreateFileW(
+				Dataset::g_packedDataPath,
+				GENERIC_READ,
+				FILE_SHARE_READ,
+				NULL,
+				OPEN_EXISTING,
+				mode == CACHE_MODE_COLD ? FILE_FLAG_NO_BUFFERING : FILE_FLAG_SEQUENTIAL_SCAN,
+				NULL);
+
+		if (fileHandle == INVALID_HANDLE_VALUE)
+			THROW_ERROR(L"Failed to open packed data file.");
+
+		DWORD readByteSize = 0;
+		while (mode == CACHE_MODE_WARM && TRUE == ReadFile(fileHandle, buffer.data(), static_cast<DWORD>(buffer.size()), &readByteSize, NULL) && readByteSize > 0);
+
+		CloseHandle(fileHandle);
+#else
+		const int fd = open(Dataset::g_packedDataPath, O_RDONLY);
+		if (fd < 0)
+			THROW_ERROR(L"Failed to open packed data file.");
+
+		if (mode == CACHE_MODE_COLD)
+			posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+
+		while (mode == CACHE_MODE_WARM && read(fd, buffer.data(), buffer.size()) > 0);
+
+		SAFE_CLOSE_FD(fd);
+#endif
+		return;
+	}
+
+	for (UINT fid = 0; fid < fileCount; fid++)
+	{
+#ifdef _WIN32
+		// Opening without buffering purges cached pages of file, if no other handle caches it.
+		const HANDLE fileHandle =
+			CreateFileW(
+				(L"dummy\\" + std::to_wstring(fid)).c_str(),
+				GENERIC_READ,
+				FILE_SHARE_READ,
+				NULL,
+				OPEN_EXISTING,
+				mode == CACHE_MODE_COLD ? FILE_FLAG_NO_BUFFERING : FILE_FLAG_SEQUENTIAL_SCAN,
+				NULL);
+
+		if (fileHandle == INVALID_HANDLE_VALUE)
+			THROW_ERROR(L"Failed to open file.");
+
+		DWORD readByteSize = 0;
+		while (mode == CACHE_MODE_WARM && TRUE == ReadFile(fileHandle, buffer.data(), static_cast<DWORD>(buffer.size()), &readByteSize, NULL) && readByteSize > 0);
+
+		CloseHandle(fileHandle);
+#else
+		const int fd = open(("dummy/" + std::to_string(fid)).c_str(), O_RDONLY);
+		if (fd < 0)
+			THROW_ERROR(L"Failed to open file.");
+
+		// Clean pages are dropped right away. Dataset is never written by tests, so all pages are clean.
+		if (mode == CACHE_MODE_COLD)
+			posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+
+		while (mode == CACHE_MODE_WARM && read(fd, buffer.data(), buffer.size()) > 0);
+
+		SAFE_CLOSE_FD(fd);
+#endif
+	}
+}
+
+const char* Sweep::GetSimulationName(const SimulationType simType)
+{
+	return simType < sizeof(g_simulationNameAry) / sizeof(g_simulationNameAry[0]) ? g_simulationNameAry[simType] : "UNKNOWN";
+}
+
+const char* Sweep::GetDatasetLayoutName(const DatasetLayoutType layout)
+{
+	return layout < sizeof(g_datasetLayoutNameAry) / sizeof(g_datasetLayoutNameAry[0]) ? g_datasetLayoutNameAry[layout] : "UNKNOWN";
+}
+
+const char* Sweep::GetPostOrderName(const PostOrderType order)
+{
+	return order < sizeof(g_postOrderNameAry) / sizeof(g_postOrderNameAry[0]) ? g_postOrderNameAry[order] : "UNKNOWN";
+}
+
+const char* Sweep::GetThreadPlacementName(const ThreadPlacementType placement)
+{
+	return placement < sizeof(g_threadPlacementNameAry) / sizeof(g_threadPlacementNameAry[0]) ? g_threadPlacementNameAry[placement] : "UNKNOWN";
+}
+
+const char* Sweep::GetBufferPageName(const BufferPageType bufferPage)
+{
+	return bufferPage < sizeof(g_bufferPageNameAry) / sizeof(g_bufferPageNameAry[0]) ? g_bufferPageNameAry[bufferPage] : "UNKNOWN";
+}
+
+const char* Sweep::GetArrivalName(const TestArgument& args)
+{
+	if (args.ArrivalRate == 0)
+		return "CLOSED";
+
+	return args.Arrival < sizeof(g_arrivalNameAry) / sizeof(g_arrivalNameAry[0]) ? g_arrivalNameAry[args.Arrival] : "UNKNOWN";
+}
@@ -1,5 +1,21 @@
 #include "pch.h"
 #include "ThreadSchedule.h"
+#include "Arrival.h"
+#include "BufferPool.h"
+#include "ComputeKernel.h"
+#include "ComputeModel.h"
+#include "Coroutine.h"
+#include "Dataset.h"
+#include "HugePage.h"
+#include "Latency.h"
+#include "MemoryBudget.h"
+#include "Rebalancer.h"
+#include "TaskQueue.h"
+#include "Topology.h"
+#include "Trace.h"
+#include "WorkStealingDeque.h"
+
+#ifdef _WIN32
 
 #define DO_TASK(key, type) \
 	const UINT fid = static_cast<UINT>(key); \
@@ -11,81 +27,182 @@
 		ComputeTaskWork(fid)
 
 #define WAIT_AND_DO_TASK(pRet, pKey, pLpov, type) \
-	GetQueuedCompletionStatus(type == THREAD_TASK_READ_CALL ? g_globalTaskQueue : g_globalWaitingQueue, pRet, pKey, pLpov, INFINITE); \
+	if (type == THREAD_TASK_READ_CALL) \
+	{ \
+		UINT taskFid; \
+		GetGlobalTask(&taskFid, INFINITE); \
+		*pKey = taskFid; \
+	} \
+	else \
+	{ \
+		GetQueuedCompletionStatus(g_globalWaitingQueue, pRet, pKey, pLpov, INFINITE); \
+		*pKey = GetCompletionFid(*pKey, *pLpov); \
+	} \
 	DO_TASK(*pKey, type)
 
-#ifdef _DEBUG
-using namespace Concurrency::diagnostic;
-#endif
-
 using namespace ThreadSchedule;
 
 // Test arguments, results.
 TestArgument g_testArgs;
 TestResult g_testResult;
 
+// Checksums of compute tasks are written here, so that they can't be optimized away.
+volatile int g_checksumSink;
+
 // Status.
 TaskMode g_taskMode;
 UINT g_completeFileCount;		// How much files are completed?
+std::atomic<UINT64> g_dispatchGetNanoSeconds;
+std::atomic<UINT64> g_dispatchGetCount;
+double g_timeToFirstByteSum;	// Only used when simulation type is STREAMING.
+double g_fileLatencySum;		// Only used when simulation type is STREAMING.
 
 // Thread works.
 HANDLE g_globalTaskQueue;		// Queue that store ReadCall tasks.
+TaskQueue g_userTaskQueue;		// Replaces g_globalTaskQueue if UseUserTaskQueue.
 HANDLE g_globalWaitingQueue;	// Queue that store Compute tasks.
 HANDLE* g_threadHandleAry;
 HANDLE* g_threadIocpAry;		// Queue that store tasks that should be completed by each thread.
+WorkStealingDeque* g_dequeAry;	// Only used when simulation type is WORK_STEALING. Indexed by thread.
+thread_local UINT t_threadIndex;	// Only used when simulation type is WORK_STEALING or COROUTINE.
+
+// Scheduler of coroutine thread. Touched only by its thread, and by coroutines it resumes.
+struct CoroutineScheduler
+{
+	UINT InflightCount;
+	std::coroutine_handle<> BudgetWaiter;	// Held back by memory budget. At most one, since no file starts while it waits.
+	UINT64 BudgetWaiterByteSize;
+	UINT64 SuspendCount;
+};
+
+// Coroutines. Only used when simulation type is COROUTINE.
+std::coroutine_handle<>* g_coroutineAry;	// Indexed by FID. Created suspended before threads take FID.
+thread_local CoroutineScheduler t_coroutineScheduler;
+std::atomic<UINT64> g_coroutineSuspendCount;
+
+// Work stealing stats.
+std::atomic<UINT64> g_stealReadCallCount;
+std::atomic<UINT64> g_stealComputeCount;
+std::atomic<UINT64> g_stealFailCount;
+std::atomic<UINT64> g_localComputeCount;
+
+// Bumped when work stealing task may have appeared, or last file is done. Idle threads park on it.
+std::atomic<UINT> g_workStealingEpoch;
+std::atomic<UINT> g_parkedStealerCount;
+
+// Wake threads parked in WorkStealingThreadFunc. Wake call is skipped while none is parked.
+static void WakeWorkStealingThreads()
+{
+	g_workStealingEpoch.fetch_add(1);
+	if (g_parkedStealerCount.load() > 0)
+		g_workStealingEpoch.notify_all();
+}
+
+// File status sync stats. Only used when simulation type is MANUAL.
+std::atomic<UINT64> g_fileSyncNanoSeconds;
+std::atomic<UINT64> g_fileSyncTaskCount;
+std::atomic<UINT64> g_fileSyncParkCount;
 
 // SRW locks.
-SRWLOCK g_srwFileStatus;
-SRWLOCK g_srwFileLock;
-SRWLOCK g_srwFileHandle;
-SRWLOCK g_srwFileIocp;
-SRWLOCK g_srwFileBuffer;
 SRWLOCK g_srwFileFinish;
 SRWLOCK g_srwTaskMode;
 
-// Shared resources.
-std::unordered_map<UINT, UINT> g_fileStatusMap;
-std::unordered_map<UINT, FileLock*> g_fileLockMap;
-std::unordered_map<UINT, HANDLE> g_fileHandleMap;
-std::unordered_map<UINT, HANDLE> g_fileIocpMap;
-std::unordered_map<UINT, BYTE*> g_fileBufferMap;
-std::unordered_map<UINT, UINT> g_fileBufferSizeMap;
+// Shared resources. Indexed by FID.
+FileSlot* g_fileSlotAry;
 
-void ThreadSchedule::ReadCallTaskWork(const UINT fid)
+// Packed dataset. Only used when dataset layout is PACKED.
+HANDLE g_packedHandle = INVALID_HANDLE_VALUE;
+HANDLE g_packedMapHandle = NULL;		// Only used when simulation type is MMAP.
+HANDLE* g_packedThreadHandleAry;		// Only used when simulation type is WORK_STEALING or COROUTINE. Indexed by thread, bound to its IOCP.
+DWORD g_allocationGranularity;
+thread_local HANDLE t_readEvent;		// Only used when simulation type is SYNC.
+
+// Open file of fid, and get its size and offset in it.
+// Packed dataset shares one handle, so shareMode, flag are only used for FILES.
+static HANDLE OpenDatasetFile(const UINT fid, const DWORD shareMode, const DWORD flag, PLARGE_INTEGER fileByteSize, UINT64* offset)
 {
-#ifdef _DEBUG
-	SERIES_INIT((std::to_wstring(GetCurrentThreadId()) + L" Read Call Task").c_str());
-	SPAN_INIT;
-	SPAN_START(0, _T("Create File (%d)", fid), fid);
-#endif
+	if (g_testArgs.DatasetLayout == DATASET_LAYOUT_PACKED)
+	{
+		const Dataset::ManifestEntry& entry = Dataset::GetEntry(fid);
+		fileByteSize->QuadPart = entry.ByteSize;
+		*offset = entry.Offset;
+
+		return g_testArgs.SimType == SIM_WORK_STEALING_THREAD || g_testArgs.SimType == SIM_COROUTINE_THREAD ? g_packedThreadHandleAry[t_threadIndex] : g_packedHandle;
+	}
 
-	const HANDLE fileHandle = 
+	const HANDLE fileHandle =
 		CreateFileW(
-			(L"dummy\\" + std::to_wstring(fid)).c_str(), 
-			GENERIC_READ, 
-			FILE_SHARE_READ, 
-			NULL, 
-			OPEN_EXISTING, 
-			g_fileFlag, 
+			(L"dummy\\" + std::to_wstring(fid)).c_str(),
+			GENERIC_READ,
+			shareMode,
+			NULL,
+			OPEN_EXISTING,
+			flag,
 			NULL);
 
-#ifdef _DEBUG
-	SPAN_END;
-	SPAN_START(0, _T("Get File Size (%d)"), fid);
-#endif
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		THROW_ERROR(L"Failed to open file.");
+
+	GetFileSizeEx(fileHandle, fileByteSize);
+	*offset = 0;
+
+	return fileHandle;
+}
+
+// Handle of packed dataset lives until end of test.
+static void CloseDatasetFile(HANDLE fileHandle)
+{
+	if (g_testArgs.DatasetLayout == DATASET_LAYOUT_FILES)
+		SAFE_CLOSE_HANDLE(fileHandle);
+}
+
+// Completion key of packed data file is shared, so FID comes from slot of OVERLAPPED.
+static ULONG_PTR GetCompletionFid(const ULONG_PTR key, const LPOVERLAPPED lpov)
+{
+	if (key != g_packedCompletionKey)
+		return key;
+
+	return CONTAINING_RECORD(lpov, FileSlot, Overlapped) - g_fileSlotAry;
+}
+
+void ThreadSchedule::ReadCallTaskWork(const UINT fid)
+{
+	SPAN_INIT;
+	SPAN_START(0, "Create File", fid);
+
+	Latency::Stamp(fid, Latency::STAGE_READ_START);
+
+	if (g_testArgs.UseRebalancer)
+	{
+		Rebalancer::AddQueueDepth(Rebalancer::ROLE_READCALL, -1);
+		Rebalancer::AddQueueDepth(Rebalancer::ROLE_COMPUTE, 1);
+	}
 
 	LARGE_INTEGER fileByteSize;
-	GetFileSizeEx(fileHandle, &fileByteSize);
+	UINT64 fileOffset;
+	const HANDLE fileHandle = OpenDatasetFile(fid, FILE_SHARE_READ, g_fileFlag, &fileByteSize, &fileOffset);
 
 	const DWORD alignedFileByteSize = GetAlignedByteSize(&fileByteSize, 512u);
 
-#ifdef _DEBUG
 	SPAN_END;
-	SPAN_START(0, _T("Create IOCP Handle (%d)"), fid);
-#endif
+	SPAN_START(0, "Memory Budget", fid);
+
+	// WORK_STEALING admits before task, since it must reap own reads before blocking.
+	if (g_testArgs.SimType != SIM_WORK_STEALING_THREAD)
+		MemoryBudget::Acquire(alignedFileByteSize);
+
+	SPAN_END;
+	SPAN_START(0, "Create IOCP Handle", fid);
 
+	// Packed data file is bound once per test. MANUAL waits on event of slot instead.
 	HANDLE fileIOCP = NULL;
-	if (g_testArgs.SimType == SIM_MANUAL_TASK_THREAD)
+	HANDLE slotEvent = NULL;
+	if (g_testArgs.DatasetLayout == DATASET_LAYOUT_PACKED)
+	{
+		if (g_testArgs.SimType == SIM_MANUAL_TASK_THREAD)
+			slotEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	}
+	else if (g_testArgs.SimType == SIM_MANUAL_TASK_THREAD)
 	{
 		fileIOCP = CreateIoCompletionPort(fileHandle, NULL, 0, 0);
 	}
@@ -93,241 +210,173 @@ void ThreadSchedule::ReadCallTaskWork(const UINT fid)
 	{
 		CreateIoCompletionPort(fileHandle, g_globalWaitingQueue, fid, 0);
 	}
+	else if (g_testArgs.SimType == SIM_WORK_STEALING_THREAD)
+	{
+		// Completion goes to thread that issued the read.
+		CreateIoCompletionPort(fileHandle, g_threadIocpAry[t_threadIndex], fid, 0);
+	}
 
-#ifdef _DEBUG
 	SPAN_END;
-	SPAN_START(0, _T("Buffer Allocation (%d)"), fid);
-#endif
+	SPAN_START(0, "Buffer Allocation", fid);
 
-	BYTE* fileBuffer = static_cast<BYTE*>(VirtualAlloc(NULL, alignedFileByteSize, MEM_COMMIT, PAGE_READWRITE));
+	BYTE* fileBuffer = AllocateFileBuffer(alignedFileByteSize);
 
-#ifdef _DEBUG
 	SPAN_END;
-	SPAN_START(0, _T("Write to Map (%d)"), fid);
-#endif
-
-	AcquireSRWLockExclusive(&g_srwFileHandle);
-	{
-		if (FALSE == g_fileHandleMap.contains(fid))
-			g_fileHandleMap[fid] = fileHandle;
-	}
-	ReleaseSRWLockExclusive(&g_srwFileHandle);
-
-	if (g_testArgs.SimType == SIM_MANUAL_TASK_THREAD)
-	{
-		AcquireSRWLockExclusive(&g_srwFileIocp);
-		{
-			if (FALSE == g_fileIocpMap.contains(fid))
-				g_fileIocpMap[fid] = fileIOCP;
-		}
-		ReleaseSRWLockExclusive(&g_srwFileIocp);
-	}
+	SPAN_START(0, "Write to Slot", fid);
 
-	AcquireSRWLockExclusive(&g_srwFileBuffer);
-	{
-		if (FALSE == g_fileBufferMap.contains(fid))
-			g_fileBufferMap[fid] = fileBuffer;
-		
-		if (FALSE == g_fileBufferSizeMap.contains(fid))
-			g_fileBufferSizeMap[fid] = fileByteSize.QuadPart;
+	FileSlot& slot = g_fileSlotAry[fid];
+	slot.FileHandle = fileHandle;
+	slot.FileIocp = fileIOCP;
+	slot.Overlapped = { 0 };
+	slot.Overlapped.Offset = static_cast<DWORD>(fileOffset);
+	slot.Overlapped.OffsetHigh = static_cast<DWORD>(fileOffset >> 32);
+	slot.Overlapped.hEvent = slotEvent;
+	slot.Buffer = fileBuffer;
+	slot.BufferSize = fileByteSize.QuadPart;
+	slot.Published.store(TRUE, std::memory_order_release);
 
-		g_testResult.TotalFileSize += fileByteSize.QuadPart;
-	}
-	ReleaseSRWLockExclusive(&g_srwFileBuffer);
+	InterlockedExchangeAdd64(reinterpret_cast<volatile LONG64*>(&g_testResult.TotalFileSize), fileByteSize.QuadPart);
 
-#ifdef _DEBUG
 	SPAN_END;
-	SPAN_START(0, _T("ReadFile Call (%d)"), fid);
-#endif
+	SPAN_START(0, "ReadFile Call", fid);
 
-	OVERLAPPED ov = { 0 };
-	if (FALSE == ReadFile(fileHandle, fileBuffer, alignedFileByteSize, NULL, &ov) && GetLastError() != ERROR_IO_PENDING)
+	if (FALSE == ReadFile(fileHandle, fileBuffer, alignedFileByteSize, NULL, &slot.Overlapped) && GetLastError() != ERROR_IO_PENDING)
 		THROW_ERROR(L"Failed to call ReadFile.");
 
-#ifdef _DEBUG
 	SPAN_END;
-#endif
 }
 
 void ThreadSchedule::CompletionTaskWork(const UINT fid)
 {
-#ifdef _DEBUG
-	SERIES_INIT((std::to_wstring(GetCurrentThreadId()) + L" Completion Task").c_str());
 	SPAN_INIT;
-	SPAN_START(1, _T("Completion (%d)"), fid);
-#endif
+	SPAN_START(1, "Completion", fid);
 
-	HANDLE fileIocp = NULL;
-	AcquireSRWLockShared(&g_srwFileIocp);
-	{
-		fileIocp = g_fileIocpMap[fid];
-	}
-	ReleaseSRWLockShared(&g_srwFileIocp);
+	FileSlot& slot = AcquireFileSlot(fid);
 
 	DWORD ret;
 	ULONG_PTR key;
 	LPOVERLAPPED lpov;
 
-	GetQueuedCompletionStatus(fileIocp, &ret, &key, &lpov, INFINITE);
+	// Packed data file is shared, so read is waited by event of slot.
+	if (slot.FileIocp != NULL)
+		GetQueuedCompletionStatus(slot.FileIocp, &ret, &key, &lpov, INFINITE);
+	else
+		GetOverlappedResult(slot.FileHandle, &slot.Overlapped, &ret, TRUE);
+	Latency::Stamp(fid, Latency::STAGE_READ_COMPLETE);
 
-#ifdef _DEBUG
 	SPAN_END;
-#endif
 }
 
 void ThreadSchedule::ComputeTaskWork(const UINT fid)
 {
-#ifdef _DEBUG
-	SERIES_INIT((std::to_wstring(GetCurrentThreadId()) + L" Compute Task").c_str());
 	SPAN_INIT;
-	SPAN_START(2, _T("Compute (%d)"), fid);
-#endif
+	SPAN_START(2, "Compute", fid);
 
-	TIMER_INIT;
-	TIMER_START;
+	// Completion packet of ROLE_SPECIFIED is observed only when compute thread takes it.
+	if (g_testArgs.SimType == SIM_ROLE_SPECIFIED_THREAD)
+		Latency::Stamp(fid, Latency::STAGE_READ_COMPLETE);
 
-	BYTE* bufferAddress = nullptr;
-	UINT bufferSize = 0;
-	AcquireSRWLockShared(&g_srwFileBuffer);
-	{
-		bufferAddress = g_fileBufferMap[fid];
-		bufferSize = g_fileBufferSizeMap[fid];
-	}
-	ReleaseSRWLockShared(&g_srwFileBuffer);
+	Latency::Stamp(fid, Latency::STAGE_COMPUTE_START);
+
+	if (g_testArgs.UseRebalancer)
+		Rebalancer::AddQueueDepth(Rebalancer::ROLE_COMPUTE, -1);
+
+	FileSlot& slot = AcquireFileSlot(fid);
+	BYTE* bufferAddress = slot.Buffer;
+	const UINT bufferSize = slot.BufferSize;
 
 	if (g_testArgs.UseDefinedComputeTime)
 	{
 		UINT timeOverMicroSeconds;
-		BOOL exit = FALSE;
 		memcpy(&timeOverMicroSeconds, bufferAddress, sizeof(UINT));
-		
-		TIMER_STOP;
-		while (el * 1000 * 1000 <= timeOverMicroSeconds)
-		{
-			// Calculate checksum with time limit.
-			{
-				int checkSum = 0;
-				int sum = 0;
-
-				for (int i = 0; i < bufferSize; i++)
-				{
-					sum += bufferAddress[i];
 
-					TIMER_STOP;
-					if (el * 1000 * 1000 > timeOverMicroSeconds)
-					{
-						exit = TRUE;
-						break;
-					}
-				}
-
-				if (exit)
-					break;
-
-				checkSum = sum;
-				checkSum = checkSum & 0xFF;
-				checkSum = ~checkSum + 1;
-
-				int res = checkSum + sum;
-				res = res & 0xFF;
-			}
-		}
+		// Calculate checksum with calibrated compute model.
+		g_checksumSink = ComputeModel::Run(bufferAddress, bufferSize, timeOverMicroSeconds);
 	}
 	else
 	{
 		// Calculate checksum with count limit.
 		for (int x = 0; x < g_computeLoopCount; x++)
 		{
-			int checkSum = 0;
-			int sum = 0;
-
-			for (int i = 0; i < bufferSize; i++)
-			{
-				sum += bufferAddress[i];
-			}
-
-			checkSum = sum;
-			checkSum = checkSum & 0xFF;
-			checkSum = ~checkSum + 1;
-
-			int res = checkSum + sum;
-			res = res & 0xFF;
+			g_checksumSink = ComputeKernel::Checksum(bufferAddress, bufferSize);
 		}
 	}
 
-#ifdef _DEBUG
+	Latency::Complete(fid);
+	Topology::AddTraffic(bufferAddress, bufferSize);
+
 	SPAN_END;
-	SPAN_START(2, _T("Release (%d)"), fid);
-#endif
+	SPAN_START(2, "Release", fid);
 
 	// Release resources.
 	if (bufferAddress != nullptr)
-		VirtualFree(bufferAddress, 0, MEM_RELEASE);
-
-	if (g_testArgs.SimType == SIM_MANUAL_TASK_THREAD)
 	{
-		AcquireSRWLockShared(&g_srwFileIocp);
-		if (g_fileIocpMap.contains(fid))
-			SAFE_CLOSE_HANDLE(g_fileIocpMap[fid]);
-		ReleaseSRWLockShared(&g_srwFileIocp);
+		LARGE_INTEGER bufferByteSize;
+		bufferByteSize.QuadPart = bufferSize;
+		ReleaseFileBuffer(bufferAddress, GetAlignedByteSize(&bufferByteSize, 512u));
+		MemoryBudget::Release(GetAlignedByteSize(&bufferByteSize, 512u));
 	}
 
-	AcquireSRWLockShared(&g_srwFileHandle);
-	if (g_fileHandleMap.contains(fid))
-		SAFE_CLOSE_HANDLE(g_fileHandleMap[fid]);
-	ReleaseSRWLockShared(&g_srwFileHandle);
+	if (g_testArgs.SimType == SIM_MANUAL_TASK_THREAD && slot.FileIocp != NULL)
+		SAFE_CLOSE_HANDLE(slot.FileIocp);
+
+	if (slot.Overlapped.hEvent != NULL)
+		SAFE_CLOSE_HANDLE(slot.Overlapped.hEvent);
+
+	CloseDatasetFile(slot.FileHandle);
 
 	AcquireSRWLockExclusive(&g_srwFileFinish);
 	g_completeFileCount++;
-	if (g_completeFileCount == g_testArgs.TestFileCount)
+	const BOOL isLastFile = g_completeFileCount == g_testArgs.TestFileCount;
+	if (g_testArgs.SimType == SIM_ROLE_SPECIFIED_THREAD && isLastFile)
 	{
+		// Parked threads of pool exit from Rebalancer::Join.
+		if (g_testArgs.UseRebalancer)
+			Rebalancer::Stop();
+
 		for (UINT t = 0; t < g_testArgs.ThreadCount; t++)
 		{
 			OVERLAPPED ov = { 0 };
-			PostQueuedCompletionStatus(g_globalTaskQueue, 0, g_exitCode, &ov);
+			PostGlobalTask(g_exitCode);
 			PostQueuedCompletionStatus(g_globalWaitingQueue, 0, g_exitCode, &ov);
 		}
 	}
 	ReleaseSRWLockExclusive(&g_srwFileFinish);
 
-#ifdef _DEBUG
+	// Parked work stealing threads must see last file done.
+	if (g_testArgs.SimType == SIM_WORK_STEALING_THREAD && isLastFile)
+		WakeWorkStealingThreads();
+
 	SPAN_END;
-#endif
 }
 
 void ThreadSchedule::MMAPTaskWork(UINT fid)
 {
-#ifdef _DEBUG
-	SERIES_INIT((std::to_wstring(GetCurrentThreadId()) + L" FileMap").c_str());
 	SPAN_INIT;
-	SPAN_START(0, _T("Create File (%d)"), fid);
-#endif
+	SPAN_START(0, "Create File", fid);
 
-	const HANDLE fileHandle =
-		CreateFileW(
-			(L"dummy\\" + std::to_wstring(fid)).c_str(),
-			GENERIC_READ,
-			0,
-			NULL,
-			OPEN_EXISTING,
-			FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED,
-			NULL);
+	Latency::Stamp(fid, Latency::STAGE_READ_START);
 
-	if (fileHandle == INVALID_HANDLE_VALUE)
-		THROW_ERROR(L"Failed to open file.");
+	LARGE_INTEGER fileByteSize;
+	UINT64 fileOffset;
+	const HANDLE fileHandle = OpenDatasetFile(fid, 0, FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED, &fileByteSize, &fileOffset);
 
-#ifdef _DEBUG
 	SPAN_END;
-#endif
 
-	LARGE_INTEGER fileByteSize;
-	GetFileSizeEx(fileHandle, &fileByteSize);
+	// View must start at allocation granularity, so file starts viewDelta bytes into it.
+	const UINT64 viewOffset = fileOffset / g_allocationGranularity * g_allocationGranularity;
+	const SIZE_T viewDelta = static_cast<SIZE_T>(fileOffset - viewOffset);
 
-#ifdef _DEBUG
-	SPAN_START(0, _T("CreateFileMapping (%d)"), fid);
-#endif
+	// Mapped pages are resident until unmap, so whole view counts against budget.
+	const DWORD mapByteSize = GetAlignedByteSize(&fileByteSize, 4096u);
+	MemoryBudget::Acquire(mapByteSize);
+
+	SPAN_START(0, "CreateFileMapping", fid);
 
+	// Packed data file is mapped once per test.
 	const HANDLE mapHandle =
+		g_testArgs.DatasetLayout == DATASET_LAYOUT_PACKED ?
+		g_packedMapHandle :
 		CreateFileMapping(
 			fileHandle,
 			NULL,
@@ -339,57 +388,47 @@ void ThreadSchedule::MMAPTaskWork(UINT fid)
 	if (mapHandle == 0)
 		THROW_ERROR(L"Failed to map file.");
 
-#ifdef _DEBUG
 	SPAN_END;
-	SPAN_START(0, _T("MapViewOfFile (%d)"), fid);
-#endif
+	SPAN_START(0, "MapViewOfFile", fid);
 
 	const LPVOID mapView =
 		MapViewOfFile(
 			mapHandle,
 			FILE_MAP_READ,
-			0,
-			0,
-			0
+			static_cast<DWORD>(viewOffset >> 32),
+			static_cast<DWORD>(viewOffset),
+			g_testArgs.DatasetLayout == DATASET_LAYOUT_PACKED ? viewDelta + static_cast<SIZE_T>(fileByteSize.QuadPart) : 0
 		);
 
 	if (mapView == NULL)
 		THROW_ERROR(L"Failed to create view of file.");
 
-#ifdef _DEBUG
+	// Pages are read by faults during compute, so read stage ends at mapping.
+	Latency::Stamp(fid, Latency::STAGE_READ_COMPLETE);
+	Latency::Stamp(fid, Latency::STAGE_COMPUTE_START);
+
 	SPAN_END;
-	SPAN_START(2, _T("Compute (%d)"), fid);
-#endif
+	SPAN_START(2, "Compute", fid);
 
-	BYTE* ptr = (BYTE*)mapView;
+	BYTE* ptr = (BYTE*)mapView + viewDelta;
 
 	// Calculate checksum with count limit.
 	for (int x = 0; x < g_computeLoopCount; x++)
 	{
-		int checkSum = 0;
-		int sum = 0;
-
-		for (int i = 0; i < fileByteSize.QuadPart; i++)
-		{
-			sum += ptr[i];
-		}
-
-		checkSum = sum;
-		checkSum = checkSum & 0xFF;
-		checkSum = ~checkSum + 1;
-
-		int res = checkSum + sum;
-		res = res & 0xFF;
+		g_checksumSink = ComputeKernel::Checksum(ptr, fileByteSize.QuadPart);
 	}
 
-#ifdef _DEBUG
+	Latency::Complete(fid);
+	Topology::AddTraffic(ptr, fileByteSize.QuadPart);
+
 	SPAN_END;
-#endif
 
 	// Release resources.
 	UnmapViewOfFile(mapView);
-	SAFE_CLOSE_HANDLE(mapHandle);
-	SAFE_CLOSE_HANDLE(fileHandle);
+	MemoryBudget::Release(mapByteSize);
+	if (g_testArgs.DatasetLayout == DATASET_LAYOUT_FILES)
+		SAFE_CLOSE_HANDLE(mapHandle);
+	CloseDatasetFile(fileHandle);
 
 	AcquireSRWLockExclusive(&g_srwFileFinish);
 	g_completeFileCount++;
@@ -397,129 +436,85 @@ void ThreadSchedule::MMAPTaskWork(UINT fid)
 	if (g_completeFileCount == g_testArgs.TestFileCount)
 	{
 		for (UINT t = 0; t < g_testArgs.ThreadCount; t++)
-		{
-			OVERLAPPED ov = { 0 };
-			PostQueuedCompletionStatus(g_globalTaskQueue, 0, g_exitCode, &ov);
-		}
+			PostGlobalTask(g_exitCode);
 	}
 	ReleaseSRWLockExclusive(&g_srwFileFinish);
 }
 
 void ThreadSchedule::SyncTaskWork(UINT fid)
 {
-#ifdef _DEBUG
-	SERIES_INIT((std::to_wstring(GetCurrentThreadId()) + L" Sync").c_str());
 	SPAN_INIT;
-	SPAN_START(0, _T("Create File (%d)"), fid);
-#endif
+	SPAN_START(0, "Create File", fid);
 
-	const HANDLE fileHandle =
-		CreateFileW(
-			(L"dummy\\" + std::to_wstring(fid)).c_str(),
-			GENERIC_READ,
-			0,
-			NULL,
-			OPEN_EXISTING,
-			FILE_FLAG_NO_BUFFERING,
-			NULL);
+	Latency::Stamp(fid, Latency::STAGE_READ_START);
 
-	if (fileHandle == INVALID_HANDLE_VALUE)
-		THROW_ERROR(L"Failed to open file.");
+	LARGE_INTEGER fileByteSize;
+	UINT64 fileOffset;
+	const HANDLE fileHandle = OpenDatasetFile(fid, 0, FILE_FLAG_NO_BUFFERING, &fileByteSize, &fileOffset);
 
-#ifdef _DEBUG
 	SPAN_END;
-	SPAN_START(0, _T("Buffer Allocation (%d)"), fid);
-#endif
+	SPAN_START(0, "Buffer Allocation", fid);
 
-	LARGE_INTEGER fileByteSize;
-	GetFileSizeEx(fileHandle, &fileByteSize);
 	const DWORD alignedFileByteSize = GetAlignedByteSize(&fileByteSize, 512u);
 
-	BYTE* fileBuffer = static_cast<BYTE*>(VirtualAlloc(NULL, alignedFileByteSize, MEM_COMMIT, PAGE_READWRITE));
+	MemoryBudget::Acquire(alignedFileByteSize);
+
+	BYTE* fileBuffer = AllocateFileBuffer(alignedFileByteSize);
 
-#ifdef _DEBUG
 	SPAN_END;
-	SPAN_START(1, _T("ReadFile (%d)"), fid);
-#endif
+	SPAN_START(1, "ReadFile", fid);
 
-	if (FALSE == ReadFile(fileHandle, fileBuffer, alignedFileByteSize, NULL, NULL) && GetLastError() != ERROR_IO_PENDING)
+	if (g_testArgs.DatasetLayout == DATASET_LAYOUT_PACKED)
+	{
+		// Packed data file is shared and overlapped. Read at offset, then wait.
+		OVERLAPPED ov = { 0 };
+		ov.Offset = static_cast<DWORD>(fileOffset);
+		ov.OffsetHigh = static_cast<DWORD>(fileOffset >> 32);
+		ov.hEvent = t_readEvent;
+
+		DWORD transferred;
+		if (FALSE == ReadFile(fileHandle, fileBuffer, alignedFileByteSize, NULL, &ov) && GetLastError() != ERROR_IO_PENDING)
+			THROW_ERROR(L"Failed to call ReadFile.");
+		if (FALSE == GetOverlappedResult(fileHandle, &ov, &transferred, TRUE) && GetLastError() != ERROR_HANDLE_EOF)
+			THROW_ERROR(L"Failed to read file.");
+	}
+	else if (FALSE == ReadFile(fileHandle, fileBuffer, alignedFileByteSize, NULL, NULL) && GetLastError() != ERROR_IO_PENDING)
+	{
 		THROW_ERROR(L"Failed to call ReadFile.");
+	}
 
-#ifdef _DEBUG
-	SPAN_END;
-	SPAN_START(2, _T("Compute (%d)"), fid);
-#endif
+	Latency::Stamp(fid, Latency::STAGE_READ_COMPLETE);
+	Latency::Stamp(fid, Latency::STAGE_COMPUTE_START);
 
-	TIMER_INIT;
-	TIMER_START;
+	SPAN_END;
+	SPAN_START(2, "Compute", fid);
 
 	if (g_testArgs.UseDefinedComputeTime)
 	{
 		UINT timeOverMicroSeconds;
-		BOOL exit = FALSE;
 		memcpy(&timeOverMicroSeconds, fileBuffer, sizeof(UINT));
 
-		TIMER_STOP;
-		while (el * 1000 * 1000 <= timeOverMicroSeconds)
-		{
-			// Calculate checksum with time limit.
-			{
-				int checkSum = 0;
-				int sum = 0;
-
-				for (int i = 0; i < fileByteSize.QuadPart; i++)
-				{
-					sum += fileBuffer[i];
-
-					TIMER_STOP;
-					if (el * 1000 * 1000 > timeOverMicroSeconds)
-					{
-						exit = TRUE;
-						break;
-					}
-				}
-
-				if (exit)
-					break;
-
-				checkSum = sum;
-				checkSum = checkSum & 0xFF;
-				checkSum = ~checkSum + 1;
-
-				int res = checkSum + sum;
-				res = res & 0xFF;
-			}
-		}
+		// Calculate checksum with calibrated compute model.
+		g_checksumSink = ComputeModel::Run(fileBuffer, fileByteSize.QuadPart, timeOverMicroSeconds);
 	}
 	else
 	{
 		// Calculate checksum with count limit.
 		for (int x = 0; x < g_computeLoopCount; x++)
 		{
-			int checkSum = 0;
-			int sum = 0;
-
-			for (int i = 0; i < fileByteSize.QuadPart; i++)
-			{
-				sum += fileBuffer[i];
-			}
-
-			checkSum = sum;
-			checkSum = checkSum & 0xFF;
-			checkSum = ~checkSum + 1;
-
-			int res = checkSum + sum;
-			res = res & 0xFF;
+			g_checksumSink = ComputeKernel::Checksum(fileBuffer, fileByteSize.QuadPart);
 		}
 	}
 
-#ifdef _DEBUG
+	Latency::Complete(fid);
+	Topology::AddTraffic(fileBuffer, fileByteSize.QuadPart);
+
 	SPAN_END;
-#endif
 
 	// Release resources.
-	VirtualFree(fileBuffer, 0, MEM_RELEASE);
-	SAFE_CLOSE_HANDLE(fileHandle);
+	ReleaseFileBuffer(fileBuffer, alignedFileByteSize);
+	MemoryBudget::Release(alignedFileByteSize);
+	CloseDatasetFile(fileHandle);
 
 	AcquireSRWLockExclusive(&g_srwFileFinish);
 	g_completeFileCount++;
@@ -527,133 +522,249 @@ void ThreadSchedule::SyncTaskWork(UINT fid)
 	if (g_completeFileCount == g_testArgs.TestFileCount)
 	{
 		for (UINT t = 0; t < g_testArgs.ThreadCount; t++)
-		{
-			OVERLAPPED ov = { 0 };
-			PostQueuedCompletionStatus(g_globalTaskQueue, 0, g_exitCode, &ov);
-		}
+			PostGlobalTask(g_exitCode);
 	}
 	ReleaseSRWLockExclusive(&g_srwFileFinish);
 }
 
-DWORD ThreadSchedule::HandleLockAcquireFailure(const UINT fid, const UINT threadTaskType)
+void ThreadSchedule::StreamTaskWork(const UINT fid, BYTE* slotBuffer, OVERLAPPED* slotOvAry)
 {
-	const HANDLE* fileSemAry = g_fileLockMap[fid]->semLock;
-	const HANDLE* taskEndEvAry = g_fileLockMap[fid]->taskEndEvent;
+	SPAN_INIT;
+	SPAN_START(0, "Create File", fid);
 
-	UINT fileStatus = 0;
-	AcquireSRWLockShared(&g_srwFileStatus);
-	{
-		fileStatus = g_fileStatusMap[fid];
-	}
-	ReleaseSRWLockShared(&g_srwFileStatus);
+	Latency::Stamp(fid, Latency::STAGE_READ_START);
 
-	// Another thread is processing pre-require task.
-	if (fileStatus < threadTaskType * 3)
-	{
-		// Waiting until pre-require task ends.
-		const DWORD result = WaitForSingleObject(fileSemAry[threadTaskType], INFINITE);
+	TIMER_INIT;
+	TIMER_START;
 
-		// Do your job!
-		return result;
-	}
+	LARGE_INTEGER fileByteSize;
+	UINT64 fileOffset;
+	const HANDLE fileHandle = OpenDatasetFile(fid, FILE_SHARE_READ, g_fileFlag, &fileByteSize, &fileOffset);
 
-	// Another thread is processing requested task.
-	if (threadTaskType * 3 <= fileStatus && fileStatus < (threadTaskType + 1) * 3)
-	{
-		// Waiting until requested task ends.
-		WaitForSingleObject(taskEndEvAry[threadTaskType], INFINITE);
+	const DWORD segmentByteSize = g_testArgs.StreamSegmentByteSize;
+	const UINT segmentCount = max(1u, static_cast<UINT>((fileByteSize.QuadPart + segmentByteSize - 1) / segmentByteSize));
+	const UINT slotCount = min(g_testArgs.StreamInflightCount, segmentCount);
 
-		// Ignore your job!
-		return WAIT_TIMEOUT;
-	}
+	SPAN_END;
+	SPAN_START(1, "ReadFile Call", fid);
 
-	// Another thread is processing post-require task.
-	if ((threadTaskType + 1) * 3 <= fileStatus)
+	// Segment k is read into slot (k % slotCount).
+	auto readSegment = [&](const UINT segment)
 	{
-		// Ignore your job!
-		return WAIT_TIMEOUT;
-	}
+		const UINT slot = segment % slotCount;
+		const UINT64 offset = fileOffset + static_cast<UINT64>(segment) * segmentByteSize;
 
-	return WAIT_TIMEOUT;
-}
+		const HANDLE slotEvent = slotOvAry[slot].hEvent;
+		slotOvAry[slot] = { 0 };
+		slotOvAry[slot].Offset = static_cast<DWORD>(offset);
+		slotOvAry[slot].OffsetHigh = static_cast<DWORD>(offset >> 32);
+		slotOvAry[slot].hEvent = slotEvent;
 
-void ThreadSchedule::DoThreadTaskManual(ThreadTaskArgs* args, const UINT threadTaskType)
-{
-#ifdef _DEBUG
-	SERIES_INIT(std::to_wstring(GetCurrentThreadId()).c_str());
-	SPAN_INIT;
-#endif
+		if (FALSE == ReadFile(fileHandle, slotBuffer + static_cast<SIZE_T>(slot) * segmentByteSize, segmentByteSize, NULL, &slotOvAry[slot]) && GetLastError() != ERROR_IO_PENDING)
+			THROW_ERROR(L"Failed to call ReadFile.");
+	};
 
-	const UINT fid = args->FID;
-	const HANDLE* fileSemAry = g_fileLockMap[fid]->semLock;
-	const HANDLE* taskEndEvAry = g_fileLockMap[fid]->taskEndEvent;
+	for (UINT segment = 0; segment < slotCount; segment++)
+		readSegment(segment);
+
+	SPAN_END;
+	SPAN_START(2, "Compute", fid);
+
+	double timeToFirstByte = 0;
+	UINT timeOverMicroSeconds = 0;
+	int sum = 0;
 
-	DWORD waitResult = WaitForSingleObject(fileSemAry[threadTaskType], 0L);
-	if (waitResult == WAIT_TIMEOUT)	// If failed to get lock...
+	for (UINT segment = 0; segment < segmentCount; segment++)
 	{
-		waitResult = HandleLockAcquireFailure(fid, threadTaskType);
-		if (waitResult == WAIT_TIMEOUT)
+		const UINT slot = segment % slotCount;
+
+		DWORD transferred = 0;
+		if (FALSE == GetOverlappedResult(fileHandle, &slotOvAry[slot], &transferred, TRUE) && GetLastError() != ERROR_HANDLE_EOF)
+			THROW_ERROR(L"Failed to read segment.");
+
+		const BYTE* segmentAddress = slotBuffer + static_cast<SIZE_T>(slot) * segmentByteSize;
+		const DWORD computeByteSize = static_cast<DWORD>(min(static_cast<UINT64>(segmentByteSize), fileByteSize.QuadPart - static_cast<UINT64>(segment) * segmentByteSize));
+
+		// Read and compute overlap. Stages end at first segment.
+		if (segment == 0)
 		{
-			HeapFree(GetProcessHeap(), 0, args);
-			return;
-		}
-	}
+			TIMER_STOP;
+			timeToFirstByte = el * 1000;
+			memcpy(&timeOverMicroSeconds, segmentAddress, sizeof(UINT));
 
-	AcquireSRWLockExclusive(&g_srwFileStatus);
-	InterlockedIncrement(&g_fileStatusMap[fid]);
-	ReleaseSRWLockExclusive(&g_srwFileStatus);
+			Latency::Stamp(fid, Latency::STAGE_READ_COMPLETE);
+			Latency::Stamp(fid, Latency::STAGE_COMPUTE_START);
+		}
 
-	const LPCTSTR format =
-		threadTaskType == THREAD_TASK_READ_CALL ? L"Read Call Task (%d)" :
-		threadTaskType == THREAD_TASK_COMPLETION ? L"Completion Task (%d)" :
-		L"Compute Task (%d)";
+		// Compute time of file is shared by segments, proportional to size.
+		const double segmentTimeOverMicroSeconds =
+			fileByteSize.QuadPart == 0 ? 0 : static_cast<double>(timeOverMicroSeconds) * computeByteSize / fileByteSize.QuadPart;
 
-#ifdef _DEBUG
-	SPAN_START(threadTaskType, format, fid);
-#endif
+		sum = ComputeSegment(segmentAddress, computeByteSize, sum, segmentTimeOverMicroSeconds);
+		Topology::AddTraffic(segmentAddress, computeByteSize);
 
-	// Do task with thread type.
-	switch (threadTaskType)
-	{
-	case THREAD_TASK_READ_CALL:
-		ReadCallTaskWork(fid);
-		break;
-	case THREAD_TASK_COMPLETION:
-		CompletionTaskWork(fid);
-		break;
-	case THREAD_TASK_COMPUTE:
-		ComputeTaskWork(fid);
-		break;
+		// Slot is free now. Read next segment into it.
+		if (segment + slotCount < segmentCount)
+			readSegment(segment + slotCount);
 	}
 
-#ifdef _DEBUG
+	g_checksumSink = ComputeKernel::FoldChecksum(sum);
+
+	TIMER_STOP;
+	Latency::Complete(fid);
+
 	SPAN_END;
-#endif
 
-	AcquireSRWLockExclusive(&g_srwFileStatus);
-	InterlockedIncrement(&g_fileStatusMap[fid]);
-	ReleaseSRWLockExclusive(&g_srwFileStatus);
+	// Release resources.
+	CloseDatasetFile(fileHandle);
 
-	if (threadTaskType < THREAD_TASK_COMPUTE)
+	AcquireSRWLockExclusive(&g_srwFileFinish);
+	g_completeFileCount++;
+	g_testResult.TotalFileSize += fileByteSize.QuadPart;
+	g_timeToFirstByteSum += timeToFirstByte;
+	g_fileLatencySum += el * 1000;
+	g_testResult.MaxFileLatency = max(g_testResult.MaxFileLatency, el * 1000);
+	if (g_completeFileCount == g_testArgs.TestFileCount)
 	{
-		// Release lock. Next task can be entered now.
-		ReleaseSemaphore(fileSemAry[threadTaskType + 1], 1, NULL);
-
-		AcquireSRWLockExclusive(&g_srwFileStatus);
-		InterlockedIncrement(&g_fileStatusMap[fid]);
-		ReleaseSRWLockExclusive(&g_srwFileStatus);
+		for (UINT t = 0; t < g_testArgs.ThreadCount; t++)
+			PostGlobalTask(g_exitCode);
 	}
+	ReleaseSRWLockExclusive(&g_srwFileFinish);
+}
 
-	SetEvent(taskEndEvAry[threadTaskType]);
-	HeapFree(GetProcessHeap(), 0, args);
+int ThreadSchedule::ComputeSegment(const BYTE* segment, const DWORD segmentByteSize, int sum, const double timeOverMicroSeconds)
+{
+	// Calculate checksum with calibrated compute model.
+	// Run returns folded checksum (0-255) of bytes it streamed, not byte sum of segment, so sum differs from count limit path.
+	if (g_testArgs.UseDefinedComputeTime)
+		return sum + ComputeModel::Run(segment, segmentByteSize, timeOverMicroSeconds);
+
+	// Calculate checksum with count limit.
+	int segmentSum = 0;
+	for (UINT x = 0; x < g_computeLoopCount; x++)
+		segmentSum = static_cast<int>(ComputeKernel::ByteSum(segment, segmentByteSize));
+
+	return sum + segmentSum;
 }
 
-DWORD WINAPI ThreadSchedule::ManualThreadFunc(const LPVOID param)
+DWORD ThreadSchedule::AcquireFileTask(const UINT fid, const UINT threadTaskType)
 {
-	const HANDLE threadIOCPHandle = param;
+	std::atomic<UINT>& fileStatus = g_fileSlotAry[fid].Status;
 
-	OVERLAPPED_ENTRY entryAry[g_taskRemoveCount];
-	ULONG entRemoved;
+	const UINT waitingStatus = threadTaskType * 3;
+	UINT spinCount = 0;
+
+	while (TRUE)
+	{
+		UINT status = fileStatus.load(std::memory_order_acquire);
+		const UINT fileStatusType = status & ~g_fileStatusWaiterBit;
+
+		// Pre-require task ended. Do your job!
+		if (fileStatusType == waitingStatus)
+		{
+			if (fileStatus.compare_exchange_weak(status, (waitingStatus + 1) | (status & g_fileStatusWaiterBit), std::memory_order_acq_rel))
+				return WAIT_OBJECT_0;
+
+			continue;
+		}
+
+		// Requested task or post-require task ended. Ignore your job!
+		if (fileStatusType > waitingStatus + 1)
+			return WAIT_TIMEOUT;
+
+		// Another thread is processing pre-require task, or requested task.
+		// Spin a little, then park until status word changes.
+		if (spinCount < g_fileStatusSpinCount)
+		{
+			spinCount++;
+			YieldProcessor();
+			continue;
+		}
+
+		if ((status & g_fileStatusWaiterBit) == 0 &&
+			FALSE == fileStatus.compare_exchange_weak(status, status | g_fileStatusWaiterBit, std::memory_order_acq_rel))
+			continue;
+
+		g_fileSyncParkCount.fetch_add(1, std::memory_order_relaxed);
+		fileStatus.wait(status | g_fileStatusWaiterBit, std::memory_order_acquire);
+	}
+}
+
+void ThreadSchedule::ReleaseFileTask(const UINT fid, const UINT threadTaskType)
+{
+	std::atomic<UINT>& fileStatus = g_fileSlotAry[fid].Status;
+
+	// Next task can be entered now.
+	const UINT nextStatus =
+		threadTaskType < THREAD_TASK_COMPUTE ?
+		(threadTaskType + 1) * 3 :
+		FILE_STATUS_COMPUTE_TASK_COMPLETED;
+
+	const UINT prevStatus = fileStatus.exchange(nextStatus, std::memory_order_acq_rel);
+	if (prevStatus & g_fileStatusWaiterBit)
+		fileStatus.notify_all();
+}
+
+void ThreadSchedule::DoThreadTaskManual(ThreadTaskArgs* args, const UINT threadTaskType)
+{
+	SPAN_INIT;
+
+	const UINT fid = args->FID;
+
+	TIMER_INIT;
+	TIMER_START;
+
+	if (AcquireFileTask(fid, threadTaskType) == WAIT_TIMEOUT)
+	{
+		HeapFree(GetProcessHeap(), 0, args);
+		return;
+	}
+
+	TIMER_STOP;
+	double syncTime = el;
+
+	const char* name =
+		threadTaskType == THREAD_TASK_READ_CALL ? "Read Call Task" :
+		threadTaskType == THREAD_TASK_COMPLETION ? "Completion Task" :
+		"Compute Task";
+
+	SPAN_START(threadTaskType, name, fid);
+
+	// Do task with thread type.
+	switch (threadTaskType)
+	{
+	case THREAD_TASK_READ_CALL:
+		ReadCallTaskWork(fid);
+		break;
+	case THREAD_TASK_COMPLETION:
+		CompletionTaskWork(fid);
+		break;
+	case THREAD_TASK_COMPUTE:
+		ComputeTaskWork(fid);
+		break;
+	}
+
+	SPAN_END;
+
+	TIMER_START;
+	ReleaseFileTask(fid, threadTaskType);
+	TIMER_STOP;
+	syncTime += el;
+
+	g_fileSyncNanoSeconds.fetch_add(static_cast<UINT64>(syncTime * 1000 * 1000 * 1000), std::memory_order_relaxed);
+	g_fileSyncTaskCount.fetch_add(1, std::memory_order_relaxed);
+
+	HeapFree(GetProcessHeap(), 0, args);
+}
+
+DWORD WINAPI ThreadSchedule::ManualThreadFunc(const LPVOID param)
+{
+	SERIES_INIT("Manual");
+
+	const HANDLE threadIOCPHandle = param;
+
+	OVERLAPPED_ENTRY entryAry[g_taskRemoveCount];
+	ULONG entRemoved;
 
 	while (TRUE)
 	{
@@ -678,13 +789,11 @@ DWORD WINAPI ThreadSchedule::ManualThreadFunc(const LPVOID param)
 
 DWORD ThreadSchedule::RoleSpecifiedThreadFunc(const LPVOID param)
 {
-#ifdef _DEBUG
-	SERIES_INIT(std::to_wstring(GetCurrentThreadId()).c_str());
-	SPAN_INIT;
-#endif
-
 	const UINT threadRole = reinterpret_cast<UINT>(param);
 
+	const char* const roleNameAry[] = { "ReadCall Only", "Compute Only", "ReadCall And Compute", "Compute And ReadCall" };
+	SERIES_INIT(roleNameAry[threadRole]);
+
 	DWORD ret;
 	ULONG_PTR key;
 	LPOVERLAPPED lpov;
@@ -710,8 +819,10 @@ DWORD ThreadSchedule::RoleSpecifiedThreadFunc(const LPVOID param)
 			if (FALSE == g_taskMode.IsComputeTaskTurn)
 			{
 				// If ReadCall task exists...
-				if (TRUE == GetQueuedCompletionStatus(g_globalTaskQueue, &ret, &key, &lpov, 0L))
+				UINT taskFid;
+				if (TRUE == GetGlobalTask(&taskFid, 0L))
 				{
+					key = taskFid;
 					if (key == g_exitCode) break;
 
 					AcquireSRWLockExclusive(&g_srwTaskMode);
@@ -739,6 +850,7 @@ DWORD ThreadSchedule::RoleSpecifiedThreadFunc(const LPVOID param)
 					// Check if Compute task exists...
 					if (TRUE == GetQueuedCompletionStatus(g_globalWaitingQueue, &ret, &key, &lpov, 0L))
 					{
+						key = GetCompletionFid(key, lpov);
 						DO_TASK(key, THREAD_TASK_COMPUTE);
 					}
 				}
@@ -747,6 +859,7 @@ DWORD ThreadSchedule::RoleSpecifiedThreadFunc(const LPVOID param)
 			{
 				if (TRUE == GetQueuedCompletionStatus(g_globalWaitingQueue, &ret, &key, &lpov, INFINITE))
 				{
+					key = GetCompletionFid(key, lpov);
 					AcquireSRWLockExclusive(&g_srwTaskMode);
 					if (g_taskMode.ComputeTaskCount < g_testArgs.ComputeTaskLimit)
 					{
@@ -778,8 +891,11 @@ DWORD ThreadSchedule::RoleSpecifiedThreadFunc(const LPVOID param)
 			{
 				// If no compute task exists...
 				// Check read call task exists immediately.
-				if (TRUE == GetQueuedCompletionStatus(g_globalTaskQueue, &ret, &key, &lpov, 0L))
+				UINT taskFid;
+				if (TRUE == GetGlobalTask(&taskFid, 0L))
 				{
+					key = taskFid;
+
 					// If exists, do read call task.
 					DO_TASK(key, THREAD_TASK_READ_CALL);
 				}
@@ -790,6 +906,7 @@ DWORD ThreadSchedule::RoleSpecifiedThreadFunc(const LPVOID param)
 			}
 			else
 			{
+				key = GetCompletionFid(key, lpov);
 				DO_TASK(key, THREAD_TASK_COMPUTE);
 			}
 		}
@@ -798,238 +915,1247 @@ DWORD ThreadSchedule::RoleSpecifiedThreadFunc(const LPVOID param)
 	return 0;
 }
 
-DWORD ThreadSchedule::MMAPThreadFunc(const LPVOID param)
+DWORD ThreadSchedule::RebalancedThreadFunc(const LPVOID param)
 {
 	UNREFERENCED_PARAMETER(param);
+	SERIES_INIT("Rebalanced");
 
 	DWORD ret;
 	ULONG_PTR key;
 	LPOVERLAPPED lpov;
 
+	Rebalancer::RoleType role = Rebalancer::Join();
+
+	while (role != Rebalancer::ROLE_EXIT)
+	{
+		UINT fid;
+
+		Rebalancer::BeginIdle(role);
+
+		if (role == Rebalancer::ROLE_READCALL)
+		{
+			GetGlobalTask(&fid, INFINITE);
+		}
+		else
+		{
+			GetQueuedCompletionStatus(g_globalWaitingQueue, &ret, &key, &lpov, INFINITE);
+			fid = static_cast<UINT>(GetCompletionFid(key, lpov));
+		}
+
+		Rebalancer::EndIdle(role);
+
+		if (fid == g_exitCode) break;
+		if (fid != Rebalancer::g_wakeCode)
+		{
+			if (fid >= g_testArgs.TestFileCount) THROW_ERROR(L"FID out of range.");
+
+			if (role == Rebalancer::ROLE_READCALL)
+				ReadCallTaskWork(fid);
+			else
+				ComputeTaskWork(fid);
+		}
+
+		role = Rebalancer::Next(role);
+	}
+
+	return 0;
+}
+
+DWORD ThreadSchedule::MMAPThreadFunc(const LPVOID param)
+{
+	UNREFERENCED_PARAMETER(param);
+	SERIES_INIT("MMAP");
+
 	while (TRUE)
 	{
-		GetQueuedCompletionStatus(g_globalTaskQueue, &ret, &key, &lpov, INFINITE);
+		UINT fid;
+		GetGlobalTask(&fid, INFINITE);
 
-		if (key == g_exitCode) break;
-		if (key >= g_testArgs.TestFileCount) THROW_ERROR(L"FID out of range.");
+		if (fid == g_exitCode) break;
+		if (fid >= g_testArgs.TestFileCount) THROW_ERROR(L"FID out of range.");
 
-		MMAPTaskWork(key);
+		MMAPTaskWork(fid);
 	}
+
+	return 0;
 }
 
 DWORD ThreadSchedule::SyncThreadFunc(LPVOID param)
 {
 	UNREFERENCED_PARAMETER(param);
+	SERIES_INIT("Sync");
 
-	DWORD ret;
-	ULONG_PTR key;
-	LPOVERLAPPED lpov;
+	if (g_testArgs.DatasetLayout == DATASET_LAYOUT_PACKED)
+		t_readEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
 
 	while (TRUE)
 	{
-		GetQueuedCompletionStatus(g_globalTaskQueue, &ret, &key, &lpov, INFINITE);
+		UINT fid;
+		GetGlobalTask(&fid, INFINITE);
 
-		if (key == g_exitCode) break;
-		if (key >= g_testArgs.TestFileCount) THROW_ERROR(L"FID out of range.");
+		if (fid == g_exitCode) break;
+		if (fid >= g_testArgs.TestFileCount) THROW_ERROR(L"FID out of range.");
 
-		SyncTaskWork(key);
+		SyncTaskWork(fid);
 	}
+
+	if (g_testArgs.DatasetLayout == DATASET_LAYOUT_PACKED)
+		SAFE_CLOSE_HANDLE(t_readEvent);
+
+	return 0;
 }
 
-TestResult ThreadSchedule::StartTest(TestArgument args)
+DWORD ThreadSchedule::StreamThreadFunc(LPVOID param)
 {
-#ifdef _DEBUG
-	SERIES_INIT(_T("Main Thread"));
-	SPAN_INIT;
-#endif
+	UNREFERENCED_PARAMETER(param);
+	SERIES_INIT("Stream");
 
-	g_testResult = { 0 };
-	g_testArgs = args;
+	// Segment buffers, events are reused by all files of this thread.
+	const SIZE_T slotBufferSize = static_cast<SIZE_T>(g_testArgs.StreamSegmentByteSize) * g_testArgs.StreamInflightCount;
+	BYTE* slotBuffer = static_cast<BYTE*>(VirtualAlloc(NULL, slotBufferSize, MEM_COMMIT, PAGE_READWRITE));
+	if (slotBuffer == NULL)
+		THROW_ERROR(L"Failed to allocate segment buffer.");
 
-	if (g_testArgs.SimType == SIM_MANUAL_TASK_THREAD)
+	OVERLAPPED* slotOvAry = new OVERLAPPED[g_testArgs.StreamInflightCount];
+	for (UINT i = 0; i < g_testArgs.StreamInflightCount; i++)
 	{
-		InitializeSRWLock(&g_srwFileStatus);
-		InitializeSRWLock(&g_srwFileLock);
-		InitializeSRWLock(&g_srwFileIocp);
+		slotOvAry[i] = { 0 };
+		slotOvAry[i].hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
 	}
 
-	if (g_testArgs.SimType == SIM_MANUAL_TASK_THREAD || g_testArgs.SimType == SIM_ROLE_SPECIFIED_THREAD)
+	while (TRUE)
 	{
-		InitializeSRWLock(&g_srwFileHandle);
-		InitializeSRWLock(&g_srwFileBuffer);
-		InitializeSRWLock(&g_srwTaskMode);
+		UINT fid;
+		GetGlobalTask(&fid, INFINITE);
+
+		if (fid == g_exitCode) break;
+		if (fid >= g_testArgs.TestFileCount) THROW_ERROR(L"FID out of range.");
+
+		StreamTaskWork(fid, slotBuffer, slotOvAry);
 	}
 
-	InitializeSRWLock(&g_srwFileFinish);
+	for (UINT i = 0; i < g_testArgs.StreamInflightCount; i++)
+		CloseHandle(slotOvAry[i].hEvent);
 
-	// Initialize global IOCP if needed.
-	if (g_testArgs.SimType == SIM_ROLE_SPECIFIED_THREAD)
+	delete[] slotOvAry;
+	VirtualFree(slotBuffer, 0, MEM_RELEASE);
+
+	return 0;
+}
+
+// Admit read of fid to memory budget. Only thread t reaps its reads, so while budget is full,
+// it reaps them and computes them itself. Blocks only when own deque has no Compute task on top.
+static void AcquireWorkStealingBudget(const UINT t, const UINT fid, UINT* inflightCount, UINT64* localComputeCount)
+{
+	LARGE_INTEGER fileByteSize;
+	if (g_testArgs.DatasetLayout == DATASET_LAYOUT_PACKED)
 	{
-		g_globalTaskQueue = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, g_testArgs.ThreadCount);
-		g_globalWaitingQueue = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, g_testArgs.ThreadCount);
+		fileByteSize.QuadPart = Dataset::GetEntry(fid).ByteSize;
 	}
-	else if (g_testArgs.SimType == SIM_SYNC_THREAD || g_testArgs.SimType == SIM_MMAP_THREAD)
+	else
 	{
-		g_globalTaskQueue = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, g_testArgs.ThreadCount);
+		WIN32_FILE_ATTRIBUTE_DATA fileAttribute;
+		if (FALSE == GetFileAttributesExW((L"dummy\\" + std::to_wstring(fid)).c_str(), GetFileExInfoStandard, &fileAttribute))
+			THROW_ERROR(L"Failed to get file size.");
+
+		fileByteSize.LowPart = fileAttribute.nFileSizeLow;
+		fileByteSize.HighPart = fileAttribute.nFileSizeHigh;
 	}
 
-	g_threadHandleAry = new HANDLE[g_testArgs.ThreadCount];
-	g_threadIocpAry = new HANDLE[g_testArgs.ThreadCount];
+	const DWORD alignedFileByteSize = GetAlignedByteSize(&fileByteSize, 512u);
 
-	// Create threads.
-	for (UINT t = 0; t < g_testArgs.ThreadCount; t++)
+	while (FALSE == MemoryBudget::TryAcquire(alignedFileByteSize))
 	{
-		DWORD tid = 0;
-		HANDLE threadHandle = NULL;
-
-		switch (g_testArgs.SimType)
-		{
-		case SIM_MANUAL_TASK_THREAD:
-			g_threadIocpAry[t] = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
-			threadHandle = CreateThread(NULL, 0, ManualThreadFunc, g_threadIocpAry[t], CREATE_SUSPENDED, &tid);
-			break;
+		while (*inflightCount > 0)
+			*inflightCount -= ReapWorkStealingCompletion(t, INFINITE);
 
-		case SIM_ROLE_SPECIFIED_THREAD:
+		// Reaped Compute tasks are pushed above remaining ReadCall tasks.
+		UINT64 task;
+		if (TRUE == g_dequeAry[t].Pop(&task))
 		{
-			UINT threadType =
-				(t < g_testArgs.ThreadRoleAry[0]) ? 0 :
-				(g_testArgs.ThreadRoleAry[0] <= t &&
-					t < g_testArgs.ThreadRoleAry[0] + g_testArgs.ThreadRoleAry[1]) ? 1 :
-				(g_testArgs.ThreadRoleAry[0] + g_testArgs.ThreadRoleAry[1] <= t &&
-					t < g_testArgs.ThreadRoleAry[0] + g_testArgs.ThreadRoleAry[1] + g_testArgs.ThreadRoleAry[2]) ? 2 : 3;
+			if (static_cast<UINT>(task >> g_taskTypeShift) == THREAD_TASK_COMPUTE)
+			{
+				ComputeTaskWork(static_cast<UINT>(task));
+				(*localComputeCount)++;
+				continue;
+			}
 
-			threadHandle = CreateThread(NULL, 0, RoleSpecifiedThreadFunc, reinterpret_cast<LPVOID>(threadType), 0, &tid);
-			break;
+			g_dequeAry[t].Push(task);
+			WakeWorkStealingThreads();
 		}
 
-		case SIM_SYNC_THREAD:
-			threadHandle = CreateThread(NULL, 0, SyncThreadFunc, NULL, 0, &tid);
-			break;
+		MemoryBudget::Acquire(alignedFileByteSize);
+		break;
+	}
+}
 
-		case SIM_MMAP_THREAD:
-			threadHandle = CreateThread(NULL, 0, MMAPThreadFunc, NULL, 0, &tid);
-			break;
-		}
+DWORD ThreadSchedule::WorkStealingThreadFunc(LPVOID param)
+{
+	const UINT t = static_cast<UINT>(reinterpret_cast<UINT_PTR>(param));
+	t_threadIndex = t;
+	SERIES_INIT("Work Stealing");
 
-		if (threadHandle == NULL)
-			THROW_ERROR(L"Failed to create thread.");
+	WorkStealingDeque& deque = g_dequeAry[t];
 
-		g_threadHandleAry[t] = threadHandle;
-	}
+	UINT inflightCount = 0;
+	UINT64 stealReadCallCount = 0;
+	UINT64 stealComputeCount = 0;
+	UINT64 stealFailCount = 0;
+	UINT64 localComputeCount = 0;
+	BOOL isIdle = FALSE;
 
-	if (g_testArgs.SimType == SIM_MANUAL_TASK_THREAD)
+	while (TRUE)
 	{
-		for (UINT t = 0; t < g_testArgs.ThreadCount; t++)
-			ResumeThread(g_threadHandleAry[t]);
+		// Read before looking for work, so that work pushed after the look makes park below return.
+		const UINT epoch = g_workStealingEpoch.load();
+
+		if (inflightCount > 0)
+			inflightCount -= ReapWorkStealingCompletion(t, 0L);
+
+		UINT64 task;
+		BOOL isStolen = FALSE;
+		UINT arrivedFid;
 
-		// Create root file locking & status objects.
-		for (UINT i = 0; i < args.TestFileCount; i++)
+		if (FALSE == deque.Pop(&task))
 		{
-			const UINT rootFID = i;
-			g_fileLockMap[rootFID] = new FileLock(rootFID);
-			g_fileStatusMap[rootFID] = 0;
+			// Deques are pushed only by owners, so open loop arrivals wait on global task queue.
+			if (g_testArgs.ArrivalRate > 0 && TRUE == GetGlobalTask(&arrivedFid, 0))
+			{
+				task = static_cast<UINT64>(THREAD_TASK_READ_CALL) << g_taskTypeShift | arrivedFid;
+			}
+			else if (TRUE == StealTask(t, &task))
+			{
+				isStolen = TRUE;
+			}
+			else
+			{
+				// One failed round per idle period.
+				if (FALSE == isIdle)
+				{
+					stealFailCount++;
+					isIdle = TRUE;
+				}
+
+				AcquireSRWLockShared(&g_srwFileFinish);
+				const BOOL isFinished = g_completeFileCount == g_testArgs.TestFileCount;
+				ReleaseSRWLockShared(&g_srwFileFinish);
+
+				if (isFinished)
+					break;
+
+				// Nothing to steal. Own reads are the only source of work, else park until task is pushed or last file is done.
+				if (inflightCount > 0)
+				{
+					inflightCount -= ReapWorkStealingCompletion(t, INFINITE);
+				}
+				else
+				{
+					g_parkedStealerCount++;
+					g_workStealingEpoch.wait(epoch);
+					g_parkedStealerCount--;
+				}
+
+				continue;
+			}
 		}
-	}
 
-#ifdef _DEBUG
-	SPAN_START(0, _T("Loading Time"));
-#endif
+		isIdle = FALSE;
 
-	TIMER_INIT;
-	TIMER_START;
+		const UINT fid = static_cast<UINT>(task);
+		const UINT threadTaskType = static_cast<UINT>(task >> g_taskTypeShift);
 
-	// Post tasks.
-	switch (g_testArgs.SimType)
-	{
-	case SIM_MANUAL_TASK_THREAD:
-		// Bind tasks manually.
-		for (UINT i = 0; i < args.TestFileCount; i++)
+		if (fid >= g_testArgs.TestFileCount) THROW_ERROR(L"FID out of range.");
+
+		if (threadTaskType == THREAD_TASK_READ_CALL)
 		{
-			PostThreadTask(i % g_testArgs.ThreadCount, i, THREAD_TASK_READ_CALL);
-			PostThreadTask(i % g_testArgs.ThreadCount, i, THREAD_TASK_COMPLETION);
-			PostThreadTask(i % g_testArgs.ThreadCount, i, THREAD_TASK_COMPUTE);
+			// Wait until in-flight read count goes under queue depth.
+			while (inflightCount >= g_testArgs.IoQueueDepth)
+				inflightCount -= ReapWorkStealingCompletion(t, INFINITE);
+
+			if (g_testArgs.MemoryBudgetByteSize > 0)
+				AcquireWorkStealingBudget(t, fid, &inflightCount, &localComputeCount);
+
+			ReadCallTaskWork(fid);
+			inflightCount++;
+
+			if (isStolen) stealReadCallCount++;
 		}
-		break;
-	
-	case SIM_ROLE_SPECIFIED_THREAD:
-	case SIM_SYNC_THREAD:
-	case SIM_MMAP_THREAD:
-		// Just put tasks into Task Queue.
-		for (UINT i = 0; i < args.TestFileCount; i++)
+		else
 		{
-			OVERLAPPED ov = { 0 };
-			PostQueuedCompletionStatus(g_globalTaskQueue, 0, i, &ov);
+			ComputeTaskWork(fid);
+
+			if (isStolen) stealComputeCount++;
+			else localComputeCount++;
 		}
-		break;
-	}
-	
-	// Post thread termination.
-	if (g_testArgs.SimType == SIM_MANUAL_TASK_THREAD)
-	{
-		// Post exit to all threads.
-		for (UINT t = 0; t < g_testArgs.ThreadCount; t++)
-			PostThreadExit(t);
 	}
 
-	WaitForMultipleObjects(g_testArgs.ThreadCount, g_threadHandleAry, TRUE, INFINITE);
-	TIMER_STOP;
+	g_stealReadCallCount += stealReadCallCount;
+	g_stealComputeCount += stealComputeCount;
+	g_stealFailCount += stealFailCount;
+	g_localComputeCount += localComputeCount;
 
-#ifdef _DEBUG
-	SPAN_END;
-#endif
+	return 0;
+}
 
-	// Release shared resources.
-	for (UINT i = 0; i < g_fileLockMap.size(); i++)
-		delete g_fileLockMap[i];
+UINT ThreadSchedule::ReapWorkStealingCompletion(const UINT t, const DWORD timeout)
+{
+	OVERLAPPED_ENTRY entryAry[g_taskRemoveCount];
+	ULONG entRemoved = 0;
 
-	g_fileBufferMap.clear();
-	g_fileBufferSizeMap.clear();
-	g_fileIocpMap.clear();
-	g_fileHandleMap.clear();
-	g_fileLockMap.clear();
+	if (FALSE == GetQueuedCompletionStatusEx(g_threadIocpAry[t], entryAry, g_taskRemoveCount, &entRemoved, timeout, FALSE))
+		return 0;
 
-	// Close global IOCP.
-	if (g_testArgs.SimType == SIM_ROLE_SPECIFIED_THREAD)
+	for (ULONG i = 0; i < entRemoved; i++)
 	{
-		SAFE_CLOSE_HANDLE(g_globalTaskQueue);
-		SAFE_CLOSE_HANDLE(g_globalWaitingQueue);
+		const ULONG_PTR fid = GetCompletionFid(entryAry[i].lpCompletionKey, entryAry[i].lpOverlapped);
+		Latency::Stamp(static_cast<UINT>(fid), Latency::STAGE_READ_COMPLETE);
+
+		const UINT64 task = (static_cast<UINT64>(THREAD_TASK_COMPUTE) << g_taskTypeShift) | fid;
+		if (FALSE == g_dequeAry[t].Push(task))
+			THROW_ERROR(L"Work stealing deque is full.");
 	}
-	else if (g_testArgs.SimType == SIM_SYNC_THREAD || g_testArgs.SimType == SIM_MMAP_THREAD)
+
+	if (entRemoved > 0)
+		WakeWorkStealingThreads();
+
+	return entRemoved;
+}
+
+BOOL ThreadSchedule::StealTask(const UINT t, UINT64* task)
+{
+	static thread_local std::minstd_rand engine(t + 1);
+
+	const UINT threadCount = g_testArgs.ThreadCount;
+	const UINT start = engine() % threadCount;
+
+	for (UINT i = 0; i < threadCount; i++)
 	{
-		SAFE_CLOSE_HANDLE(g_globalTaskQueue);
+		const UINT victim = (start + i) % threadCount;
+		if (victim != t && TRUE == g_dequeAry[victim].Steal(task))
+			return TRUE;
 	}
 
-	// Release thread handle/IOCP.
-	for (UINT t = 0; t < g_testArgs.ThreadCount; t++)
+	return FALSE;
+}
+
+// Read of file on IOCP of current thread. Lives in coroutine frame, so completion finds it from OVERLAPPED.
+struct CoroutineReadAwaiter
+{
+	HANDLE FileHandle;
+	BYTE* Buffer;
+	DWORD ByteSize;
+	UINT64 Offset;
+	OVERLAPPED Overlapped;
+	DWORD Error;			// Set by scheduler when completion is dequeued.
+	std::coroutine_handle<> Handle;
+
+	bool await_ready() const noexcept { return false; }
+
+	void await_suspend(const std::coroutine_handle<> handle)
 	{
-		if (g_testArgs.SimType == SIM_MANUAL_TASK_THREAD)
-			SAFE_CLOSE_HANDLE(g_threadIocpAry[t]);
+		Handle = handle;
 
-		SAFE_CLOSE_HANDLE(g_threadHandleAry[t]);
+		Overlapped = { 0 };
+		Overlapped.Offset = static_cast<DWORD>(Offset);
+		Overlapped.OffsetHigh = static_cast<DWORD>(Offset >> 32);
+
+		// Completion is queued even if ReadFile finishes at once, and only this thread dequeues it.
+		if (FALSE == ReadFile(FileHandle, Buffer, ByteSize, NULL, &Overlapped) && GetLastError() != ERROR_IO_PENDING)
+			THROW_ERROR(L"Failed to call ReadFile.");
+
+		t_coroutineScheduler.InflightCount++;
+		t_coroutineScheduler.SuspendCount++;
 	}
 
-	delete[] g_threadHandleAry;
-	delete[] g_threadIocpAry;
+	DWORD await_resume() const noexcept { return Error; }
+};
 
-	// Analyze results.
-	PROCESS_MEMORY_COUNTERS memCounter;
+// Admission to memory budget. Suspends only if budget is full, then scheduler resumes it once admitted.
+struct CoroutineBudgetAwaiter
+{
+	UINT64 ByteSize;
+
+	bool await_ready() const { return TRUE == MemoryBudget::TryAcquire(ByteSize); }
+
+	void await_suspend(const std::coroutine_handle<> handle)
+	{
+		t_coroutineScheduler.BudgetWaiter = handle;
+		t_coroutineScheduler.BudgetWaiterByteSize = ByteSize;
+		t_coroutineScheduler.SuspendCount++;
+	}
+
+	void await_resume() const noexcept {}
+};
+
+// Whole life of one file. State between ReadFile call and compute lives in frame, not in FileSlot.
+static Coroutine::FileTask RunFileCoroutine(const UINT fid)
+{
+	SPAN_INIT;
+	SPAN_START(0, "Create File", fid);
+
+	Latency::Stamp(fid, Latency::STAGE_READ_START);
+
+	LARGE_INTEGER fileByteSize;
+	UINT64 fileOffset;
+	const HANDLE fileHandle = OpenDatasetFile(fid, FILE_SHARE_READ, g_fileFlag, &fileByteSize, &fileOffset);
+
+	const DWORD alignedFileByteSize = GetAlignedByteSize(&fileByteSize, 512u);
+
+	// Packed data file of thread is bound once per test.
+	if (g_testArgs.DatasetLayout == DATASET_LAYOUT_FILES)
+		CreateIoCompletionPort(fileHandle, g_threadIocpAry[t_threadIndex], fid, 0);
+
+	SPAN_END;
+
+	co_await CoroutineBudgetAwaiter{ alignedFileByteSize };
+
+	BYTE* fileBuffer = AllocateFileBuffer(alignedFileByteSize);
+
+	const DWORD readError = co_await CoroutineReadAwaiter{ fileHandle, fileBuffer, alignedFileByteSize, fileOffset };
+	if (readError != ERROR_SUCCESS && readError != ERROR_HANDLE_EOF)
+		THROW_ERROR(L"Failed to read file.");
+
+	Latency::Stamp(fid, Latency::STAGE_READ_COMPLETE);
+
+	SPAN_START(2, "Compute", fid);
+
+	Latency::Stamp(fid, Latency::STAGE_COMPUTE_START);
+
+	if (g_testArgs.UseDefinedComputeTime)
+	{
+		UINT timeOverMicroSeconds;
+		memcpy(&timeOverMicroSeconds, fileBuffer, sizeof(UINT));
+
+		// Calculate checksum with calibrated compute model.
+		g_checksumSink = ComputeModel::Run(fileBuffer, fileByteSize.QuadPart, timeOverMicroSeconds);
+	}
+	else
+	{
+		// Calculate checksum with count limit.
+		for (int x = 0; x < g_computeLoopCount; x++)
+		{
+			g_checksumSink = ComputeKernel::Checksum(fileBuffer, fileByteSize.QuadPart);
+		}
+	}
+
+	Latency::Complete(fid);
+	Topology::AddTraffic(fileBuffer, fileByteSize.QuadPart);
+
+	SPAN_END;
+
+	// Release resources.
+	ReleaseFileBuffer(fileBuffer, alignedFileByteSize);
+	MemoryBudget::Release(alignedFileByteSize);
+	CloseDatasetFile(fileHandle);
+
+	AcquireSRWLockExclusive(&g_srwFileFinish);
+	g_completeFileCount++;
+	g_testResult.TotalFileSize += fileByteSize.QuadPart;
+	if (g_completeFileCount == g_testArgs.TestFileCount)
+	{
+		for (UINT t = 0; t < g_testArgs.ThreadCount; t++)
+			PostGlobalTask(g_exitCode);
+	}
+	ReleaseSRWLockExclusive(&g_srwFileFinish);
+}
+
+// Resume coroutines whose read completed on IOCP of calling thread. Compute of those files runs here.
+static void ReapCoroutineCompletion(const DWORD timeout)
+{
+	OVERLAPPED_ENTRY entryAry[g_taskRemoveCount];
+	ULONG entRemoved = 0;
+
+	if (FALSE == GetQueuedCompletionStatusEx(g_threadIocpAry[t_threadIndex], entryAry, g_taskRemoveCount, &entRemoved, timeout, FALSE))
+		return;
+
+	for (ULONG i = 0; i < entRemoved; i++)
+	{
+		CoroutineReadAwaiter* awaiter = CONTAINING_RECORD(entryAry[i].lpOverlapped, CoroutineReadAwaiter, Overlapped);
+
+		// Read is done once dequeued, so this doesn't wait. Only status of read is needed.
+		DWORD transferred = 0;
+		awaiter->Error = FALSE == GetOverlappedResult(awaiter->FileHandle, &awaiter->Overlapped, &transferred, FALSE) ? GetLastError() : ERROR_SUCCESS;
+
+		t_coroutineScheduler.InflightCount--;
+		awaiter->Handle.resume();
+	}
+}
+
+DWORD WINAPI ThreadSchedule::CoroutineThreadFunc(LPVOID param)
+{
+	t_threadIndex = static_cast<UINT>(reinterpret_cast<UINT_PTR>(param));
+	SERIES_INIT("Coroutine");
+
+	CoroutineScheduler& scheduler = t_coroutineScheduler;
+	scheduler = { 0, nullptr, 0, 0 };
+
+	while (TRUE)
+	{
+		if (scheduler.InflightCount > 0)
+			ReapCoroutineCompletion(0L);
+
+		// Own reads release budget when computed, so they are reaped before blocking on others.
+		if (scheduler.BudgetWaiter)
+		{
+			if (FALSE == MemoryBudget::TryAcquire(scheduler.BudgetWaiterByteSize))
+			{
+				if (scheduler.InflightCount > 0)
+				{
+					ReapCoroutineCompletion(INFINITE);
+					continue;
+				}
+
+				MemoryBudget::Acquire(scheduler.BudgetWaiterByteSize);
+			}
+
+			const std::coroutine_handle<> handle = scheduler.BudgetWaiter;
+			scheduler.BudgetWaiter = nullptr;
+			handle.resume();
+			continue;
+		}
+
+		// Wait until in-flight read count goes under queue depth.
+		if (scheduler.InflightCount >= g_testArgs.IoQueueDepth)
+		{
+			ReapCoroutineCompletion(INFINITE);
+			continue;
+		}
+
+		// Block on queue only when no read of this thread is in flight.
+		UINT fid;
+		if (FALSE == GetGlobalTask(&fid, scheduler.InflightCount > 0 ? 0 : INFINITE))
+		{
+			ReapCoroutineCompletion(INFINITE);
+			continue;
+		}
+
+		if (fid == g_exitCode) break;
+		if (fid >= g_testArgs.TestFileCount) THROW_ERROR(L"FID out of range.");
+
+		g_coroutineAry[fid].resume();
+	}
+
+	g_coroutineSuspendCount += scheduler.SuspendCount;
+
+	return 0;
+}
+
+// Post g_wakeCode to queue of role.
+static void WakeRole(const Rebalancer::RoleType role)
+{
+	if (role == Rebalancer::ROLE_READCALL)
+	{
+		PostGlobalTask(Rebalancer::g_wakeCode);
+		return;
+	}
+
+	OVERLAPPED ov = { 0 };
+	if (FALSE == PostQueuedCompletionStatus(g_globalWaitingQueue, 0, Rebalancer::g_wakeCode, &ov))
+		THROW_ERROR(L"Failed to post task.");
+}
+
+// Post each file when its arrival is due. Open loop, so posting never waits for threads.
+static void PostArrivals(const std::vector<UINT>& postOrderAry)
+{
+	double postTime = 0;
+
+	for (UINT i = 0; i < postOrderAry.size(); i++)
+	{
+		const UINT fid = postOrderAry[i];
+		Latency::StampAt(fid, Latency::STAGE_POST, Arrival::WaitArrival(i));
+
+		if (g_testArgs.UseRebalancer)
+			Rebalancer::AddQueueDepth(Rebalancer::ROLE_READCALL, 1);
+
+		TIMER_INIT;
+		TIMER_START;
+
+		if (g_testArgs.SimType == SIM_MANUAL_TASK_THREAD)
+		{
+			PostThreadTask(i % g_testArgs.ThreadCount, fid, THREAD_TASK_READ_CALL);
+			PostThreadTask(i % g_testArgs.ThreadCount, fid, THREAD_TASK_COMPLETION);
+			PostThreadTask(i % g_testArgs.ThreadCount, fid, THREAD_TASK_COMPUTE);
+		}
+		else
+		{
+			PostGlobalTask(fid);
+
+			if (g_testArgs.SimType == SIM_WORK_STEALING_THREAD)
+				WakeWorkStealingThreads();
+		}
+
+		TIMER_STOP;
+		postTime += el;
+	}
+
+	g_testResult.DispatchPostNanoSeconds = postTime * 1000 * 1000 * 1000 / postOrderAry.size();
+}
+
+TestResult ThreadSchedule::StartTest(TestArgument args)
+{
+	g_testResult = { 0 };
+	g_testArgs = args;
+
+	Trace::Init(g_testArgs.TraceFilePath);
+
+	SERIES_INIT("Main Thread");
+	SPAN_INIT;
+	g_testResult.ComputeKernelUsed = ComputeKernel::Init(g_testArgs.ComputeKernel);
+
+	if (g_testArgs.UseDefinedComputeTime)
+		ComputeModel::Init(g_testArgs.ComputeProfile);
+
+	if (g_testArgs.SimType == SIM_IO_URING_THREAD)
+		THROW_ERROR(L"Simulation type is not supported on this platform.");
+
+	if (g_testArgs.UseRebalancer && g_testArgs.SimType != SIM_ROLE_SPECIFIED_THREAD)
+		THROW_ERROR(L"Rebalancer is only supported by ROLE_SPECIFIED on this platform.");
+
+	// Windows has no non-blocking buffered read that fails instead of waiting for disk.
+	if (g_testArgs.UseNowaitRead)
+		THROW_ERROR(L"RWF_NOWAIT read is not supported on this platform.");
+
+	if (g_testArgs.SimType == SIM_STREAMING_THREAD)
+	{
+		if (g_testArgs.StreamSegmentByteSize == 0)
+			g_testArgs.StreamSegmentByteSize = g_defaultStreamSegmentByteSize;
+		if (g_testArgs.StreamInflightCount == 0)
+			g_testArgs.StreamInflightCount = g_defaultStreamInflightCount;
+
+		// NO_BUFFERING needs sector aligned offset and length.
+		g_testArgs.StreamSegmentByteSize = (g_testArgs.StreamSegmentByteSize + 4095u) / 4096u * 4096u;
+	}
+
+	if (g_testArgs.SimType == SIM_WORK_STEALING_THREAD)
+	{
+		if (g_testArgs.IoQueueDepth == 0)
+			g_testArgs.IoQueueDepth = g_defaultIoQueueDepth;
+
+		// Deque of thread holds its initial ReadCall tasks, and at most every Compute task.
+		g_dequeAry = new WorkStealingDeque[g_testArgs.ThreadCount];
+		for (UINT t = 0; t < g_testArgs.ThreadCount; t++)
+			g_dequeAry[t].Init(g_testArgs.TestFileCount + g_testArgs.TestFileCount / g_testArgs.ThreadCount + 1);
+	}
+
+	if (g_testArgs.SimType == SIM_COROUTINE_THREAD)
+	{
+		if (g_testArgs.IoQueueDepth == 0)
+			g_testArgs.IoQueueDepth = g_defaultIoQueueDepth;
+
+		Coroutine::Init();
+
+		TIMER_INIT;
+		TIMER_START;
+
+		// Every file is alive as suspended coroutine before first one starts.
+		g_coroutineAry = new std::coroutine_handle<>[g_testArgs.TestFileCount];
+		for (UINT fid = 0; fid < g_testArgs.TestFileCount; fid++)
+			g_coroutineAry[fid] = RunFileCoroutine(fid).Handle;
+
+		TIMER_STOP;
+		g_testResult.FileSetupTime = el * 1000;
+	}
+
+	if (g_testArgs.SimType == SIM_MANUAL_TASK_THREAD || g_testArgs.SimType == SIM_ROLE_SPECIFIED_THREAD || g_testArgs.SimType == SIM_WORK_STEALING_THREAD)
+	{
+		InitializeSRWLock(&g_srwTaskMode);
+
+		TIMER_INIT;
+		TIMER_START;
+
+		// Preallocate slots. Value-initialized, so every slot starts unpublished with READ_CALL_TASK_WAITING.
+		g_fileSlotAry = new FileSlot[g_testArgs.TestFileCount]();
+
+		TIMER_STOP;
+		g_testResult.FileSetupTime = el * 1000;
+	}
+
+	InitializeSRWLock(&g_srwFileFinish);
+
+	// Manifest gives size, compute time and offset in packed data file of every file.
+	const BOOL useManifest = g_testArgs.DatasetLayout == DATASET_LAYOUT_PACKED || g_testArgs.PostOrder != POST_ORDER_FIFO;
+	if (useManifest)
+		Dataset::LoadManifest(g_testArgs.TestFileCount);
+
+	const std::vector<UINT> postOrderAry = Dataset::GetPostOrder(g_testArgs.TestFileCount, g_testArgs.PostOrder, g_testArgs.UseDefinedComputeTime);
+
+	if (g_testArgs.DatasetLayout == DATASET_LAYOUT_PACKED)
+	{
+		// Reads of every thread go through this handle, except WORK_STEALING and COROUTINE which open one per thread.
+		g_packedHandle = CreateFileW(Dataset::g_packedDataPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, g_fileFlag, NULL);
+		if (g_packedHandle == INVALID_HANDLE_VALUE)
+			THROW_ERROR(L"Failed to open packed data file.");
+
+		if (g_testArgs.SimType == SIM_MMAP_THREAD)
+		{
+			g_packedMapHandle = CreateFileMapping(g_packedHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (g_packedMapHandle == NULL)
+				THROW_ERROR(L"Failed to map packed data file.");
+		}
+
+		if (g_testArgs.SimType == SIM_WORK_STEALING_THREAD || g_testArgs.SimType == SIM_COROUTINE_THREAD)
+			g_packedThreadHandleAry = new HANDLE[g_testArgs.ThreadCount];
+	}
+
+	SYSTEM_INFO systemInfo;
+	GetSystemInfo(&systemInfo);
+	g_allocationGranularity = systemInfo.dwAllocationGranularity;
+
+	// Initialize global IOCP if needed.
+	if (g_testArgs.SimType == SIM_ROLE_SPECIFIED_THREAD)
+	{
+		g_globalTaskQueue = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, g_testArgs.ThreadCount);
+		g_globalWaitingQueue = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, g_testArgs.ThreadCount);
+
+		if (g_testArgs.DatasetLayout == DATASET_LAYOUT_PACKED)
+			CreateIoCompletionPort(g_packedHandle, g_globalWaitingQueue, g_packedCompletionKey, 0);
+
+		if (g_testArgs.UseRebalancer)
+		{
+			const UINT initialThreadCount = g_testArgs.ThreadRoleAry[0] + g_testArgs.ThreadRoleAry[1];
+
+			if (g_testArgs.MinThreadCount == 0)
+				g_testArgs.MinThreadCount = 2;
+			if (g_testArgs.MaxThreadCount == 0)
+				g_testArgs.MaxThreadCount = initialThreadCount;
+
+			if (g_testArgs.MinThreadCount < 2 || g_testArgs.MinThreadCount > initialThreadCount || initialThreadCount > g_testArgs.MaxThreadCount)
+				THROW_ERROR(L"Rebalancer needs 2 <= min thread count <= initial thread count <= max thread count.");
+
+			// Mixed roles stay static. Rest of pool is created at max size, threads beyond initial roles start parked.
+			g_testArgs.ThreadCount = g_testArgs.ThreadRoleAry[2] + g_testArgs.ThreadRoleAry[3] + g_testArgs.MaxThreadCount;
+
+			Rebalancer::Init(
+				g_testArgs.ThreadRoleAry[0],
+				g_testArgs.ThreadRoleAry[1],
+				g_testArgs.MinThreadCount,
+				g_testArgs.MaxThreadCount,
+				WakeRole,
+				nullptr);
+		}
+	}
+	else if (g_testArgs.SimType == SIM_SYNC_THREAD || g_testArgs.SimType == SIM_MMAP_THREAD || g_testArgs.SimType == SIM_STREAMING_THREAD || g_testArgs.SimType == SIM_COROUTINE_THREAD ||
+		(g_testArgs.SimType == SIM_WORK_STEALING_THREAD && g_testArgs.ArrivalRate > 0))
+	{
+		g_globalTaskQueue = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, g_testArgs.ThreadCount);
+	}
+
+	// Task queue must hold every FID and exit codes at once.
+	if (g_testArgs.UseUserTaskQueue)
+		g_userTaskQueue.Init(g_testArgs.TestFileCount + g_testArgs.ThreadCount * 2);
+
+	// Roles of rebalanced pool change at runtime, so its threads are placed as mixed.
+	std::vector<UINT> threadRoleAry(g_testArgs.ThreadCount, THREAD_ROLE_READCALL_AND_COMPUTE);
+	if (g_testArgs.SimType == SIM_ROLE_SPECIFIED_THREAD && FALSE == g_testArgs.UseRebalancer)
+	{
+		for (UINT t = 0, r = 0; r < 4; r++)
+		{
+			for (UINT i = 0; i < g_testArgs.ThreadRoleAry[r]; i++)
+				threadRoleAry[t++] = r;
+		}
+	}
+
+	Topology::Init(g_testArgs.ThreadPlacement, threadRoleAry);
+
+	HugePage::Init(g_testArgs.BufferPage == BUFFER_PAGE_HUGE);
+
+	g_threadHandleAry = new HANDLE[g_testArgs.ThreadCount];
+	g_threadIocpAry = new HANDLE[g_testArgs.ThreadCount];
+
+	// Create threads.
+	for (UINT t = 0; t < g_testArgs.ThreadCount; t++)
+	{
+		DWORD tid = 0;
+		HANDLE threadHandle = NULL;
+
+		switch (g_testArgs.SimType)
+		{
+		case SIM_MANUAL_TASK_THREAD:
+			g_threadIocpAry[t] = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+			threadHandle = CreateThread(NULL, 0, ManualThreadFunc, g_threadIocpAry[t], CREATE_SUSPENDED, &tid);
+			break;
+
+		case SIM_ROLE_SPECIFIED_THREAD:
+		{
+			if (g_testArgs.UseRebalancer)
+			{
+				const UINT mixedThreadCount = g_testArgs.ThreadRoleAry[2] + g_testArgs.ThreadRoleAry[3];
+
+				if (t < mixedThreadCount)
+				{
+					const UINT threadType = t < g_testArgs.ThreadRoleAry[2] ? THREAD_ROLE_COMPUTE_AND_READCALL : THREAD_ROLE_READCALL_AND_COMPUTE;
+					threadHandle = CreateThread(NULL, 0, RoleSpecifiedThreadFunc, reinterpret_cast<LPVOID>(threadType), 0, &tid);
+				}
+				else
+				{
+					threadHandle = CreateThread(NULL, 0, RebalancedThreadFunc, NULL, 0, &tid);
+				}
+				break;
+			}
+
+			UINT threadType =
+				(t < g_testArgs.ThreadRoleAry[0]) ? 0 :
+				(g_testArgs.ThreadRoleAry[0] <= t &&
+					t < g_testArgs.ThreadRoleAry[0] + g_testArgs.ThreadRoleAry[1]) ? 1 :
+				(g_testArgs.ThreadRoleAry[0] + g_testArgs.ThreadRoleAry[1] <= t &&
+					t < g_testArgs.ThreadRoleAry[0] + g_testArgs.ThreadRoleAry[1] + g_testArgs.ThreadRoleAry[2]) ? 2 : 3;
+
+			threadHandle = CreateThread(NULL, 0, RoleSpecifiedThreadFunc, reinterpret_cast<LPVOID>(threadType), 0, &tid);
+			break;
+		}
+
+		case SIM_SYNC_THREAD:
+			threadHandle = CreateThread(NULL, 0, SyncThreadFunc, NULL, 0, &tid);
+			break;
+
+		case SIM_MMAP_THREAD:
+			threadHandle = CreateThread(NULL, 0, MMAPThreadFunc, NULL, 0, &tid);
+			break;
+
+		case SIM_STREAMING_THREAD:
+			threadHandle = CreateThread(NULL, 0, StreamThreadFunc, NULL, 0, &tid);
+			break;
+
+		case SIM_WORK_STEALING_THREAD:
+		case SIM_COROUTINE_THREAD:
+			g_threadIocpAry[t] = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+
+			// Handle can be bound to one IOCP, so each thread reads packed data file by own handle.
+			if (g_testArgs.DatasetLayout == DATASET_LAYOUT_PACKED)
+			{
+				g_packedThreadHandleAry[t] = CreateFileW(Dataset::g_packedDataPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, g_fileFlag, NULL);
+				if (g_packedThreadHandleAry[t] == INVALID_HANDLE_VALUE)
+					THROW_ERROR(L"Failed to open packed data file.");
+
+				CreateIoCompletionPort(g_packedThreadHandleAry[t], g_threadIocpAry[t], g_packedCompletionKey, 0);
+			}
+
+			// Work stealing threads are resumed after deques are filled.
+			if (g_testArgs.SimType == SIM_WORK_STEALING_THREAD)
+				threadHandle = CreateThread(NULL, 0, WorkStealingThreadFunc, reinterpret_cast<LPVOID>(static_cast<UINT_PTR>(t)), CREATE_SUSPENDED, &tid);
+			else
+				threadHandle = CreateThread(NULL, 0, CoroutineThreadFunc, reinterpret_cast<LPVOID>(static_cast<UINT_PTR>(t)), 0, &tid);
+			break;
+		}
+
+		if (threadHandle == NULL)
+			THROW_ERROR(L"Failed to create thread.");
+
+		g_threadHandleAry[t] = threadHandle;
+		Topology::PinThread(t, threadHandle);
+	}
+
+	if (g_testArgs.SimType == SIM_MANUAL_TASK_THREAD)
+	{
+		for (UINT t = 0; t < g_testArgs.ThreadCount; t++)
+			ResumeThread(g_threadHandleAry[t]);
+	}
+
+	SPAN_START(Trace::CATEGORY_TEST, "Loading Time");
+
+	if (g_testArgs.UseBufferPool)
+		BufferPool::Init(g_testArgs.BufferPoolByteSize, g_testArgs.BufferPoolPreTouch);
+
+	MemoryBudget::Init(g_testArgs.MemoryBudgetByteSize, g_testArgs.ThreadCount);
+
+	Latency::Init(g_testArgs.TestFileCount);
+
+	if (g_testArgs.ArrivalRate > 0)
+		Arrival::Init(g_testArgs.Arrival, g_testArgs.ArrivalRate, g_testArgs.TestFileCount, g_testArgs.ArrivalBurstPeriodMicroSeconds, g_testArgs.ArrivalBurstOnPercent);
+
+	PROCESS_MEMORY_COUNTERS memCounterStart;
+	GetProcessMemoryInfo(GetCurrentProcess(), &memCounterStart, sizeof(memCounterStart));
+
+	HugePage::StartDtlbCount();
+
+	TIMER_INIT;
+	TIMER_START;
+
+	// Post tasks.
+	if (g_testArgs.ArrivalRate > 0)
+	{
+		// Work stealing threads take arrivals from global task queue when own deque is empty.
+		if (g_testArgs.SimType == SIM_WORK_STEALING_THREAD)
+		{
+			for (UINT t = 0; t < g_testArgs.ThreadCount; t++)
+				ResumeThread(g_threadHandleAry[t]);
+		}
+
+		Arrival::Start();
+		PostArrivals(postOrderAry);
+	}
+	else
+	{
+		switch (g_testArgs.SimType)
+		{
+		case SIM_MANUAL_TASK_THREAD:
+			// Bind tasks manually.
+			for (UINT i = 0; i < args.TestFileCount; i++)
+			{
+				const UINT fid = postOrderAry[i];
+				Latency::Stamp(fid, Latency::STAGE_POST);
+				PostThreadTask(i % g_testArgs.ThreadCount, fid, THREAD_TASK_READ_CALL);
+				PostThreadTask(i % g_testArgs.ThreadCount, fid, THREAD_TASK_COMPLETION);
+				PostThreadTask(i % g_testArgs.ThreadCount, fid, THREAD_TASK_COMPUTE);
+			}
+			break;
+	
+		case SIM_ROLE_SPECIFIED_THREAD:
+		case SIM_SYNC_THREAD:
+		case SIM_MMAP_THREAD:
+		case SIM_STREAMING_THREAD:
+		case SIM_COROUTINE_THREAD:
+		{
+			// Just put tasks into Task Queue.
+			if (g_testArgs.UseRebalancer)
+				Rebalancer::AddQueueDepth(Rebalancer::ROLE_READCALL, args.TestFileCount);
+
+			TIMER_INIT;
+			TIMER_START;
+
+			for (const UINT fid : postOrderAry)
+			{
+				Latency::Stamp(fid, Latency::STAGE_POST);
+				PostGlobalTask(fid);
+			}
+
+			TIMER_STOP;
+			g_testResult.DispatchPostNanoSeconds = el * 1000 * 1000 * 1000 / args.TestFileCount;
+			break;
+		}
+
+		case SIM_WORK_STEALING_THREAD:
+		{
+			// Spread ReadCall tasks over deques. Threads are not running yet, so pushing from here is safe.
+			// Owner pops last pushed task first, so tasks are pushed in reverse of post order.
+			TIMER_INIT;
+			TIMER_START;
+
+			for (UINT i = args.TestFileCount; i-- > 0;)
+			{
+				const UINT fid = postOrderAry[i];
+				Latency::Stamp(fid, Latency::STAGE_POST);
+				g_dequeAry[i % g_testArgs.ThreadCount].Push(static_cast<UINT64>(THREAD_TASK_READ_CALL) << g_taskTypeShift | fid);
+			}
+
+			TIMER_STOP;
+			g_testResult.DispatchPostNanoSeconds = el * 1000 * 1000 * 1000 / args.TestFileCount;
+
+			for (UINT t = 0; t < g_testArgs.ThreadCount; t++)
+				ResumeThread(g_threadHandleAry[t]);
+			break;
+		}
+		}
+	}
+	
+	// Post thread termination.
+	if (g_testArgs.SimType == SIM_MANUAL_TASK_THREAD)
+	{
+		// Post exit to all threads.
+		for (UINT t = 0; t < g_testArgs.ThreadCount; t++)
+			PostThreadExit(t);
+	}
+
+	WaitForMultipleObjects(g_testArgs.ThreadCount, g_threadHandleAry, TRUE, INFINITE);
+	TIMER_STOP;
+
+	SPAN_END;
+
+	// Release shared resources.
+	if (g_testArgs.SimType == SIM_MANUAL_TASK_THREAD || g_testArgs.SimType == SIM_ROLE_SPECIFIED_THREAD || g_testArgs.SimType == SIM_WORK_STEALING_THREAD)
+	{
+		delete[] g_fileSlotAry;
+		g_fileSlotAry = nullptr;
+	}
+
+	g_userTaskQueue.Clear();
+
+	// Close global IOCP.
+	if (g_testArgs.SimType == SIM_ROLE_SPECIFIED_THREAD)
+	{
+		SAFE_CLOSE_HANDLE(g_globalTaskQueue);
+		SAFE_CLOSE_HANDLE(g_globalWaitingQueue);
+	}
+
+	if (g_testArgs.UseRebalancer)
+	{
+		const Rebalancer::RebalancerStats rebalancerStats = Rebalancer::Shutdown();
+		g_testResult.RebalanceSwitchCount = rebalancerStats.SwitchCount;
+		g_testResult.RebalanceGrowCount = rebalancerStats.GrowCount;
+		g_testResult.RebalanceShrinkCount = rebalancerStats.ShrinkCount;
+		g_testResult.MeanReadCallThreadCount = rebalancerStats.MeanReadCallThreadCount;
+		g_testResult.MeanComputeThreadCount = rebalancerStats.MeanComputeThreadCount;
+	}
+	else if (g_testArgs.SimType == SIM_SYNC_THREAD || g_testArgs.SimType == SIM_MMAP_THREAD || g_testArgs.SimType == SIM_STREAMING_THREAD || g_testArgs.SimType == SIM_COROUTINE_THREAD ||
+		(g_testArgs.SimType == SIM_WORK_STEALING_THREAD && g_testArgs.ArrivalRate > 0))
+	{
+		SAFE_CLOSE_HANDLE(g_globalTaskQueue);
+	}
+
+	// Release thread handle/IOCP.
+	for (UINT t = 0; t < g_testArgs.ThreadCount; t++)
+	{
+		if (g_testArgs.SimType == SIM_MANUAL_TASK_THREAD || g_testArgs.SimType == SIM_WORK_STEALING_THREAD || g_testArgs.SimType == SIM_COROUTINE_THREAD)
+			SAFE_CLOSE_HANDLE(g_threadIocpAry[t]);
+
+		SAFE_CLOSE_HANDLE(g_threadHandleAry[t]);
+	}
+
+	delete[] g_threadHandleAry;
+	delete[] g_threadIocpAry;
+
+	if (g_testArgs.DatasetLayout == DATASET_LAYOUT_PACKED)
+	{
+		if (g_testArgs.SimType == SIM_WORK_STEALING_THREAD || g_testArgs.SimType == SIM_COROUTINE_THREAD)
+		{
+			for (UINT t = 0; t < g_testArgs.ThreadCount; t++)
+				SAFE_CLOSE_HANDLE(g_packedThreadHandleAry[t]);
+
+			delete[] g_packedThreadHandleAry;
+			g_packedThreadHandleAry = nullptr;
+		}
+
+		if (g_packedMapHandle != NULL)
+			SAFE_CLOSE_HANDLE(g_packedMapHandle);
+		g_packedMapHandle = NULL;
+
+		SAFE_CLOSE_HANDLE(g_packedHandle);
+		g_packedHandle = INVALID_HANDLE_VALUE;
+	}
+
+	if (useManifest)
+		Dataset::UnloadManifest();
+
+	if (g_testArgs.SimType == SIM_WORK_STEALING_THREAD)
+	{
+		delete[] g_dequeAry;
+		g_dequeAry = nullptr;
+
+		g_testResult.StealReadCallCount = g_stealReadCallCount;
+		g_testResult.StealComputeCount = g_stealComputeCount;
+		g_testResult.StealFailCount = g_stealFailCount;
+		g_testResult.LocalComputeCount = g_localComputeCount;
+	}
+
+	if (g_testArgs.SimType == SIM_COROUTINE_THREAD)
+	{
+		delete[] g_coroutineAry;
+		g_coroutineAry = nullptr;
+
+		const Coroutine::FramePoolStats frameStats = Coroutine::Shutdown();
+		g_testResult.CoroutineFrameByteSize = frameStats.FrameByteSize;
+		g_testResult.CoroutinePeakFrameCount = frameStats.PeakFrameCount;
+		g_testResult.CoroutineFramePoolByteSize = frameStats.SlabByteSize;
+		g_testResult.CoroutineSuspendCount = g_coroutineSuspendCount;
+	}
+
+	if (g_testArgs.UseDefinedComputeTime)
+	{
+		const ComputeModel::ComputeModelStats computeStats = ComputeModel::Shutdown();
+		g_testResult.ComputeUnitsPerMicroSecond = computeStats.UnitsPerMicroSecond;
+		g_testResult.MeanComputeOvershoot = computeStats.MeanOvershoot;
+		g_testResult.MeanComputeTimerCheckCount = computeStats.MeanTimerCheckCount;
+	}
+
+	const Trace::TraceStats traceStats = Trace::Shutdown();
+	g_testResult.TraceEventCount = traceStats.EventCount;
+	g_testResult.TraceDroppedEventCount = traceStats.DroppedEventCount;
+
+	const Topology::TopologyStats topologyStats = Topology::Shutdown();
+	g_testResult.NodeCount = topologyStats.NodeCount;
+	g_testResult.CoreCount = topologyStats.CoreCount;
+	g_testResult.CpuCount = topologyStats.CpuCount;
+	g_testResult.PinnedThreadCount = topologyStats.PinnedThreadCount;
+	g_testResult.PlacedBufferCount = topologyStats.PlacedBufferCount;
+	memcpy(g_testResult.NodeLocalByteSizeAry, topologyStats.LocalByteSizeAry, sizeof(g_testResult.NodeLocalByteSizeAry));
+	memcpy(g_testResult.NodeRemoteByteSizeAry, topologyStats.RemoteByteSizeAry, sizeof(g_testResult.NodeRemoteByteSizeAry));
+
+	const HugePage::HugePageStats hugePageStats = HugePage::Shutdown();
+	g_testResult.IsDtlbMissCounted = hugePageStats.IsDtlbCounted;
+	g_testResult.DtlbMissCount = hugePageStats.DtlbMissCount;
+	if (g_testArgs.BufferPage == BUFFER_PAGE_HUGE)
+	{
+		g_testResult.HugePageByteSize = hugePageStats.HugePageByteSize;
+		g_testResult.HugePageBufferCount = hugePageStats.HugeTlbCount;
+		g_testResult.TransparentHugePageBufferCount = hugePageStats.TransparentCount;
+		g_testResult.SmallPageBufferCount = hugePageStats.SmallPageCount;
+		g_testResult.SmallBufferCount = hugePageStats.SmallBufferCount;
+	}
+
+	if (g_testArgs.ArrivalRate > 0)
+	{
+		const Arrival::ArrivalStats arrivalStats = Arrival::Shutdown();
+		g_testResult.OfferedRate = arrivalStats.OfferedRate;
+		g_testResult.MeanArrivalLag = arrivalStats.MeanPostLag;
+		g_testResult.MaxArrivalLag = arrivalStats.MaxPostLag;
+	}
+
+	const Latency::LatencyStats latencyStats = Latency::Shutdown();
+	g_testResult.QueueWaitLatency = latencyStats.QueueWait;
+	g_testResult.ReadLatency = latencyStats.Read;
+	g_testResult.ComputeWaitLatency = latencyStats.ComputeWait;
+	g_testResult.ComputeLatency = latencyStats.Compute;
+	g_testResult.TotalLatency = latencyStats.Total;
+
+	if (g_testArgs.UseBufferPool)
+	{
+		const BufferPool::BufferPoolStats poolStats = BufferPool::Shutdown();
+		g_testResult.BufferPoolHitCount = poolStats.HitCount;
+		g_testResult.BufferPoolMissCount = poolStats.MissCount;
+		g_testResult.BufferPoolHighWaterByteSize = poolStats.HighWaterByteSize;
+	}
+
+	const MemoryBudget::MemoryBudgetStats budgetStats = MemoryBudget::Shutdown();
+	g_testResult.MemoryBudgetWaitCount = budgetStats.WaitCount;
+	g_testResult.MemoryBudgetWaitTime = budgetStats.WaitTime;
+	g_testResult.MemoryBudgetOverCommitCount = budgetStats.OverCommitCount;
+	g_testResult.MemoryBudgetHighWaterByteSize = budgetStats.HighWaterByteSize;
+
+	// Analyze results.
+	PROCESS_MEMORY_COUNTERS memCounter;
 	GetProcessMemoryInfo(GetCurrentProcess(), &memCounter, sizeof(memCounter));
 
+	if (g_testArgs.SimType == SIM_STREAMING_THREAD)
+	{
+		g_testResult.MeanTimeToFirstByte = g_timeToFirstByteSum / g_testArgs.TestFileCount;
+		g_testResult.MeanFileLatency = g_fileLatencySum / g_testArgs.TestFileCount;
+	}
+
+	if (g_dispatchGetCount > 0)
+		g_testResult.DispatchGetNanoSeconds = static_cast<double>(g_dispatchGetNanoSeconds) / g_dispatchGetCount;
+
+	if (g_fileSyncTaskCount > 0)
+		g_testResult.FileSyncNanoSeconds = static_cast<double>(g_fileSyncNanoSeconds) / g_fileSyncTaskCount;
+	g_testResult.FileSyncParkCount = g_fileSyncParkCount;
+
 	// Reset status for next test.
 	g_taskMode = { 0 };
+	g_dispatchGetNanoSeconds = 0;
+	g_dispatchGetCount = 0;
+	g_stealReadCallCount = 0;
+	g_stealComputeCount = 0;
+	g_stealFailCount = 0;
+	g_workStealingEpoch = 0;
+	g_localComputeCount = 0;
+	g_coroutineSuspendCount = 0;
+	g_fileSyncNanoSeconds = 0;
+	g_fileSyncTaskCount = 0;
+	g_fileSyncParkCount = 0;
 	g_completeFileCount = 0;
+	g_timeToFirstByteSum = 0;
+	g_fileLatencySum = 0;
 
 	g_testResult.ElapsedTime = el * 1000;
 	g_testResult.PeakMemory = memCounter.PeakPagefileUsage;
 
+	// Windows doesn't split hard/soft faults. Report total as minor.
+	g_testResult.MinorFaultCount = memCounter.PageFaultCount - memCounterStart.PageFaultCount;
+
 	return g_testResult;
 }
 
+FileSlot& ThreadSchedule::AcquireFileSlot(const UINT fid)
+{
+	FileSlot& slot = g_fileSlotAry[fid];
+
+	// ReadCall task publishes before ReadFile call, so this rarely spins.
+	while (FALSE == slot.Published.load(std::memory_order_acquire))
+		YieldProcessor();
+
+	return slot;
+}
+
+BYTE* ThreadSchedule::AllocateFileBuffer(const UINT64 alignedByteSize)
+{
+	BYTE* buffer =
+		g_testArgs.UseBufferPool ?
+		BufferPool::Acquire(alignedByteSize) :
+		g_testArgs.BufferPage == BUFFER_PAGE_HUGE ?
+		HugePage::Allocate(alignedByteSize) :
+		Topology::IsPlacingBuffers() ?
+		Topology::Allocate(alignedByteSize) :
+		static_cast<BYTE*>(VirtualAlloc(NULL, alignedByteSize, MEM_COMMIT, PAGE_READWRITE));
+
+	if (buffer == NULL)
+		THROW_ERROR(L"Failed to allocate buffer.");
+
+	return buffer;
+}
+
+void ThreadSchedule::ReleaseFileBuffer(BYTE* buffer, const UINT64 alignedByteSize)
+{
+	if (g_testArgs.UseBufferPool)
+		BufferPool::Release(buffer, alignedByteSize);
+	else if (g_testArgs.BufferPage == BUFFER_PAGE_HUGE)
+		HugePage::Free(buffer, alignedByteSize);
+	else
+		VirtualFree(buffer, 0, MEM_RELEASE);
+}
+
 DWORD ThreadSchedule::GetAlignedByteSize(const PLARGE_INTEGER fileByteSize, const DWORD sectorSize)
 {
 	return ((fileByteSize->QuadPart / sectorSize) + 1u) * sectorSize;
 }
 
+void ThreadSchedule::PostGlobalTask(const UINT fid)
+{
+	if (g_testArgs.UseUserTaskQueue)
+	{
+		g_userTaskQueue.Push(fid);
+		return;
+	}
+
+	OVERLAPPED ov = { 0 };
+	if (FALSE == PostQueuedCompletionStatus(g_globalTaskQueue, 0, fid, &ov))
+		THROW_ERROR(L"Failed to post task.");
+}
+
+BOOL ThreadSchedule::GetGlobalTask(UINT* fid, const DWORD timeout)
+{
+	DWORD ret;
+	ULONG_PTR key;
+	LPOVERLAPPED lpov;
+
+	// Measure dequeue only when task is ready, so that waiting is not counted.
+	TIMER_INIT;
+	TIMER_START;
+
+	BOOL result = FALSE;
+	if (g_testArgs.UseUserTaskQueue)
+	{
+		result = g_userTaskQueue.TryPop(fid);
+	}
+	else if (TRUE == GetQueuedCompletionStatus(g_globalTaskQueue, &ret, &key, &lpov, 0L))
+	{
+		*fid = static_cast<UINT>(key);
+		result = TRUE;
+	}
+
+	TIMER_STOP;
+
+	if (result)
+	{
+		g_dispatchGetNanoSeconds.fetch_add(static_cast<UINT64>(el * 1000 * 1000 * 1000), std::memory_order_relaxed);
+		g_dispatchGetCount.fetch_add(1, std::memory_order_relaxed);
+		return TRUE;
+	}
+
+	if (timeout == 0)
+		return FALSE;
+
+	if (g_testArgs.UseUserTaskQueue)
+	{
+		*fid = g_userTaskQueue.Pop();
+		return TRUE;
+	}
+
+	if (FALSE == GetQueuedCompletionStatus(g_globalTaskQueue, &ret, &key, &lpov, timeout))
+		return FALSE;
+
+	*fid = static_cast<UINT>(key);
+	return TRUE;
+}
+
 void ThreadSchedule::PostThreadTask(const UINT t, const UINT fid, const UINT threadTaskType)
 {
 	ThreadTaskArgs* args = static_cast<ThreadTaskArgs*>(HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(ThreadTaskArgs)));
@@ -1043,4 +2169,5 @@ void ThreadSchedule::PostThreadExit(const UINT t)
 {
 	if (FALSE == PostQueuedCompletionStatus(g_threadIocpAry[t], 0, g_exitCode, NULL))
 		THROW_ERROR(L"Failed to post exit task.");
-}
\ No newline at end of file
+}
+#endif
@@ -0,0 +1,1835 @@
+#include "pch.h"
+#include "ThreadSchedule.h"
+
+#ifdef __linux__
+#include "Arrival.h"
+#include "BufferPool.h"
+#include "ComputeKernel.h"
+#include "ComputeModel.h"
+#include "Coroutine.h"
+#include "Dataset.h"
+#include "HugePage.h"
+#include "IoUring.h"
+#include "Latency.h"
+#include "MemoryBudget.h"
+#include "Rebalancer.h"
+#include "TaskQueue.h"
+#include "Topology.h"
+#include "Trace.h"
+#include "WorkStealingDeque.h"
+
+using namespace ThreadSchedule;
+
+struct FileContext
+{
+	int FileDescriptor;
+	BYTE* Buffer;
+	UINT64 FileByteSize;
+};
+
+// Test arguments, results.
+TestArgument g_testArgs;
+TestResult g_testResult;
+
+// Checksums of compute tasks are written here, so that they can't be optimized away.
+volatile int g_checksumSink;
+
+// Status.
+std::atomic<UINT> g_completeFileCount;		// How much files are completed?
+std::atomic<UINT64> g_totalFileSize;
+std::atomic<UINT64> g_submitCallCount;
+std::atomic<UINT64> g_dispatchGetNanoSeconds;
+std::atomic<UINT64> g_dispatchGetCount;
+
+// Thread works.
+TaskQueue g_globalTaskQueue;				// Queue that store ReadCall tasks.
+std::thread* g_threadAry;
+UINT g_computeThreadCount;
+
+// io_uring. SQ side and CQ side are locked separately.
+IoUring::Ring g_ring;
+std::mutex g_ringSqLock;
+std::mutex g_ringCqLock;
+
+// In-flight read limit (queue depth).
+std::mutex g_inflightLock;
+std::condition_variable g_inflightCv;
+UINT g_inflightCount;
+
+// Work stealing. Indexed by thread.
+WorkStealingDeque* g_dequeAry;
+IoUring::Ring* g_workerRingAry;
+
+// Work stealing stats.
+std::atomic<UINT64> g_stealReadCallCount;
+std::atomic<UINT64> g_stealComputeCount;
+std::atomic<UINT64> g_stealFailCount;
+std::atomic<UINT64> g_localComputeCount;
+
+// Bumped when work stealing task may have appeared, or last file is done. Idle threads park on it.
+std::atomic<UINT> g_workStealingEpoch;
+std::atomic<UINT> g_parkedStealerCount;
+
+// Wake threads parked in WorkStealingThreadFunc. Wake call is skipped while none is parked.
+static void WakeWorkStealingThreads()
+{
+	g_workStealingEpoch.fetch_add(1);
+	if (g_parkedStealerCount.load() > 0)
+		g_workStealingEpoch.notify_all();
+}
+
+// RWF_NOWAIT fast path stats.
+std::atomic<UINT64> g_nowaitHitCount;
+std::atomic<UINT64> g_nowaitMissCount;
+
+// Scheduler of coroutine thread. Touched only by its thread, and by coroutines it resumes.
+struct CoroutineScheduler
+{
+	IoUring::Ring* Ring;
+	UINT InflightCount;
+	std::coroutine_handle<> BudgetWaiter;	// Held back by memory budget. At most one, since no file starts while it waits.
+	UINT64 BudgetWaiterByteSize;
+	UINT64 SuspendCount;
+};
+
+// Coroutines. Only used when simulation type is COROUTINE.
+std::coroutine_handle<>* g_coroutineAry;	// Indexed by FID. Created suspended before threads take FID.
+thread_local CoroutineScheduler t_coroutineScheduler;
+std::atomic<UINT64> g_coroutineSuspendCount;
+
+// Shared resources. Indexed by FID.
+FileContext* g_fileContextAry;
+
+// Packed data file, opened once per test. Only used when dataset layout is PACKED.
+int g_packedDirectFd = -1;		// O_DIRECT.
+int g_packedBufferedFd = -1;	// Only used when simulation type is MMAP, or IO_URING with UseNowaitRead.
+
+// Mapped view shared between MMAP thread and its prefetch thread.
+struct MmapPrefetchSlot
+{
+	std::mutex Lock;
+	std::condition_variable Cv;
+	const BYTE* Base;					// nullptr if no view is mapped.
+	UINT64 ByteSize;
+	UINT64 PrefetchedByteSize;
+	std::atomic<UINT64> Cursor;			// Compute cursor of MMAP thread.
+	BOOL Stop;
+};
+
+// Prefetch works. Indexed by MMAP thread.
+MmapPrefetchSlot* g_prefetchSlotAry;
+std::thread* g_prefetchThreadAry;
+
+static UINT GetThreadRole(const UINT t)
+{
+	const UINT* roleAry = g_testArgs.ThreadRoleAry;
+
+	return
+		(t < roleAry[0]) ? 0 :
+		(t < roleAry[0] + roleAry[1]) ? 1 :
+		(t < roleAry[0] + roleAry[1] + roleAry[2]) ? 2 : 3;
+}
+
+static void CalculateChecksum(const BYTE* bufferAddress, const UINT64 bufferSize)
+{
+	if (g_testArgs.UseDefinedComputeTime)
+	{
+		UINT timeOverMicroSeconds;
+		memcpy(&timeOverMicroSeconds, bufferAddress, sizeof(UINT));
+
+		// Calculate checksum with calibrated compute model.
+		g_checksumSink = ComputeModel::Run(bufferAddress, bufferSize, timeOverMicroSeconds);
+	}
+	else
+	{
+		// Calculate checksum with count limit.
+		for (UINT x = 0; x < g_computeLoopCount; x++)
+		{
+			g_checksumSink = ComputeKernel::Checksum(bufferAddress, bufferSize);
+		}
+	}
+}
+
+// Open file of fid, get its size and offset in returned descriptor.
+// Packed dataset shares descriptor opened by StartTest, so per-file metadata calls are skipped.
+static int OpenDatasetFile(const UINT fid, const int flag, UINT64* fileByteSize, UINT64* offset)
+{
+	if (g_testArgs.DatasetLayout == DATASET_LAYOUT_PACKED)
+	{
+		const Dataset::ManifestEntry& entry = Dataset::GetEntry(fid);
+		*fileByteSize = entry.ByteSize;
+		*offset = entry.Offset;
+
+		return (flag & O_DIRECT) ? g_packedDirectFd : g_packedBufferedFd;
+	}
+
+	const int fd = open(("dummy/" + std::to_string(fid)).c_str(), flag);
+	if (fd < 0)
+		THROW_ERROR(L"Failed to open file.");
+
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) != 0)
+		THROW_ERROR(L"Failed to get file size.");
+
+	*fileByteSize = fileStat.st_size;
+	*offset = 0;
+
+	return fd;
+}
+
+// Close descriptor from OpenDatasetFile. Shared descriptor of packed dataset is closed by StartTest.
+static void CloseDatasetFile(const int fd)
+{
+	if (g_testArgs.DatasetLayout == DATASET_LAYOUT_FILES)
+		SAFE_CLOSE_FD(fd);
+}
+
+// Submit prepared SQEs. Must hold g_ringSqLock.
+static void SubmitPendingSqe()
+{
+	if (g_ring.PendingCount() == 0)
+		return;
+
+	if (g_ring.Submit() < 0)
+		THROW_ERROR(L"Failed to submit SQE.");
+
+	g_submitCallCount++;
+}
+
+static void FlushPendingSqe()
+{
+	std::lock_guard<std::mutex> lock(g_ringSqLock);
+	SubmitPendingSqe();
+}
+
+static io_uring_sqe* GetSqeBlocking()
+{
+	io_uring_sqe* sqe = g_ring.GetSqe();
+	while (sqe == nullptr)
+	{
+		// SQ is full. Submit to make room.
+		SubmitPendingSqe();
+		sqe = g_ring.GetSqe();
+	}
+
+	return sqe;
+}
+
+// Post g_wakeCode to queue of role. NOP completion wakes thread blocked on CQ.
+static void WakeIoUringRole(const Rebalancer::RoleType role)
+{
+	if (role == Rebalancer::ROLE_READCALL)
+	{
+		PostGlobalTask(Rebalancer::g_wakeCode);
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(g_ringSqLock);
+
+	io_uring_sqe* sqe = GetSqeBlocking();
+	sqe->opcode = IORING_OP_NOP;
+	sqe->user_data = Rebalancer::g_wakeCode;
+	SubmitPendingSqe();
+}
+
+// SQEs staged by ReadCall thread would wait for its next task, which never comes after it leaves role.
+static void LeaveIoUringRole(const Rebalancer::RoleType role)
+{
+	if (role == Rebalancer::ROLE_READCALL)
+		FlushPendingSqe();
+}
+
+// Get ReadCall task of IO_URING, blocking if queue is empty.
+static UINT WaitIoUringReadCallTask()
+{
+	UINT fid;
+	if (TRUE == GetGlobalTask(&fid, 0L))
+		return fid;
+
+	// Going idle. Submit staged SQEs before blocking.
+	FlushPendingSqe();
+
+	if (g_testArgs.UseRebalancer)
+		Rebalancer::BeginIdle(Rebalancer::ROLE_READCALL);
+
+	GetGlobalTask(&fid, INFINITE);
+
+	if (g_testArgs.UseRebalancer)
+		Rebalancer::EndIdle(Rebalancer::ROLE_READCALL);
+
+	return fid;
+}
+
+// Get completion of IO_URING, blocking if CQ is empty. Returns user data of CQE.
+static UINT64 WaitIoUringCompletion(int* readResult)
+{
+	if (g_testArgs.UseRebalancer)
+		Rebalancer::BeginIdle(Rebalancer::ROLE_COMPUTE);
+
+	UINT64 userData;
+
+	{
+		std::lock_guard<std::mutex> lock(g_ringCqLock);
+
+		io_uring_cqe* cqe = g_ring.WaitCqe();
+		if (cqe == nullptr)
+			THROW_ERROR(L"Failed to wait CQE.");
+
+		userData = cqe->user_data;
+		*readResult = cqe->res;
+		g_ring.SeenCqe();
+	}
+
+	if (g_testArgs.UseRebalancer)
+		Rebalancer::EndIdle(Rebalancer::ROLE_COMPUTE);
+
+	return userData;
+}
+
+// Release in-flight slot of completed read, then do compute task.
+static void DoIoUringCompletion(const UINT64 userData, const int readResult)
+{
+	if (userData >= g_testArgs.TestFileCount) THROW_ERROR(L"FID out of range.");
+
+	Latency::Stamp(static_cast<UINT>(userData), Latency::STAGE_READ_COMPLETE);
+
+	{
+		std::lock_guard<std::mutex> lock(g_inflightLock);
+		g_inflightCount--;
+	}
+	g_inflightCv.notify_one();
+
+	IoUringComputeTaskWork(static_cast<UINT>(userData), readResult);
+}
+
+void ThreadSchedule::IoUringReadCallTaskWork(const UINT fid)
+{
+	SPAN_INIT;
+	SPAN_START(0, "Read Call Task", fid);
+
+	Latency::Stamp(fid, Latency::STAGE_READ_START);
+
+	if (g_testArgs.UseRebalancer)
+	{
+		Rebalancer::AddQueueDepth(Rebalancer::ROLE_READCALL, -1);
+		Rebalancer::AddQueueDepth(Rebalancer::ROLE_COMPUTE, 1);
+	}
+
+	// RWF_NOWAIT only sees page cache, so fast path needs buffered descriptor.
+	UINT64 fileByteSize;
+	UINT64 fileOffset;
+	const int fd = OpenDatasetFile(fid, g_testArgs.UseNowaitRead ? O_RDONLY : O_RDONLY | O_DIRECT, &fileByteSize, &fileOffset);
+	const UINT64 alignedFileByteSize = GetAlignedByteSize(fileByteSize, g_directIoAlignment);
+
+	// Wait until buffer fits in memory budget. Staged SQEs hold budget too, so submit them before blocking.
+	if (FALSE == MemoryBudget::TryAcquire(alignedFileByteSize))
+	{
+		FlushPendingSqe();
+
+		if (g_testArgs.UseRebalancer)
+			Rebalancer::BeginIdle(Rebalancer::ROLE_READCALL);
+
+		MemoryBudget::Acquire(alignedFileByteSize);
+
+		if (g_testArgs.UseRebalancer)
+			Rebalancer::EndIdle(Rebalancer::ROLE_READCALL);
+	}
+
+	BYTE* fileBuffer = AllocateFileBuffer(alignedFileByteSize);
+
+	g_fileContextAry[fid] = { fd, fileBuffer, fileByteSize };
+	g_totalFileSize += fileByteSize;
+
+	// Bytes already read by fast path. Async read covers the rest.
+	UINT64 headByteSize = 0;
+
+	if (g_testArgs.UseNowaitRead)
+	{
+		iovec iov = { fileBuffer, fileByteSize };
+		const ssize_t readByteSize = preadv2(fd, &iov, 1, fileOffset, RWF_NOWAIT);
+		if (readByteSize < 0 && errno != EAGAIN)
+			THROW_ERROR(L"Failed to read file.");
+
+		// Whole file was in page cache. Compute here, skipping ring and hand-off to compute thread.
+		if (readByteSize == static_cast<ssize_t>(fileByteSize))
+		{
+			g_nowaitHitCount++;
+			Latency::SetPath(fid, Latency::PATH_INLINE);
+			Latency::Stamp(fid, Latency::STAGE_READ_COMPLETE);
+
+			SPAN_END;
+
+			// SQEs staged for earlier misses would wait behind compute.
+			FlushPendingSqe();
+			IoUringComputeTaskWork(fid, 0);
+			return;
+		}
+
+		// EAGAIN, or only head of file was cached.
+		g_nowaitMissCount++;
+		if (readByteSize > 0)
+			headByteSize = readByteSize;
+	}
+
+	// Wait until in-flight read count goes under queue depth.
+	{
+		std::unique_lock<std::mutex> lock(g_inflightLock);
+		if (g_inflightCount >= g_testArgs.IoQueueDepth)
+		{
+			// Staged SQEs must be submitted, or nothing will complete.
+			lock.unlock();
+			FlushPendingSqe();
+			lock.lock();
+
+			// Thread blocked on queue depth is spare for controller, same as thread waiting for task.
+			if (g_testArgs.UseRebalancer)
+				Rebalancer::BeginIdle(Rebalancer::ROLE_READCALL);
+
+			g_inflightCv.wait(lock, [] { return g_inflightCount < g_testArgs.IoQueueDepth; });
+
+			if (g_testArgs.UseRebalancer)
+				Rebalancer::EndIdle(Rebalancer::ROLE_READCALL);
+		}
+		g_inflightCount++;
+	}
+
+	std::lock_guard<std::mutex> lock(g_ringSqLock);
+
+	io_uring_sqe* sqe = GetSqeBlocking();
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = fd;
+	sqe->addr = reinterpret_cast<UINT64>(fileBuffer + headByteSize);
+	sqe->len = static_cast<UINT>((g_testArgs.UseNowaitRead ? fileByteSize : alignedFileByteSize) - headByteSize);
+	sqe->off = fileOffset + headByteSize;
+	sqe->user_data = fid;
+
+	// Batch SQEs into single io_uring_enter call.
+	if (g_ring.PendingCount() >= g_testArgs.IoSubmitBatch)
+		SubmitPendingSqe();
+
+	SPAN_END;
+}
+
+void ThreadSchedule::IoUringComputeTaskWork(const UINT fid, const int readResult)
+{
+	if (readResult < 0)
+	{
+		errno = -readResult;
+		THROW_ERROR(L"Failed to read file.");
+	}
+
+	const FileContext context = g_fileContextAry[fid];
+
+	if (g_testArgs.UseRebalancer)
+		Rebalancer::AddQueueDepth(Rebalancer::ROLE_COMPUTE, -1);
+
+	SPAN_INIT;
+	SPAN_START(2, "Compute", fid);
+
+	Latency::Stamp(fid, Latency::STAGE_COMPUTE_START);
+	CalculateChecksum(context.Buffer, context.FileByteSize);
+	Latency::Complete(fid);
+	Topology::AddTraffic(context.Buffer, context.FileByteSize);
+
+	SPAN_END;
+
+	// Release resources.
+	ReleaseFileBuffer(context.Buffer, GetAlignedByteSize(context.FileByteSize, g_directIoAlignment));
+	MemoryBudget::Release(GetAlignedByteSize(context.FileByteSize, g_directIoAlignment));
+	CloseDatasetFile(context.FileDescriptor);
+
+	if (++g_completeFileCount == g_testArgs.TestFileCount)
+	{
+		// Parked threads of pool exit from Rebalancer::Join.
+		if (g_testArgs.UseRebalancer)
+			Rebalancer::Stop();
+
+		for (UINT t = 0; t < g_testArgs.ThreadCount; t++)
+			PostGlobalTask(g_exitCode);
+
+		// Wake compute threads with NOP carrying exit code.
+		std::lock_guard<std::mutex> lock(g_ringSqLock);
+		for (UINT t = 0; t < g_computeThreadCount; t++)
+		{
+			io_uring_sqe* sqe = GetSqeBlocking();
+			sqe->opcode = IORING_OP_NOP;
+			sqe->user_data = g_exitCode;
+		}
+		SubmitPendingSqe();
+	}
+}
+
+void ThreadSchedule::WorkStealingReadCallTaskWork(const UINT t, const UINT fid)
+{
+	SPAN_INIT;
+	SPAN_START(0, "Read Call Task", fid);
+
+	Latency::Stamp(fid, Latency::STAGE_READ_START);
+
+	UINT64 fileByteSize;
+	UINT64 fileOffset;
+	const int fd = OpenDatasetFile(fid, O_RDONLY | O_DIRECT, &fileByteSize, &fileOffset);
+	const UINT64 alignedFileByteSize = GetAlignedByteSize(fileByteSize, g_directIoAlignment);
+
+	BYTE* fileBuffer = AllocateFileBuffer(alignedFileByteSize);
+
+	g_fileContextAry[fid] = { fd, fileBuffer, fileByteSize };
+	g_totalFileSize += fileByteSize;
+
+	// Ring is owned by thread t, no lock needed.
+	IoUring::Ring& ring = g_workerRingAry[t];
+
+	io_uring_sqe* sqe = ring.GetSqe();
+	if (sqe == nullptr)
+		THROW_ERROR(L"SQ is full.");
+
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = fd;
+	sqe->addr = reinterpret_cast<UINT64>(fileBuffer);
+	sqe->len = static_cast<UINT>(alignedFileByteSize);
+	sqe->off = fileOffset;
+	sqe->user_data = fid;
+
+	if (ring.PendingCount() >= g_testArgs.IoSubmitBatch)
+	{
+		if (ring.Submit() < 0)
+			THROW_ERROR(L"Failed to submit SQE.");
+		g_submitCallCount++;
+	}
+
+	SPAN_END;
+}
+
+void ThreadSchedule::WorkStealingComputeTaskWork(const UINT fid)
+{
+	const FileContext context = g_fileContextAry[fid];
+
+	SPAN_INIT;
+	SPAN_START(2, "Compute", fid);
+
+	Latency::Stamp(fid, Latency::STAGE_COMPUTE_START);
+	CalculateChecksum(context.Buffer, context.FileByteSize);
+	Latency::Complete(fid);
+	Topology::AddTraffic(context.Buffer, context.FileByteSize);
+
+	SPAN_END;
+
+	// Release resources.
+	ReleaseFileBuffer(context.Buffer, GetAlignedByteSize(context.FileByteSize, g_directIoAlignment));
+	MemoryBudget::Release(GetAlignedByteSize(context.FileByteSize, g_directIoAlignment));
+	CloseDatasetFile(context.FileDescriptor);
+
+	// Parked threads must see last file done.
+	if (++g_completeFileCount == g_testArgs.TestFileCount)
+		WakeWorkStealingThreads();
+}
+
+UINT ThreadSchedule::ReapWorkStealingCompletion(const UINT t, const BOOL wait)
+{
+	IoUring::Ring& ring = g_workerRingAry[t];
+
+	// Staged SQEs must be submitted, or nothing will complete.
+	if (wait && ring.PendingCount() > 0)
+	{
+		if (ring.Submit() < 0)
+			THROW_ERROR(L"Failed to submit SQE.");
+		g_submitCallCount++;
+	}
+
+	UINT reapCount = 0;
+	io_uring_cqe* cqe = wait ? ring.WaitCqe() : ring.PeekCqe();
+
+	while (cqe != nullptr)
+	{
+		if (cqe->res < 0)
+		{
+			errno = -cqe->res;
+			THROW_ERROR(L"Failed to read file.");
+		}
+
+		Latency::Stamp(static_cast<UINT>(cqe->user_data), Latency::STAGE_READ_COMPLETE);
+
+		const UINT64 task = (static_cast<UINT64>(THREAD_TASK_COMPUTE) << g_taskTypeShift) | cqe->user_data;
+		ring.SeenCqe();
+
+		if (FALSE == g_dequeAry[t].Push(task))
+			THROW_ERROR(L"Work stealing deque is full.");
+
+		reapCount++;
+		cqe = ring.PeekCqe();
+	}
+
+	if (reapCount > 0)
+		WakeWorkStealingThreads();
+
+	return reapCount;
+}
+
+void ThreadSchedule::MMAPTaskWork(const UINT t, const UINT fid)
+{
+	SPAN_INIT;
+	SPAN_START(0, "Map File", fid);
+
+	Latency::Stamp(fid, Latency::STAGE_READ_START);
+
+	UINT64 fileByteSize;
+	UINT64 fileOffset;
+	const int fd = OpenDatasetFile(fid, O_RDONLY, &fileByteSize, &fileOffset);
+	const UINT64 mapByteSize = GetAlignedByteSize(fileByteSize, g_directIoAlignment);
+
+	// Mapped pages are resident until unmap, so whole view counts against budget.
+	MemoryBudget::Acquire(mapByteSize);
+
+	// Zero length mmap fails with EINVAL. Empty file (EXP with size-min 0) is not mapped, and has nothing to compute.
+	const BOOL isEmpty = fileByteSize == 0;
+	void* mapView = nullptr;
+
+	if (FALSE == isEmpty)
+	{
+		const int mapFlag = MAP_SHARED | (g_testArgs.MmapPopulate ? MAP_POPULATE : 0);
+		mapView = mmap(NULL, fileByteSize, PROT_READ, mapFlag, fd, fileOffset);
+		if (mapView == MAP_FAILED)
+			THROW_ERROR(L"Failed to map file.");
+
+		switch (g_testArgs.MmapAdvice)
+		{
+		case MMAP_ADVICE_SEQUENTIAL:
+			madvise(mapView, fileByteSize, MADV_SEQUENTIAL);
+			break;
+		case MMAP_ADVICE_WILLNEED:
+			madvise(mapView, fileByteSize, MADV_WILLNEED);
+			break;
+		case MMAP_ADVICE_HUGEPAGE:
+			// Fails on filesystems without file THP support. Mapping still works.
+			madvise(mapView, fileByteSize, MADV_HUGEPAGE);
+			break;
+		default:
+			break;
+		}
+	}
+
+	// Pages are read by faults during compute, so read stage ends at mapping.
+	Latency::Stamp(fid, Latency::STAGE_READ_COMPLETE);
+	Latency::Stamp(fid, Latency::STAGE_COMPUTE_START);
+
+	SPAN_END;
+	SPAN_START(2, "Compute", fid);
+
+	const BYTE* ptr = static_cast<const BYTE*>(mapView);
+	const BOOL usePrefetch = g_testArgs.MmapPrefetchByteSize > 0 && FALSE == isEmpty;
+	MmapPrefetchSlot* slot = usePrefetch ? &g_prefetchSlotAry[t] : nullptr;
+
+	if (usePrefetch)
+	{
+		{
+			std::lock_guard<std::mutex> lock(slot->Lock);
+			slot->Base = ptr;
+			slot->ByteSize = fileByteSize;
+			slot->PrefetchedByteSize = 0;
+			slot->Cursor = 0;
+		}
+		slot->Cv.notify_one();
+	}
+
+	// Calculate checksum with count limit.
+	for (UINT x = 0; FALSE == isEmpty && x < g_computeLoopCount; x++)
+	{
+		int sum = 0;
+
+		for (UINT64 chunk = 0; chunk < fileByteSize; chunk += g_mmapComputeChunkSize)
+		{
+			if (usePrefetch)
+			{
+				slot->Cursor.store(chunk, std::memory_order_relaxed);
+				slot->Cv.notify_one();
+			}
+
+			const UINT64 chunkEnd = std::min<UINT64>(chunk + g_mmapComputeChunkSize, fileByteSize);
+			sum += static_cast<int>(ComputeKernel::ByteSum(ptr + chunk, chunkEnd - chunk));
+		}
+
+		g_checksumSink = ComputeKernel::FoldChecksum(sum);
+	}
+
+	Latency::Complete(fid);
+	Topology::AddTraffic(ptr, fileByteSize);
+
+	SPAN_END;
+
+	// Detach view from prefetch thread before unmapping.
+	if (usePrefetch)
+	{
+		std::lock_guard<std::mutex> lock(slot->Lock);
+		slot->Base = nullptr;
+	}
+
+	// Release resources.
+	if (FALSE == isEmpty)
+		munmap(mapView, fileByteSize);
+	MemoryBudget::Release(mapByteSize);
+	CloseDatasetFile(fd);
+
+	g_totalFileSize += fileByteSize;
+	if (++g_completeFileCount == g_testArgs.TestFileCount)
+	{
+		for (UINT i = 0; i < g_testArgs.ThreadCount; i++)
+			PostGlobalTask(g_exitCode);
+	}
+}
+
+void ThreadSchedule::IoUringThreadFunc(const UINT threadRole)
+{
+	SERIES_INIT(threadRole == THREAD_ROLE_READCALL_ONLY ? "ReadCall Only" : "Compute Only");
+
+	if (threadRole == THREAD_ROLE_READCALL_ONLY)
+	{
+		while (TRUE)
+		{
+			const UINT fid = WaitIoUringReadCallTask();
+
+			if (fid == g_exitCode) break;
+			if (fid >= g_testArgs.TestFileCount) THROW_ERROR(L"FID out of range.");
+
+			IoUringReadCallTaskWork(fid);
+		}
+	}
+	else if (threadRole == THREAD_ROLE_COMPUTE_ONLY)
+	{
+		while (TRUE)
+		{
+			int readResult;
+			const UINT64 userData = WaitIoUringCompletion(&readResult);
+
+			if (userData == g_exitCode) break;
+
+			DoIoUringCompletion(userData, readResult);
+		}
+	}
+}
+
+void ThreadSchedule::IoUringRebalancedThreadFunc()
+{
+	SERIES_INIT("Rebalanced");
+
+	Rebalancer::RoleType role = Rebalancer::Join();
+
+	while (role != Rebalancer::ROLE_EXIT)
+	{
+		if (role == Rebalancer::ROLE_READCALL)
+		{
+			const UINT fid = WaitIoUringReadCallTask();
+
+			if (fid == g_exitCode) break;
+			if (fid != Rebalancer::g_wakeCode)
+			{
+				if (fid >= g_testArgs.TestFileCount) THROW_ERROR(L"FID out of range.");
+				IoUringReadCallTaskWork(fid);
+			}
+		}
+		else
+		{
+			int readResult;
+			const UINT64 userData = WaitIoUringCompletion(&readResult);
+
+			if (userData == g_exitCode) break;
+			if (userData != Rebalancer::g_wakeCode)
+				DoIoUringCompletion(userData, readResult);
+		}
+
+		role = Rebalancer::Next(role);
+	}
+}
+
+void ThreadSchedule::SyncTaskWork(const UINT fid)
+{
+	SPAN_INIT;
+	SPAN_START(1, "ReadFile", fid);
+
+	Latency::Stamp(fid, Latency::STAGE_READ_START);
+
+	UINT64 fileByteSize;
+	UINT64 fileOffset;
+	const int fd = OpenDatasetFile(fid, O_RDONLY | O_DIRECT, &fileByteSize, &fileOffset);
+	const UINT64 alignedFileByteSize = GetAlignedByteSize(fileByteSize, g_directIoAlignment);
+
+	MemoryBudget::Acquire(alignedFileByteSize);
+
+	BYTE* fileBuffer = AllocateFileBuffer(alignedFileByteSize);
+
+	// O_DIRECT read of aligned length stops at EOF with short count.
+	UINT64 readByteSize = 0;
+	while (readByteSize < fileByteSize)
+	{
+		const ssize_t ret = pread(fd, fileBuffer + readByteSize, alignedFileByteSize - readByteSize, fileOffset + readByteSize);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			THROW_ERROR(L"Failed to call pread.");
+
+		readByteSize += ret;
+	}
+
+	Latency::Stamp(fid, Latency::STAGE_READ_COMPLETE);
+	Latency::Stamp(fid, Latency::STAGE_COMPUTE_START);
+
+	SPAN_END;
+	SPAN_START(2, "Compute", fid);
+
+	CalculateChecksum(fileBuffer, fileByteSize);
+	Latency::Complete(fid);
+	Topology::AddTraffic(fileBuffer, fileByteSize);
+
+	SPAN_END;
+
+	// Release resources.
+	ReleaseFileBuffer(fileBuffer, alignedFileByteSize);
+	MemoryBudget::Release(alignedFileByteSize);
+	CloseDatasetFile(fd);
+
+	g_totalFileSize += fileByteSize;
+	if (++g_completeFileCount == g_testArgs.TestFileCount)
+	{
+		for (UINT t = 0; t < g_testArgs.ThreadCount; t++)
+			PostGlobalTask(g_exitCode);
+	}
+}
+
+void ThreadSchedule::SyncThreadFunc()
+{
+	SERIES_INIT("Sync");
+
+	while (TRUE)
+	{
+		UINT fid;
+		GetGlobalTask(&fid, INFINITE);
+
+		if (fid == g_exitCode) break;
+		if (fid >= g_testArgs.TestFileCount) THROW_ERROR(L"FID out of range.");
+
+		SyncTaskWork(fid);
+	}
+}
+
+void ThreadSchedule::MMAPThreadFunc(const UINT t)
+{
+	SERIES_INIT("MMAP");
+
+	while (TRUE)
+	{
+		UINT fid;
+		GetGlobalTask(&fid, INFINITE);
+
+		if (fid == g_exitCode) break;
+		if (fid >= g_testArgs.TestFileCount) THROW_ERROR(L"FID out of range.");
+
+		MMAPTaskWork(t, fid);
+	}
+}
+
+// Admit read of fid to memory budget. Only thread t reaps its reads, so while budget is full,
+// it reaps them and computes them itself. Blocks only when own deque has no Compute task on top.
+static void AcquireWorkStealingBudget(const UINT t, const UINT fid, UINT* inflightCount, UINT64* localComputeCount)
+{
+	UINT64 fileByteSize;
+	if (g_testArgs.DatasetLayout == DATASET_LAYOUT_PACKED)
+	{
+		fileByteSize = Dataset::GetEntry(fid).ByteSize;
+	}
+	else
+	{
+		struct stat fileStat;
+		if (stat(("dummy/" + std::to_string(fid)).c_str(), &fileStat) != 0)
+			THROW_ERROR(L"Failed to get file size.");
+
+		fileByteSize = fileStat.st_size;
+	}
+
+	const UINT64 alignedFileByteSize = GetAlignedByteSize(fileByteSize, g_directIoAlignment);
+
+	while (FALSE == MemoryBudget::TryAcquire(alignedFileByteSize))
+	{
+		while (*inflightCount > 0)
+			*inflightCount -= ReapWorkStealingCompletion(t, TRUE);
+
+		// Reaped Compute tasks are pushed above remaining ReadCall tasks.
+		UINT64 task;
+		if (TRUE == g_dequeAry[t].Pop(&task))
+		{
+			if (static_cast<UINT>(task >> g_taskTypeShift) == THREAD_TASK_COMPUTE)
+			{
+				WorkStealingComputeTaskWork(static_cast<UINT>(task));
+				(*localComputeCount)++;
+				continue;
+			}
+
+			g_dequeAry[t].Push(task);
+			WakeWorkStealingThreads();
+		}
+
+		MemoryBudget::Acquire(alignedFileByteSize);
+		break;
+	}
+}
+
+void ThreadSchedule::WorkStealingThreadFunc(const UINT t)
+{
+	SERIES_INIT("Work Stealing");
+
+	WorkStealingDeque& deque = g_dequeAry[t];
+
+	UINT inflightCount = 0;
+	UINT64 stealReadCallCount = 0;
+	UINT64 stealComputeCount = 0;
+	UINT64 stealFailCount = 0;
+	UINT64 localComputeCount = 0;
+	BOOL isIdle = FALSE;
+
+	while (TRUE)
+	{
+		// Read before looking for work, so that work pushed after the look makes park below return.
+		const UINT epoch = g_workStealingEpoch.load();
+
+		if (inflightCount > 0)
+			inflightCount -= ReapWorkStealingCompletion(t, FALSE);
+
+		UINT64 task;
+		BOOL isStolen = FALSE;
+		UINT arrivedFid;
+
+		if (FALSE == deque.Pop(&task))
+		{
+			// Deques are pushed only by owners, so open loop arrivals wait on global task queue.
+			if (g_testArgs.ArrivalRate > 0 && TRUE == GetGlobalTask(&arrivedFid, 0))
+			{
+				task = static_cast<UINT64>(THREAD_TASK_READ_CALL) << g_taskTypeShift | arrivedFid;
+			}
+			else if (TRUE == StealTask(t, &task))
+			{
+				isStolen = TRUE;
+			}
+			else
+			{
+				// One failed round per idle period.
+				if (FALSE == isIdle)
+				{
+					stealFailCount++;
+					isIdle = TRUE;
+				}
+
+				if (g_completeFileCount == g_testArgs.TestFileCount)
+					break;
+
+				// Nothing to steal. Own reads are the only source of work, else park until task is pushed or last file is done.
+				if (inflightCount > 0)
+				{
+					inflightCount -= ReapWorkStealingCompletion(t, TRUE);
+				}
+				else
+				{
+					g_parkedStealerCount++;
+					g_workStealingEpoch.wait(epoch);
+					g_parkedStealerCount--;
+				}
+
+				continue;
+			}
+		}
+
+		isIdle = FALSE;
+
+		const UINT fid = static_cast<UINT>(task);
+		const UINT threadTaskType = static_cast<UINT>(task >> g_taskTypeShift);
+
+		if (fid >= g_testArgs.TestFileCount) THROW_ERROR(L"FID out of range.");
+
+		if (threadTaskType == THREAD_TASK_READ_CALL)
+		{
+			// Wait until in-flight read count goes under queue depth.
+			while (inflightCount >= g_testArgs.IoQueueDepth)
+				inflightCount -= ReapWorkStealingCompletion(t, TRUE);
+
+			if (g_testArgs.MemoryBudgetByteSize > 0)
+				AcquireWorkStealingBudget(t, fid, &inflightCount, &localComputeCount);
+
+			WorkStealingReadCallTaskWork(t, fid);
+			inflightCount++;
+
+			if (isStolen) stealReadCallCount++;
+		}
+		else
+		{
+			WorkStealingComputeTaskWork(fid);
+
+			if (isStolen) stealComputeCount++;
+			else localComputeCount++;
+		}
+	}
+
+	g_stealReadCallCount += stealReadCallCount;
+	g_stealComputeCount += stealComputeCount;
+	g_stealFailCount += stealFailCount;
+	g_localComputeCount += localComputeCount;
+}
+
+BOOL ThreadSchedule::StealTask(const UINT t, UINT64* task)
+{
+	static thread_local std::minstd_rand engine(t + 1);
+
+	const UINT threadCount = g_testArgs.ThreadCount;
+	const UINT start = engine() % threadCount;
+
+	for (UINT i = 0; i < threadCount; i++)
+	{
+		const UINT victim = (start + i) % threadCount;
+		if (victim != t && TRUE == g_dequeAry[victim].Steal(task))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+void ThreadSchedule::MMAPPrefetchThreadFunc(const UINT t)
+{
+	MmapPrefetchSlot& slot = g_prefetchSlotAry[t];
+	const UINT64 pageSize = sysconf(_SC_PAGESIZE);
+
+	std::unique_lock<std::mutex> lock(slot.Lock);
+	while (FALSE == slot.Stop)
+	{
+		const UINT64 cursor = slot.Cursor.load(std::memory_order_relaxed);
+		const UINT64 target = std::min<UINT64>(cursor + g_testArgs.MmapPrefetchByteSize, slot.ByteSize);
+
+		if (slot.Base == nullptr || slot.PrefetchedByteSize >= target)
+		{
+			// Cursor update is not locked, so don't wait forever.
+			slot.Cv.wait_for(lock, std::chrono::milliseconds(1));
+			continue;
+		}
+
+		// Pages behind cursor are already faulted by compute.
+		UINT64 offset = std::max(slot.PrefetchedByteSize, cursor / pageSize * pageSize);
+		const UINT64 end = std::min<UINT64>(target, offset + g_mmapComputeChunkSize);
+
+		// Touch one chunk while holding lock, so that view cannot be unmapped meanwhile.
+		for (; offset < end; offset += pageSize)
+		{
+			volatile BYTE touch = slot.Base[offset];
+			(void)touch;
+		}
+
+		slot.PrefetchedByteSize = end;
+	}
+}
+
+// Read of file on ring of current thread. Lives in coroutine frame, so its address is user_data of SQE.
+struct CoroutineReadAwaiter
+{
+	int FileDescriptor;
+	BYTE* Buffer;
+	UINT ByteSize;
+	UINT64 Offset;
+	int Result;
+	std::coroutine_handle<> Handle;
+
+	bool await_ready() const noexcept { return false; }
+
+	void await_suspend(const std::coroutine_handle<> handle)
+	{
+		Handle = handle;
+
+		// Ring is owned by thread, and in-flight count is under queue depth, so SQ has room.
+		IoUring::Ring& ring = *t_coroutineScheduler.Ring;
+
+		io_uring_sqe* sqe = ring.GetSqe();
+		if (sqe == nullptr)
+			THROW_ERROR(L"SQ is full.");
+
+		sqe->opcode = IORING_OP_READ;
+		sqe->fd = FileDescriptor;
+		sqe->addr = reinterpret_cast<UINT64>(Buffer);
+		sqe->len = ByteSize;
+		sqe->off = Offset;
+		sqe->user_data = reinterpret_cast<UINT64>(this);
+
+		if (ring.PendingCount() >= g_testArgs.IoSubmitBatch)
+		{
+			if (ring.Submit() < 0)
+				THROW_ERROR(L"Failed to submit SQE.");
+			g_submitCallCount++;
+		}
+
+		t_coroutineScheduler.InflightCount++;
+		t_coroutineScheduler.SuspendCount++;
+	}
+
+	int await_resume() const noexcept { return Result; }
+};
+
+// Admission to memory budget. Suspends only if budget is full, then scheduler resumes it once admitted.
+struct CoroutineBudgetAwaiter
+{
+	UINT64 ByteSize;
+
+	bool await_ready() const { return TRUE == MemoryBudget::TryAcquire(ByteSize); }
+
+	void await_suspend(const std::coroutine_handle<> handle)
+	{
+		t_coroutineScheduler.BudgetWaiter = handle;
+		t_coroutineScheduler.BudgetWaiterByteSize = ByteSize;
+		t_coroutineScheduler.SuspendCount++;
+	}
+
+	void await_resume() const noexcept {}
+};
+
+// Whole life of one file. State between read submit and compute lives in frame, not in per-file array.
+static Coroutine::FileTask RunFileCoroutine(const UINT fid)
+{
+	SPAN_INIT;
+	SPAN_START(0, "Read Call Task", fid);
+
+	Latency::Stamp(fid, Latency::STAGE_READ_START);
+
+	UINT64 fileByteSize;
+	UINT64 fileOffset;
+	const int fd = OpenDatasetFile(fid, O_RDONLY | O_DIRECT, &fileByteSize, &fileOffset);
+	const UINT64 alignedFileByteSize = GetAlignedByteSize(fileByteSize, g_directIoAlignment);
+
+	SPAN_END;
+
+	co_await CoroutineBudgetAwaiter{ alignedFileByteSize };
+
+	BYTE* fileBuffer = AllocateFileBuffer(alignedFileByteSize);
+	g_totalFileSize += fileByteSize;
+
+	const int readResult = co_await CoroutineReadAwaiter{ fd, fileBuffer, static_cast<UINT>(alignedFileByteSize), fileOffset };
+	if (readResult < 0)
+	{
+		errno = -readResult;
+		THROW_ERROR(L"Failed to read file.");
+	}
+
+	Latency::Stamp(fid, Latency::STAGE_READ_COMPLETE);
+
+	SPAN_START(2, "Compute", fid);
+
+	Latency::Stamp(fid, Latency::STAGE_COMPUTE_START);
+	CalculateChecksum(fileBuffer, fileByteSize);
+	Latency::Complete(fid);
+	Topology::AddTraffic(fileBuffer, fileByteSize);
+
+	SPAN_END;
+
+	// Release resources.
+	ReleaseFileBuffer(fileBuffer, alignedFileByteSize);
+	MemoryBudget::Release(alignedFileByteSize);
+	CloseDatasetFile(fd);
+
+	if (++g_completeFileCount == g_testArgs.TestFileCount)
+	{
+		for (UINT t = 0; t < g_testArgs.ThreadCount; t++)
+			PostGlobalTask(g_exitCode);
+	}
+}
+
+// Resume coroutines whose read completed on ring of calling thread. Compute of those files runs here.
+static void ReapCoroutineCompletion(const BOOL wait)
+{
+	IoUring::Ring& ring = *t_coroutineScheduler.Ring;
+
+	// Staged SQEs must be submitted, or nothing will complete.
+	if (wait && ring.PendingCount() > 0)
+	{
+		if (ring.Submit() < 0)
+			THROW_ERROR(L"Failed to submit SQE.");
+		g_submitCallCount++;
+	}
+
+	io_uring_cqe* cqe = wait ? ring.WaitCqe() : ring.PeekCqe();
+
+	while (cqe != nullptr)
+	{
+		CoroutineReadAwaiter* awaiter = reinterpret_cast<CoroutineReadAwaiter*>(cqe->user_data);
+		awaiter->Result = cqe->res;
+		ring.SeenCqe();
+
+		t_coroutineScheduler.InflightCount--;
+		awaiter->Handle.resume();
+
+		cqe = ring.PeekCqe();
+	}
+}
+
+void ThreadSchedule::CoroutineThreadFunc(const UINT t)
+{
+	SERIES_INIT("Coroutine");
+
+	CoroutineScheduler& scheduler = t_coroutineScheduler;
+	scheduler = { &g_workerRingAry[t], 0, nullptr, 0, 0 };
+
+	while (TRUE)
+	{
+		if (scheduler.InflightCount > 0)
+			ReapCoroutineCompletion(FALSE);
+
+		// Own reads release budget when computed, so they are reaped before blocking on others.
+		if (scheduler.BudgetWaiter)
+		{
+			if (FALSE == MemoryBudget::TryAcquire(scheduler.BudgetWaiterByteSize))
+			{
+				if (scheduler.InflightCount > 0)
+				{
+					ReapCoroutineCompletion(TRUE);
+					continue;
+				}
+
+				MemoryBudget::Acquire(scheduler.BudgetWaiterByteSize);
+			}
+
+			const std::coroutine_handle<> handle = scheduler.BudgetWaiter;
+			scheduler.BudgetWaiter = nullptr;
+			handle.resume();
+			continue;
+		}
+
+		// Wait until in-flight read count goes under queue depth.
+		if (scheduler.InflightCount >= g_testArgs.IoQueueDepth)
+		{
+			ReapCoroutineCompletion(TRUE);
+			continue;
+		}
+
+		// Block on queue only when no read of this thread is in flight.
+		UINT fid;
+		if (FALSE == GetGlobalTask(&fid, scheduler.InflightCount > 0 ? 0 : INFINITE))
+		{
+			ReapCoroutineCompletion(TRUE);
+			continue;
+		}
+
+		if (fid == g_exitCode) break;
+		if (fid >= g_testArgs.TestFileCount) THROW_ERROR(L"FID out of range.");
+
+		g_coroutineAry[fid].resume();
+	}
+
+	g_coroutineSuspendCount += scheduler.SuspendCount;
+}
+
+// Post each file to global task queue when its arrival is due. Open loop, so posting never waits for threads.
+static void PostArrivals(const std::vector<UINT>& postOrderAry)
+{
+	double postTime = 0;
+
+	for (UINT i = 0; i < postOrderAry.size(); i++)
+	{
+		const UINT fid = postOrderAry[i];
+		Latency::StampAt(fid, Latency::STAGE_POST, Arrival::WaitArrival(i));
+
+		if (g_testArgs.UseRebalancer)
+			Rebalancer::AddQueueDepth(Rebalancer::ROLE_READCALL, 1);
+
+		TIMER_INIT;
+		TIMER_START;
+
+		PostGlobalTask(fid);
+
+		if (g_testArgs.SimType == SIM_WORK_STEALING_THREAD)
+			WakeWorkStealingThreads();
+
+		TIMER_STOP;
+		postTime += el;
+	}
+
+	g_testResult.DispatchPostNanoSeconds = postTime * 1000 * 1000 * 1000 / postOrderAry.size();
+}
+
+TestResult ThreadSchedule::StartTest(TestArgument args)
+{
+	g_testResult = { 0 };
+	g_testArgs = args;
+
+	Trace::Init(g_testArgs.TraceFilePath);
+
+	SERIES_INIT("Main Thread");
+	SPAN_INIT;
+
+	g_testResult.ComputeKernelUsed = ComputeKernel::Init(g_testArgs.ComputeKernel);
+
+	if (g_testArgs.UseDefinedComputeTime)
+		ComputeModel::Init(g_testArgs.ComputeProfile);
+
+	if (g_testArgs.SimType != SIM_IO_URING_THREAD &&
+		g_testArgs.SimType != SIM_SYNC_THREAD &&
+		g_testArgs.SimType != SIM_MMAP_THREAD &&
+		g_testArgs.SimType != SIM_WORK_STEALING_THREAD &&
+		g_testArgs.SimType != SIM_COROUTINE_THREAD)
+		THROW_ERROR(L"Simulation type is not supported on this platform.");
+
+	if (g_testArgs.UseRebalancer && g_testArgs.SimType != SIM_IO_URING_THREAD)
+		THROW_ERROR(L"Rebalancer is only supported by IO_URING on this platform.");
+
+	if (g_testArgs.UseNowaitRead && g_testArgs.SimType != SIM_IO_URING_THREAD)
+		THROW_ERROR(L"RWF_NOWAIT read is only supported by IO_URING.");
+
+	// Manifest gives size, compute time and offset in packed data file of every file.
+	const BOOL useManifest = g_testArgs.DatasetLayout == DATASET_LAYOUT_PACKED || g_testArgs.PostOrder != POST_ORDER_FIFO;
+	if (useManifest)
+		Dataset::LoadManifest(g_testArgs.TestFileCount);
+
+	const std::vector<UINT> postOrderAry = Dataset::GetPostOrder(g_testArgs.TestFileCount, g_testArgs.PostOrder, g_testArgs.UseDefinedComputeTime);
+
+	// Open packed data file once.
+	if (g_testArgs.DatasetLayout == DATASET_LAYOUT_PACKED)
+	{
+		if (g_testArgs.SimType == SIM_MMAP_THREAD || g_testArgs.UseNowaitRead)
+			g_packedBufferedFd = open(Dataset::g_packedDataPath, O_RDONLY);
+		else
+			g_packedDirectFd = open(Dataset::g_packedDataPath, O_RDONLY | O_DIRECT);
+
+		if (g_packedBufferedFd < 0 && g_packedDirectFd < 0)
+			THROW_ERROR(L"Failed to open packed data file.");
+	}
+
+	ResetPeakMemory();
+
+	// dTLB miss counter is inherited by threads created from here.
+	HugePage::Init(g_testArgs.BufferPage == BUFFER_PAGE_HUGE);
+
+	// Initialize io_uring if needed.
+	if (g_testArgs.SimType == SIM_IO_URING_THREAD)
+	{
+		if (g_testArgs.ThreadRoleAry == NULL ||
+			g_testArgs.ThreadRoleAry[0] == 0 || g_testArgs.ThreadRoleAry[1] == 0 ||
+			g_testArgs.ThreadRoleAry[2] != 0 || g_testArgs.ThreadRoleAry[3] != 0)
+			THROW_ERROR(L"IO_URING needs READCALL_ONLY and COMPUTE_ONLY threads only.");
+
+		if (g_testArgs.IoQueueDepth == 0)
+			g_testArgs.IoQueueDepth = g_defaultIoQueueDepth;
+		if (g_testArgs.IoSubmitBatch == 0)
+			g_testArgs.IoSubmitBatch = g_defaultIoSubmitBatch;
+
+		g_computeThreadCount = g_testArgs.ThreadRoleAry[1];
+
+		if (g_testArgs.UseRebalancer)
+		{
+			const UINT initialThreadCount = g_testArgs.ThreadRoleAry[0] + g_testArgs.ThreadRoleAry[1];
+
+			if (g_testArgs.MinThreadCount == 0)
+				g_testArgs.MinThreadCount = 2;
+			if (g_testArgs.MaxThreadCount == 0)
+				g_testArgs.MaxThreadCount = initialThreadCount;
+
+			if (g_testArgs.MinThreadCount < 2 || g_testArgs.MinThreadCount > initialThreadCount || initialThreadCount > g_testArgs.MaxThreadCount)
+				THROW_ERROR(L"Rebalancer needs 2 <= min thread count <= initial thread count <= max thread count.");
+
+			// Pool is created at max size. Threads beyond initial roles start parked.
+			// Any of them can be on CQ at the end, so every one gets exit NOP.
+			g_testArgs.ThreadCount = g_testArgs.MaxThreadCount;
+			g_computeThreadCount = g_testArgs.ThreadCount;
+
+			Rebalancer::Init(
+				g_testArgs.ThreadRoleAry[0],
+				g_testArgs.ThreadRoleAry[1],
+				g_testArgs.MinThreadCount,
+				g_testArgs.MaxThreadCount,
+				WakeIoUringRole,
+				LeaveIoUringRole);
+		}
+
+		if (FALSE == g_ring.Init(g_testArgs.IoQueueDepth))
+			THROW_ERROR(L"Failed to setup io_uring.");
+
+		g_fileContextAry = new FileContext[g_testArgs.TestFileCount];
+	}
+
+	// Initialize per-thread rings, deques if needed.
+	if (g_testArgs.SimType == SIM_WORK_STEALING_THREAD)
+	{
+		if (g_testArgs.IoQueueDepth == 0)
+			g_testArgs.IoQueueDepth = g_defaultIoQueueDepth;
+		if (g_testArgs.IoSubmitBatch == 0)
+			g_testArgs.IoSubmitBatch = g_defaultIoSubmitBatch;
+
+		g_workerRingAry = new IoUring::Ring[g_testArgs.ThreadCount];
+		g_dequeAry = new WorkStealingDeque[g_testArgs.ThreadCount];
+
+		// Deque of thread holds its initial ReadCall tasks, and at most every Compute task.
+		for (UINT t = 0; t < g_testArgs.ThreadCount; t++)
+		{
+			if (FALSE == g_workerRingAry[t].Init(g_testArgs.IoQueueDepth))
+				THROW_ERROR(L"Failed to setup io_uring.");
+
+			g_dequeAry[t].Init(g_testArgs.TestFileCount + g_testArgs.TestFileCount / g_testArgs.ThreadCount + 1);
+		}
+
+		g_fileContextAry = new FileContext[g_testArgs.TestFileCount];
+	}
+
+	// Initialize per-thread rings, coroutine of every file if needed.
+	if (g_testArgs.SimType == SIM_COROUTINE_THREAD)
+	{
+		if (g_testArgs.IoQueueDepth == 0)
+			g_testArgs.IoQueueDepth = g_defaultIoQueueDepth;
+		if (g_testArgs.IoSubmitBatch == 0)
+			g_testArgs.IoSubmitBatch = g_defaultIoSubmitBatch;
+
+		g_workerRingAry = new IoUring::Ring[g_testArgs.ThreadCount];
+		for (UINT t = 0; t < g_testArgs.ThreadCount; t++)
+		{
+			if (FALSE == g_workerRingAry[t].Init(g_testArgs.IoQueueDepth))
+				THROW_ERROR(L"Failed to setup io_uring.");
+		}
+
+		Coroutine::Init();
+
+		TIMER_INIT;
+		TIMER_START;
+
+		// Every file is alive as suspended coroutine before first one starts.
+		g_coroutineAry = new std::coroutine_handle<>[g_testArgs.TestFileCount];
+		for (UINT fid = 0; fid < g_testArgs.TestFileCount; fid++)
+			g_coroutineAry[fid] = RunFileCoroutine(fid).Handle;
+
+		TIMER_STOP;
+		g_testResult.FileSetupTime = el * 1000;
+	}
+
+	// Create prefetch threads if needed.
+	if (g_testArgs.SimType == SIM_MMAP_THREAD && g_testArgs.MmapPrefetchByteSize > 0)
+	{
+		g_prefetchSlotAry = new MmapPrefetchSlot[g_testArgs.ThreadCount];
+		g_prefetchThreadAry = new std::thread[g_testArgs.ThreadCount];
+
+		for (UINT t = 0; t < g_testArgs.ThreadCount; t++)
+		{
+			g_prefetchSlotAry[t].Base = nullptr;
+			g_prefetchSlotAry[t].ByteSize = 0;
+			g_prefetchSlotAry[t].PrefetchedByteSize = 0;
+			g_prefetchSlotAry[t].Cursor = 0;
+			g_prefetchSlotAry[t].Stop = FALSE;
+			g_prefetchThreadAry[t] = std::thread(MMAPPrefetchThreadFunc, t);
+		}
+	}
+
+	// Roles of rebalanced pool change at runtime, so its threads are placed as mixed.
+	std::vector<UINT> threadRoleAry(g_testArgs.ThreadCount, THREAD_ROLE_READCALL_AND_COMPUTE);
+	if (g_testArgs.SimType == SIM_IO_URING_THREAD && FALSE == g_testArgs.UseRebalancer)
+	{
+		for (UINT t = 0; t < g_testArgs.ThreadCount; t++)
+			threadRoleAry[t] = GetThreadRole(t);
+	}
+
+	Topology::Init(g_testArgs.ThreadPlacement, threadRoleAry);
+
+	// Task queue must hold every FID and exit codes at once.
+	g_globalTaskQueue.Init(g_testArgs.TestFileCount + g_testArgs.ThreadCount * 2);
+
+	// Create threads.
+	g_threadAry = new std::thread[g_testArgs.ThreadCount];
+	for (UINT t = 0; t < g_testArgs.ThreadCount; t++)
+	{
+		switch (g_testArgs.SimType)
+		{
+		case SIM_IO_URING_THREAD:
+			if (g_testArgs.UseRebalancer)
+				g_threadAry[t] = std::thread(IoUringRebalancedThreadFunc);
+			else
+				g_threadAry[t] = std::thread(IoUringThreadFunc, GetThreadRole(t));
+			break;
+
+		case SIM_SYNC_THREAD:
+			g_threadAry[t] = std::thread(SyncThreadFunc);
+			break;
+
+		case SIM_MMAP_THREAD:
+			g_threadAry[t] = std::thread(MMAPThreadFunc, t);
+			break;
+
+		case SIM_WORK_STEALING_THREAD:
+			// Created after deques are filled.
+			break;
+
+		case SIM_COROUTINE_THREAD:
+			g_threadAry[t] = std::thread(CoroutineThreadFunc, t);
+			break;
+
+		default:
+			break;
+		}
+
+		if (g_threadAry[t].joinable())
+			Topology::PinThread(t, g_threadAry[t].native_handle());
+	}
+
+	if (g_testArgs.UseBufferPool)
+		BufferPool::Init(g_testArgs.BufferPoolByteSize, g_testArgs.BufferPoolPreTouch);
+
+	MemoryBudget::Init(g_testArgs.MemoryBudgetByteSize, g_testArgs.ThreadCount);
+
+	Latency::Init(g_testArgs.TestFileCount);
+
+	if (g_testArgs.ArrivalRate > 0)
+		Arrival::Init(g_testArgs.Arrival, g_testArgs.ArrivalRate, g_testArgs.TestFileCount, g_testArgs.ArrivalBurstPeriodMicroSeconds, g_testArgs.ArrivalBurstOnPercent);
+
+	SPAN_START(Trace::CATEGORY_TEST, "Loading Time");
+
+	rusage usageStart;
+	getrusage(RUSAGE_SELF, &usageStart);
+
+	HugePage::StartDtlbCount();
+
+	TIMER_INIT;
+	TIMER_START;
+
+	if (g_testArgs.ArrivalRate > 0)
+	{
+		// Work stealing threads take arrivals from global task queue when own deque is empty.
+		if (g_testArgs.SimType == SIM_WORK_STEALING_THREAD)
+		{
+			for (UINT t = 0; t < g_testArgs.ThreadCount; t++)
+			{
+				g_threadAry[t] = std::thread(WorkStealingThreadFunc, t);
+				Topology::PinThread(t, g_threadAry[t].native_handle());
+			}
+		}
+
+		Arrival::Start();
+		PostArrivals(postOrderAry);
+	}
+	else if (g_testArgs.SimType == SIM_WORK_STEALING_THREAD)
+	{
+		// Spread ReadCall tasks over deques. Threads are not running yet, so pushing from here is safe.
+		// Owner pops last pushed task first, so tasks are pushed in reverse of post order.
+		TIMER_INIT;
+		TIMER_START;
+
+		for (UINT i = args.TestFileCount; i-- > 0;)
+		{
+			const UINT fid = postOrderAry[i];
+			Latency::Stamp(fid, Latency::STAGE_POST);
+			g_dequeAry[i % g_testArgs.ThreadCount].Push(static_cast<UINT64>(THREAD_TASK_READ_CALL) << g_taskTypeShift | fid);
+		}
+
+		TIMER_STOP;
+		g_testResult.DispatchPostNanoSeconds = el * 1000 * 1000 * 1000 / args.TestFileCount;
+
+		for (UINT t = 0; t < g_testArgs.ThreadCount; t++)
+		{
+			g_threadAry[t] = std::thread(WorkStealingThreadFunc, t);
+			Topology::PinThread(t, g_threadAry[t].native_handle());
+		}
+	}
+	else
+	{
+		// Just put tasks into Task Queue.
+		if (g_testArgs.UseRebalancer)
+			Rebalancer::AddQueueDepth(Rebalancer::ROLE_READCALL, args.TestFileCount);
+
+		TIMER_INIT;
+		TIMER_START;
+
+		for (const UINT fid : postOrderAry)
+		{
+			Latency::Stamp(fid, Latency::STAGE_POST);
+			PostGlobalTask(fid);
+		}
+
+		TIMER_STOP;
+		g_testResult.DispatchPostNanoSeconds = el * 1000 * 1000 * 1000 / args.TestFileCount;
+	}
+
+	for (UINT t = 0; t < g_testArgs.ThreadCount; t++)
+		g_threadAry[t].join();
+
+	TIMER_STOP;
+
+	SPAN_END;
+
+	rusage usageEnd;
+	getrusage(RUSAGE_SELF, &usageEnd);
+
+	// Release shared resources.
+	delete[] g_threadAry;
+	g_globalTaskQueue.Clear();
+
+	if (g_testArgs.DatasetLayout == DATASET_LAYOUT_PACKED)
+	{
+		SAFE_CLOSE_FD(g_packedDirectFd);
+		SAFE_CLOSE_FD(g_packedBufferedFd);
+		g_packedDirectFd = -1;
+		g_packedBufferedFd = -1;
+	}
+
+	if (useManifest)
+		Dataset::UnloadManifest();
+
+	if (g_testArgs.SimType == SIM_IO_URING_THREAD)
+	{
+		delete[] g_fileContextAry;
+		g_ring.Exit();
+	}
+
+	if (g_testArgs.UseRebalancer)
+	{
+		const Rebalancer::RebalancerStats rebalancerStats = Rebalancer::Shutdown();
+		g_testResult.RebalanceSwitchCount = rebalancerStats.SwitchCount;
+		g_testResult.RebalanceGrowCount = rebalancerStats.GrowCount;
+		g_testResult.RebalanceShrinkCount = rebalancerStats.ShrinkCount;
+		g_testResult.MeanReadCallThreadCount = rebalancerStats.MeanReadCallThreadCount;
+		g_testResult.MeanComputeThreadCount = rebalancerStats.MeanComputeThreadCount;
+	}
+
+	if (g_testArgs.SimType == SIM_WORK_STEALING_THREAD)
+	{
+		for (UINT t = 0; t < g_testArgs.ThreadCount; t++)
+			g_workerRingAry[t].Exit();
+
+		delete[] g_workerRingAry;
+		delete[] g_dequeAry;
+		delete[] g_fileContextAry;
+
+		g_testResult.StealReadCallCount = g_stealReadCallCount;
+		g_testResult.StealComputeCount = g_stealComputeCount;
+		g_testResult.StealFailCount = g_stealFailCount;
+		g_testResult.LocalComputeCount = g_localComputeCount;
+	}
+
+	if (g_testArgs.SimType == SIM_COROUTINE_THREAD)
+	{
+		for (UINT t = 0; t < g_testArgs.ThreadCount; t++)
+			g_workerRingAry[t].Exit();
+
+		delete[] g_workerRingAry;
+		delete[] g_coroutineAry;
+
+		const Coroutine::FramePoolStats frameStats = Coroutine::Shutdown();
+		g_testResult.CoroutineFrameByteSize = frameStats.FrameByteSize;
+		g_testResult.CoroutinePeakFrameCount = frameStats.PeakFrameCount;
+		g_testResult.CoroutineFramePoolByteSize = frameStats.SlabByteSize;
+		g_testResult.CoroutineSuspendCount = g_coroutineSuspendCount;
+	}
+
+	if (g_testArgs.SimType == SIM_MMAP_THREAD && g_testArgs.MmapPrefetchByteSize > 0)
+	{
+		for (UINT t = 0; t < g_testArgs.ThreadCount; t++)
+		{
+			{
+				std::lock_guard<std::mutex> lock(g_prefetchSlotAry[t].Lock);
+				g_prefetchSlotAry[t].Stop = TRUE;
+			}
+			g_prefetchSlotAry[t].Cv.notify_one();
+			g_prefetchThreadAry[t].join();
+		}
+
+		delete[] g_prefetchThreadAry;
+		delete[] g_prefetchSlotAry;
+	}
+
+	if (g_testArgs.UseDefinedComputeTime)
+	{
+		const ComputeModel::ComputeModelStats computeStats = ComputeModel::Shutdown();
+		g_testResult.ComputeUnitsPerMicroSecond = computeStats.UnitsPerMicroSecond;
+		g_testResult.MeanComputeOvershoot = computeStats.MeanOvershoot;
+		g_testResult.MeanComputeTimerCheckCount = computeStats.MeanTimerCheckCount;
+	}
+
+	const Trace::TraceStats traceStats = Trace::Shutdown();
+	g_testResult.TraceEventCount = traceStats.EventCount;
+	g_testResult.TraceDroppedEventCount = traceStats.DroppedEventCount;
+
+	const Topology::TopologyStats topologyStats = Topology::Shutdown();
+	g_testResult.NodeCount = topologyStats.NodeCount;
+	g_testResult.CoreCount = topologyStats.CoreCount;
+	g_testResult.CpuCount = topologyStats.CpuCount;
+	g_testResult.PinnedThreadCount = topologyStats.PinnedThreadCount;
+	g_testResult.PlacedBufferCount = topologyStats.PlacedBufferCount;
+	memcpy(g_testResult.NodeLocalByteSizeAry, topologyStats.LocalByteSizeAry, sizeof(g_testResult.NodeLocalByteSizeAry));
+	memcpy(g_testResult.NodeRemoteByteSizeAry, topologyStats.RemoteByteSizeAry, sizeof(g_testResult.NodeRemoteByteSizeAry));
+
+	const HugePage::HugePageStats hugePageStats = HugePage::Shutdown();
+	g_testResult.IsDtlbMissCounted = hugePageStats.IsDtlbCounted;
+	g_testResult.DtlbMissCount = hugePageStats.DtlbMissCount;
+	if (g_testArgs.BufferPage == BUFFER_PAGE_HUGE)
+	{
+		g_testResult.HugePageByteSize = hugePageStats.HugePageByteSize;
+		g_testResult.HugePageBufferCount = hugePageStats.HugeTlbCount;
+		g_testResult.TransparentHugePageBufferCount = hugePageStats.TransparentCount;
+		g_testResult.SmallPageBufferCount = hugePageStats.SmallPageCount;
+		g_testResult.SmallBufferCount = hugePageStats.SmallBufferCount;
+	}
+
+	if (g_testArgs.ArrivalRate > 0)
+	{
+		const Arrival::ArrivalStats arrivalStats = Arrival::Shutdown();
+		g_testResult.OfferedRate = arrivalStats.OfferedRate;
+		g_testResult.MeanArrivalLag = arrivalStats.MeanPostLag;
+		g_testResult.MaxArrivalLag = arrivalStats.MaxPostLag;
+	}
+
+	const Latency::LatencyStats latencyStats = Latency::Shutdown();
+	g_testResult.QueueWaitLatency = latencyStats.QueueWait;
+	g_testResult.ReadLatency = latencyStats.Read;
+	g_testResult.ComputeWaitLatency = latencyStats.ComputeWait;
+	g_testResult.ComputeLatency = latencyStats.Compute;
+	g_testResult.TotalLatency = latencyStats.Total;
+
+	if (g_testArgs.UseNowaitRead)
+	{
+		g_testResult.NowaitHitCount = g_nowaitHitCount;
+		g_testResult.NowaitMissCount = g_nowaitMissCount;
+		g_testResult.NowaitHitReadLatency = latencyStats.PathRead[Latency::PATH_INLINE];
+		g_testResult.NowaitHitTotalLatency = latencyStats.PathTotal[Latency::PATH_INLINE];
+		g_testResult.NowaitMissReadLatency = latencyStats.PathRead[Latency::PATH_ASYNC];
+		g_testResult.NowaitMissTotalLatency = latencyStats.PathTotal[Latency::PATH_ASYNC];
+	}
+
+	if (g_testArgs.UseBufferPool)
+	{
+		const BufferPool::BufferPoolStats poolStats = BufferPool::Shutdown();
+		g_testResult.BufferPoolHitCount = poolStats.HitCount;
+		g_testResult.BufferPoolMissCount = poolStats.MissCount;
+		g_testResult.BufferPoolHighWaterByteSize = poolStats.HighWaterByteSize;
+	}
+
+	const MemoryBudget::MemoryBudgetStats budgetStats = MemoryBudget::Shutdown();
+	g_testResult.MemoryBudgetWaitCount = budgetStats.WaitCount;
+	g_testResult.MemoryBudgetWaitTime = budgetStats.WaitTime;
+	g_testResult.MemoryBudgetOverCommitCount = budgetStats.OverCommitCount;
+	g_testResult.MemoryBudgetHighWaterByteSize = budgetStats.HighWaterByteSize;
+
+	// Analyze results.
+	g_testResult.ElapsedTime = el * 1000;
+	g_testResult.TotalFileSize = g_totalFileSize;
+	g_testResult.PeakMemory = GetPeakMemory();
+	g_testResult.SubmitCallCount = g_submitCallCount;
+	g_testResult.MajorFaultCount = usageEnd.ru_majflt - usageStart.ru_majflt;
+	g_testResult.MinorFaultCount = usageEnd.ru_minflt - usageStart.ru_minflt;
+	if (g_dispatchGetCount > 0)
+		g_testResult.DispatchGetNanoSeconds = static_cast<double>(g_dispatchGetNanoSeconds) / g_dispatchGetCount;
+
+	// Reset status for next test.
+	g_completeFileCount = 0;
+	g_totalFileSize = 0;
+	g_submitCallCount = 0;
+	g_inflightCount = 0;
+	g_dispatchGetNanoSeconds = 0;
+	g_dispatchGetCount = 0;
+	g_stealReadCallCount = 0;
+	g_stealComputeCount = 0;
+	g_stealFailCount = 0;
+	g_workStealingEpoch = 0;
+	g_localComputeCount = 0;
+	g_nowaitHitCount = 0;
+	g_nowaitMissCount = 0;
+	g_coroutineSuspendCount = 0;
+
+	return g_testResult;
+}
+
+void ThreadSchedule::PostGlobalTask(const UINT fid)
+{
+	g_globalTaskQueue.Push(fid);
+}
+
+BOOL ThreadSchedule::GetGlobalTask(UINT* fid, const DWORD timeout)
+{
+	// Measure dequeue only when task is ready, so that waiting is not counted.
+	TIMER_INIT;
+	TIMER_START;
+
+	const BOOL result = g_globalTaskQueue.TryPop(fid);
+
+	TIMER_STOP;
+
+	if (result)
+	{
+		g_dispatchGetNanoSeconds.fetch_add(static_cast<UINT64>(el * 1000 * 1000 * 1000), std::memory_order_relaxed);
+		g_dispatchGetCount.fetch_add(1, std::memory_order_relaxed);
+		return TRUE;
+	}
+
+	if (timeout == 0)
+		return FALSE;
+
+	// No timed wait on TaskQueue. Any non-zero timeout blocks until task exists.
+	*fid = g_globalTaskQueue.Pop();
+	return TRUE;
+}
+
+UINT64 ThreadSchedule::GetAlignedByteSize(const UINT64 fileByteSize, const UINT64 sectorSize)
+{
+	return ((fileByteSize / sectorSize) + 1u) * sectorSize;
+}
+
+BYTE* ThreadSchedule::AllocateFileBuffer(const UINT64 alignedByteSize)
+{
+	BYTE* buffer = nullptr;
+
+	if (g_testArgs.UseBufferPool)
+		buffer = BufferPool::Acquire(alignedByteSize);
+	else if (g_testArgs.BufferPage == BUFFER_PAGE_HUGE)
+		buffer = HugePage::Allocate(alignedByteSize);
+	else if (Topology::IsPlacingBuffers())
+		buffer = Topology::Allocate(alignedByteSize);
+	else if (0 != posix_memalign(reinterpret_cast<void**>(&buffer), g_directIoAlignment, alignedByteSize))
+		buffer = nullptr;
+
+	if (buffer == nullptr)
+		THROW_ERROR(L"Failed to allocate buffer.");
+
+	return buffer;
+}
+
+void ThreadSchedule::ReleaseFileBuffer(BYTE* buffer, const UINT64 alignedByteSize)
+{
+	if (g_testArgs.UseBufferPool)
+		BufferPool::Release(buffer, alignedByteSize);
+	else if (g_testArgs.BufferPage == BUFFER_PAGE_HUGE)
+		HugePage::Free(buffer, alignedByteSize);
+	else if (Topology::IsPlacingBuffers())
+		Topology::Free(buffer, alignedByteSize);
+	else
+		free(buffer);
+}
+
+void ThreadSchedule::ResetPeakMemory()
+{
+	// Writing 5 to clear_refs resets VmHWM (Linux 4.0+).
+	const int fd = open("/proc/self/clear_refs", O_WRONLY);
+	if (fd < 0)
+		return;
+
+	if (write(fd, "5", 1) < 0)
+	{
+		// Not permitted. VmHWM keeps process lifetime peak.
+	}
+
+	SAFE_CLOSE_FD(fd);
+}
+
+SIZE_T ThreadSchedule::GetPeakMemory()
+{
+	// Read VmHWM (peak RSS) from /proc. Falls back to getrusage.
+	FILE* statusFile = fopen("/proc/self/status", "r");
+	if (statusFile != NULL)
+	{
+		char line[256];
+		while (fgets(line, sizeof(line), statusFile) != NULL)
+		{
+			unsigned long long peakKiB = 0;
+			if (sscanf(line, "VmHWM: %llu kB", &peakKiB) == 1)
+			{
+				fclose(statusFile);
+				return static_cast<SIZE_T>(peakKiB) * 1024;
+			}
+		}
+		fclose(statusFile);
+	}
+
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	return static_cast<SIZE_T>(usage.ru_maxrss) * 1024;
+}
+#endif
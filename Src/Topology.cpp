@@ -0,0 +1,440 @@
+#include "pch.h"
+#include "ThreadSchedule.h"
+#include "Topology.h"
+
+#ifndef _WIN32
+#include <fstream>
+#endif
+
+using namespace ThreadSchedule;
+using namespace Topology;
+
+// SMT siblings of one physical core.
+struct CoreInfo
+{
+	UINT Node;
+	std::vector<UINT> CpuAry;
+};
+
+static ThreadPlacementType g_placement;
+
+// Cores the process may run on, grouped by node in node order.
+static std::vector<CoreInfo> g_coreAry;
+
+// OS node number of each node that has cores. Index is node index of stats.
+static std::vector<UINT> g_nodeIdAry;
+
+// Planned CPUs of each thread. Empty if thread is not pinned.
+static std::vector<std::vector<UINT>> g_threadCpuAry;
+
+static UINT g_pinnedThreadCount;
+static std::atomic<UINT64> g_placedBufferCount;
+static std::atomic<UINT64> g_localByteSizeAry[g_maxReportedNodeCount];
+static std::atomic<UINT64> g_remoteByteSizeAry[g_maxReportedNodeCount];
+
+#ifdef _WIN32
+static void ReadLayout()
+{
+	DWORD length = 0;
+	GetLogicalProcessorInformation(NULL, &length);
+
+	std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> infoAry(length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+	if (FALSE == GetLogicalProcessorInformation(infoAry.data(), &length))
+		THROW_ERROR(L"Failed to get processor topology.");
+
+	// Only processor group of process is seen, so up to 64 logical processors.
+	DWORD_PTR processMask = 0;
+	DWORD_PTR systemMask = 0;
+	GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask);
+
+	std::vector<std::pair<UINT, ULONG_PTR>> nodeMaskAry;
+	for (const SYSTEM_LOGICAL_PROCESSOR_INFORMATION& info : infoAry)
+	{
+		if (info.Relationship == RelationNumaNode)
+			nodeMaskAry.push_back({ info.NumaNode.NodeNumber, info.ProcessorMask });
+	}
+
+	for (const SYSTEM_LOGICAL_PROCESSOR_INFORMATION& info : infoAry)
+	{
+		if (info.Relationship != RelationProcessorCore)
+			continue;
+
+		const ULONG_PTR cpuMask = info.ProcessorMask & processMask;
+		if (cpuMask == 0)
+			continue;
+
+		CoreInfo core = {};
+		for (UINT cpu = 0; cpu < sizeof(ULONG_PTR) * 8; cpu++)
+		{
+			if (cpuMask & (static_cast<ULONG_PTR>(1) << cpu))
+				core.CpuAry.push_back(cpu);
+		}
+
+		for (const auto& nodeMask : nodeMaskAry)
+		{
+			if (nodeMask.second & cpuMask)
+				core.Node = nodeMask.first;
+		}
+
+		g_coreAry.push_back(core);
+	}
+}
+
+static UINT GetCurrentNode()
+{
+	PROCESSOR_NUMBER processorNumber;
+	GetCurrentProcessorNumberEx(&processorNumber);
+
+	USHORT node = 0;
+	GetNumaProcessorNodeEx(&processorNumber, &node);
+
+	return node;
+}
+
+static BOOL GetBufferNode(const BYTE* buffer, UINT* node)
+{
+	PSAPI_WORKING_SET_EX_INFORMATION info;
+	info.VirtualAddress = const_cast<BYTE*>(buffer);
+
+	if (FALSE == QueryWorkingSetEx(GetCurrentProcess(), &info, sizeof(info)) || FALSE == info.VirtualAttributes.Valid)
+		return FALSE;
+
+	*node = static_cast<UINT>(info.VirtualAttributes.Node);
+	return TRUE;
+}
+
+void Topology::PinThread(const UINT t, const ThreadHandle thread)
+{
+	if (t >= g_threadCpuAry.size() || g_threadCpuAry[t].empty())
+		return;
+
+	DWORD_PTR mask = 0;
+	for (const UINT cpu : g_threadCpuAry[t])
+		mask |= static_cast<DWORD_PTR>(1) << cpu;
+
+	if (0 == SetThreadAffinityMask(thread, mask))
+		THROW_ERROR(L"Failed to set thread affinity.");
+
+	g_pinnedThreadCount++;
+}
+
+BYTE* Topology::Allocate(const UINT64 byteSize)
+{
+	g_placedBufferCount++;
+	return static_cast<BYTE*>(VirtualAllocExNuma(GetCurrentProcess(), NULL, byteSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, GetCurrentNode()));
+}
+
+void Topology::Free(BYTE* buffer, const UINT64 byteSize)
+{
+	VirtualFree(buffer, 0, MEM_RELEASE);
+}
+#else
+// From <numaif.h>, which is part of libnuma package.
+constexpr int g_mpolBind = 2;
+constexpr int g_mpolFlagNode = 1;
+constexpr int g_mpolFlagAddress = 2;
+
+// Parse list of sysfs, like "0-3,8-11".
+static std::vector<UINT> ParseIdList(const std::string& text)
+{
+	std::vector<UINT> idAry;
+
+	size_t begin = 0;
+	while (begin < text.size())
+	{
+		size_t end = text.find(',', begin);
+		if (end == std::string::npos)
+			end = text.size();
+
+		const std::string range = text.substr(begin, end - begin);
+		const size_t dash = range.find('-');
+		const UINT first = static_cast<UINT>(strtoul(range.c_str(), nullptr, 10));
+		const UINT last = dash == std::string::npos ? first : static_cast<UINT>(strtoul(range.c_str() + dash + 1, nullptr, 10));
+
+		for (UINT id = first; id <= last; id++)
+			idAry.push_back(id);
+
+		begin = end + 1;
+	}
+
+	return idAry;
+}
+
+static std::string ReadSysFile(const std::string& path)
+{
+	std::ifstream file(path);
+	std::string text;
+	std::getline(file, text);
+
+	return text;
+}
+
+static void ReadLayout()
+{
+	cpu_set_t allowedSet;
+	CPU_ZERO(&allowedSet);
+	if (0 != sched_getaffinity(0, sizeof(allowedSet), &allowedSet))
+		THROW_ERROR(L"Failed to get process affinity.");
+
+	// Without NUMA in sysfs, every CPU is on node 0.
+	std::vector<UINT> nodeOfCpuAry(CPU_SETSIZE, 0);
+	for (const UINT node : ParseIdList(ReadSysFile("/sys/devices/system/node/online")))
+	{
+		for (const UINT cpu : ParseIdList(ReadSysFile("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist")))
+		{
+			if (cpu < CPU_SETSIZE)
+				nodeOfCpuAry[cpu] = node;
+		}
+	}
+
+	// Core is (package, core id). Core ids repeat across packages.
+	std::vector<std::pair<std::string, UINT>> coreKeyAry;
+	for (UINT cpu = 0; cpu < CPU_SETSIZE; cpu++)
+	{
+		if (FALSE == CPU_ISSET(cpu, &allowedSet))
+			continue;
+
+		const std::string topologyPath = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+		const std::string coreKey = ReadSysFile(topologyPath + "physical_package_id") + ":" + ReadSysFile(topologyPath + "core_id");
+
+		// CPU without topology in sysfs is a core by itself.
+		size_t c = 0;
+		while (c < coreKeyAry.size() && (coreKey == ":" || coreKeyAry[c].first != coreKey))
+			c++;
+
+		if (c == coreKeyAry.size())
+		{
+			coreKeyAry.push_back({ coreKey, cpu });
+			g_coreAry.push_back({ nodeOfCpuAry[cpu], {} });
+		}
+
+		g_coreAry[c].CpuAry.push_back(cpu);
+	}
+}
+
+static UINT GetCurrentNode()
+{
+	unsigned int cpu = 0;
+	unsigned int node = 0;
+	syscall(SYS_getcpu, &cpu, &node, nullptr);
+
+	return node;
+}
+
+static BOOL GetBufferNode(const BYTE* buffer, UINT* node)
+{
+	int bufferNode = 0;
+	if (0 != syscall(SYS_get_mempolicy, &bufferNode, nullptr, 0, buffer, g_mpolFlagNode | g_mpolFlagAddress))
+		return FALSE;
+
+	*node = static_cast<UINT>(bufferNode);
+	return TRUE;
+}
+
+void Topology::PinThread(const UINT t, const ThreadHandle thread)
+{
+	if (t >= g_threadCpuAry.size() || g_threadCpuAry[t].empty())
+		return;
+
+	cpu_set_t cpuSet;
+	CPU_ZERO(&cpuSet);
+	for (const UINT cpu : g_threadCpuAry[t])
+		CPU_SET(cpu, &cpuSet);
+
+	if (0 != pthread_setaffinity_np(thread, sizeof(cpuSet), &cpuSet))
+		THROW_ERROR(L"Failed to set thread affinity.");
+
+	g_pinnedThreadCount++;
+}
+
+BYTE* Topology::Allocate(const UINT64 byteSize)
+{
+	void* buffer = mmap(nullptr, byteSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buffer == MAP_FAILED)
+		return nullptr;
+
+	// Bind before first touch, so pages fault in on this node whoever touches them.
+	const UINT node = GetCurrentNode();
+	unsigned long nodeMaskAry[16] = { 0 };
+	if (node < sizeof(nodeMaskAry) * 8)
+	{
+		nodeMaskAry[node / (sizeof(unsigned long) * 8)] = 1UL << (node % (sizeof(unsigned long) * 8));
+		syscall(SYS_mbind, buffer, byteSize, g_mpolBind, nodeMaskAry, sizeof(nodeMaskAry) * 8, 0);
+	}
+
+	g_placedBufferCount++;
+	return static_cast<BYTE*>(buffer);
+}
+
+void Topology::Free(BYTE* buffer, const UINT64 byteSize)
+{
+	munmap(buffer, byteSize);
+}
+#endif
+
+static UINT GetNodeIndex(const UINT node)
+{
+	for (UINT i = 0; i < g_nodeIdAry.size(); i++)
+	{
+		if (g_nodeIdAry[i] == node)
+			return std::min<UINT>(i, g_maxReportedNodeCount - 1);
+	}
+
+	return 0;
+}
+
+// Pair k is ReadCall thread k and Compute thread k, so both ends of a hand-off are placed close.
+static void PlanThreads(const std::vector<UINT>& threadRoleAry)
+{
+	std::vector<UINT> readCallAry;
+	std::vector<UINT> computeAry;
+	std::vector<UINT> mixedAry;
+
+	for (UINT t = 0; t < threadRoleAry.size(); t++)
+	{
+		if (threadRoleAry[t] == THREAD_ROLE_READCALL_ONLY)
+			readCallAry.push_back(t);
+		else if (threadRoleAry[t] == THREAD_ROLE_COMPUTE_ONLY)
+			computeAry.push_back(t);
+		else
+			mixedAry.push_back(t);
+	}
+
+	// R0, C0, R1, C1, ..., then mixed role threads.
+	std::vector<UINT> orderAry;
+	for (UINT k = 0; k < std::max<size_t>(readCallAry.size(), computeAry.size()); k++)
+	{
+		if (k < readCallAry.size())
+			orderAry.push_back(readCallAry[k]);
+		if (k < computeAry.size())
+			orderAry.push_back(computeAry[k]);
+	}
+	orderAry.insert(orderAry.end(), mixedAry.begin(), mixedAry.end());
+
+	g_threadCpuAry.assign(threadRoleAry.size(), {});
+
+	switch (g_placement)
+	{
+	case THREAD_PLACEMENT_CORE:
+		// Own physical core per thread, filling node by node. SMT siblings only when cores run out.
+		for (UINT i = 0; i < orderAry.size(); i++)
+		{
+			const CoreInfo& core = g_coreAry[i % g_coreAry.size()];
+			g_threadCpuAry[orderAry[i]] = { core.CpuAry[(i / g_coreAry.size()) % core.CpuAry.size()] };
+		}
+		break;
+
+	case THREAD_PLACEMENT_SMT:
+	{
+		// Logical processors core after core, so pair lands on siblings of one core.
+		std::vector<UINT> cpuAry;
+		for (const CoreInfo& core : g_coreAry)
+			cpuAry.insert(cpuAry.end(), core.CpuAry.begin(), core.CpuAry.end());
+
+		for (UINT i = 0; i < orderAry.size(); i++)
+			g_threadCpuAry[orderAry[i]] = { cpuAry[i % cpuAry.size()] };
+		break;
+	}
+
+	case THREAD_PLACEMENT_NODE:
+	{
+		// k-th thread of each role goes to node k, so every node gets both roles.
+		auto placeOnNode = [](const std::vector<UINT>& threadAry)
+		{
+			for (UINT k = 0; k < threadAry.size(); k++)
+			{
+				const UINT node = g_nodeIdAry[k % g_nodeIdAry.size()];
+				for (const CoreInfo& core : g_coreAry)
+				{
+					if (core.Node == node)
+						g_threadCpuAry[threadAry[k]].insert(g_threadCpuAry[threadAry[k]].end(), core.CpuAry.begin(), core.CpuAry.end());
+				}
+			}
+		};
+
+		placeOnNode(readCallAry);
+		placeOnNode(computeAry);
+		placeOnNode(mixedAry);
+		break;
+	}
+
+	default:
+		break;
+	}
+}
+
+void Topology::Init(const ThreadPlacementType placement, const std::vector<UINT>& threadRoleAry)
+{
+	g_placement = placement;
+	g_coreAry.clear();
+	g_nodeIdAry.clear();
+	g_threadCpuAry.clear();
+	g_pinnedThreadCount = 0;
+	g_placedBufferCount = 0;
+
+	for (UINT n = 0; n < g_maxReportedNodeCount; n++)
+	{
+		g_localByteSizeAry[n] = 0;
+		g_remoteByteSizeAry[n] = 0;
+	}
+
+	if (g_placement == THREAD_PLACEMENT_NONE)
+		return;
+
+	ReadLayout();
+	if (g_coreAry.empty())
+		THROW_ERROR(L"No processor found for thread placement.");
+
+	std::stable_sort(g_coreAry.begin(), g_coreAry.end(), [](const CoreInfo& a, const CoreInfo& b) { return a.Node < b.Node; });
+
+	for (const CoreInfo& core : g_coreAry)
+	{
+		if (g_nodeIdAry.empty() || g_nodeIdAry.back() != core.Node)
+			g_nodeIdAry.push_back(core.Node);
+	}
+
+	PlanThreads(threadRoleAry);
+}
+
+BOOL Topology::IsPlacingBuffers()
+{
+	return g_placement >= THREAD_PLACEMENT_CORE;
+}
+
+void Topology::AddTraffic(const BYTE* buffer, const UINT64 byteSize)
+{
+	if (g_placement == THREAD_PLACEMENT_NONE || byteSize == 0)
+		return;
+
+	UINT bufferNode;
+	if (FALSE == GetBufferNode(buffer, &bufferNode))
+		return;
+
+	const UINT node = GetCurrentNode();
+	if (bufferNode == node)
+		g_localByteSizeAry[GetNodeIndex(node)] += byteSize;
+	else
+		g_remoteByteSizeAry[GetNodeIndex(node)] += byteSize;
+}
+
+TopologyStats Topology::Shutdown()
+{
+	TopologyStats stats = { 0 };
+	stats.NodeCount = static_cast<UINT>(g_nodeIdAry.size());
+	stats.CoreCount = static_cast<UINT>(g_coreAry.size());
+	stats.PinnedThreadCount = g_pinnedThreadCount;
+	stats.PlacedBufferCount = g_placedBufferCount;
+
+	for (const CoreInfo& core : g_coreAry)
+		stats.CpuCount += static_cast<UINT>(core.CpuAry.size());
+
+	for (UINT n = 0; n < g_maxReportedNodeCount; n++)
+	{
+		stats.LocalByteSizeAry[n] = g_localByteSizeAry[n];
+		stats.RemoteByteSizeAry[n] = g_remoteByteSizeAry[n];
+	}
+
+	g_threadCpuAry.clear();
+
+	return stats;
+}
@@ -0,0 +1,186 @@
+#include "pch.h"
+#include "Trace.h"
+
+#include <fstream>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define TRACE_TSC
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+using namespace Trace;
+
+struct Event
+{
+	const char* Name;
+	UINT64 Start;
+	UINT64 End;
+	UINT Arg;
+	UINT Category;
+};
+
+struct ThreadRing
+{
+	UINT ThreadIndex;
+	const char* Name;
+	Event* EventAry;
+	UINT64 WriteCount;
+};
+
+static_assert((g_threadEventCapacity & (g_threadEventCapacity - 1)) == 0, "Event capacity must be power of 2.");
+
+static const char* const g_categoryNameAry[] = { "ReadCall", "Completion", "Compute", "Test" };
+
+// Set before threads start, read-only while running.
+static BOOL g_enabled;
+static std::string g_filePath;
+
+// Ticks of Init, converted to us by clock of Init / Shutdown.
+static UINT64 g_startTick;
+static std::chrono::steady_clock::time_point g_startTime;
+
+// Ring of each thread. List is locked only when thread records first time.
+static std::vector<ThreadRing*> g_ringList;
+static std::mutex g_ringListLock;
+static UINT g_generation = 1;
+
+struct ThreadRingHolder
+{
+	UINT Generation = 0;
+	ThreadRing* Data = nullptr;
+
+	// Rings of previous test were released by Shutdown.
+	ThreadRing* Get()
+	{
+		if (Generation == g_generation)
+			return Data;
+
+		Generation = g_generation;
+		Data = new ThreadRing();
+		Data->EventAry = new Event[g_threadEventCapacity];
+
+		std::lock_guard<std::mutex> lock(g_ringListLock);
+		Data->ThreadIndex = static_cast<UINT>(g_ringList.size());
+		g_ringList.push_back(Data);
+
+		return Data;
+	}
+};
+
+static thread_local ThreadRingHolder t_threadRing;
+
+// TSC where available. Invariant TSC is assumed, so that ticks of cores can be compared.
+static UINT64 ReadTick()
+{
+#ifdef TRACE_TSC
+	return __rdtsc();
+#else
+	return static_cast<UINT64>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+void Trace::Init(const char* filePath)
+{
+	g_enabled = filePath != nullptr;
+	if (FALSE == g_enabled)
+		return;
+
+	g_filePath = filePath;
+	g_startTime = std::chrono::steady_clock::now();
+	g_startTick = ReadTick();
+}
+
+void Trace::SetThreadName(const char* name)
+{
+	if (g_enabled)
+		t_threadRing.Get()->Name = name;
+}
+
+Span Trace::Begin(const UINT category, const char* name, const UINT arg)
+{
+	if (FALSE == g_enabled)
+		return { nullptr, 0, arg, category };
+
+	return { name, ReadTick(), arg, category };
+}
+
+void Trace::End(const Span& span)
+{
+	if (span.Name == nullptr)
+		return;
+
+	const UINT64 end = ReadTick();
+
+	ThreadRing* ring = t_threadRing.Get();
+	ring->EventAry[ring->WriteCount & (g_threadEventCapacity - 1)] = { span.Name, span.Start, end, span.Arg, span.Category };
+	ring->WriteCount++;
+}
+
+TraceStats Trace::Shutdown()
+{
+	TraceStats stats = { 0 };
+
+	if (FALSE == g_enabled)
+		return stats;
+
+	const UINT64 endTick = ReadTick();
+	const double elapsedMicroSeconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - g_startTime).count();
+	const double ticksPerMicroSecond = elapsedMicroSeconds > 0 ? (endTick - g_startTick) / elapsedMicroSeconds : 1.0;
+
+	std::ofstream file(g_filePath, std::ios::out | std::ios::trunc);
+	if (FALSE == file.is_open())
+		THROW_ERROR(L"Failed to open trace file.");
+
+	file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+
+	char line[512];
+	BOOL isFirst = TRUE;
+
+	for (ThreadRing* ring : g_ringList)
+	{
+		if (ring->Name != nullptr)
+		{
+			snprintf(line, sizeof(line), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+				isFirst ? "" : ",\n", ring->ThreadIndex, ring->Name);
+			file << line;
+			isFirst = FALSE;
+		}
+
+		const UINT64 keptCount = std::min<UINT64>(ring->WriteCount, g_threadEventCapacity);
+		stats.DroppedEventCount += ring->WriteCount - keptCount;
+		stats.EventCount += keptCount;
+
+		// Oldest kept event first.
+		for (UINT64 i = ring->WriteCount - keptCount; i < ring->WriteCount; i++)
+		{
+			const Event& event = ring->EventAry[i & (g_threadEventCapacity - 1)];
+			const double start = (event.Start - g_startTick) / ticksPerMicroSecond;
+			const double duration = (event.End - event.Start) / ticksPerMicroSecond;
+
+			int length = snprintf(line, sizeof(line), "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+				isFirst ? "" : ",\n", event.Name, g_categoryNameAry[std::min<UINT>(event.Category, CATEGORY_TEST)], ring->ThreadIndex, start, duration);
+
+			if (event.Arg != g_noArg)
+				length += snprintf(line + length, sizeof(line) - length, ",\"args\":{\"fid\":%u}", event.Arg);
+
+			snprintf(line + length, sizeof(line) - length, "}");
+			file << line;
+			isFirst = FALSE;
+		}
+
+		delete[] ring->EventAry;
+		delete ring;
+	}
+
+	file << "\n]}\n";
+
+	g_ringList.clear();
+	g_generation++;
+	g_enabled = FALSE;
+
+	return stats;
+}
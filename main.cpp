@@ -1,13 +1,33 @@
 #include "pch.h"
 #include "FileGenerator.h"
 #include "ThreadSchedule.h"
+#include "Statistics.h"
+#include "Sweep.h"
 
 using namespace FileGenerator;
 using namespace ThreadSchedule;
 
-void RunTest(const UINT testCount, const UINT testFileCount, const TestArgument args)
+// Point is saturated once files complete slower than this ratio of offered rate.
+// Completion rate counts drain after last arrival, so file count should make drain short next to arrival span.
+constexpr double g_saturationRatio = 0.9;
+
+// Means over repeats of open loop point.
+struct LoadSummary
+{
+	double OfferedRate;		// Files per second.
+	double CompletionRate;
+	double ResponseP50;		// From scheduled arrival to compute end (us).
+	double ResponseP99;
+	double MeanArrivalLag;	// us.
+};
+
+Statistics::Summary RunTest(const Sweep::SweepConfig& config, const UINT pointIndex, const TestArgument args, LoadSummary* loadSummary)
 {
+	const UINT testCount = config.RepeatCount;
+	const UINT testFileCount = args.TestFileCount;
+
 	// Open distribution info file.
+#ifdef _WIN32
 	const HANDLE distFileHandle =
 		CreateFileW(
 			L"dummy\\distribution",
@@ -25,25 +45,208 @@ void RunTest(const UINT testCount, const UINT testFileCount, const TestArgument
 
 	FileGenerationArgs* fileGenArgs = reinterpret_cast<FileGenerationArgs*>(buffer);
 	CloseHandle(distFileHandle);
+#else
+	const int distFd = open("dummy/distribution", O_RDONLY);
+
+	BYTE* buffer = static_cast<BYTE*>(calloc(1, sizeof(FileGenerationArgs)));
+
+	if (distFd < 0 || read(distFd, buffer, sizeof(FileGenerationArgs)) != sizeof(FileGenerationArgs))
+		THROW_ERROR(L"Failed to open distribution file.");
+
+	FileGenerationArgs* fileGenArgs = reinterpret_cast<FileGenerationArgs*>(buffer);
+	SAFE_CLOSE_FD(distFd);
+#endif
+
+	if (testFileCount > fileGenArgs->TotalFileCount)
+		THROW_ERROR(L"Dataset has fewer files than test file count.");
+
+	// Warm up. Results are dropped.
+	for (UINT w = 0; w < config.WarmupCount; w++)
+	{
+		Sweep::PrepareCache(testFileCount, args.DatasetLayout, config.CacheMode);
+		StartTest(args);
+	}
 
 	// Start test.
 	UINT64 totalFileSize = 0;
-	double elapsedTimeMean = 0;
 	double peakMemoryMean = 0;
+	*loadSummary = { 0 };
+	std::vector<TestResult> resultAry;
+	std::vector<double> elapsedTimeAry;
 
 	for (UINT t = 0; t < testCount; t++)
 	{
+		Sweep::PrepareCache(testFileCount, args.DatasetLayout, config.CacheMode);
+
 		TestResult res = StartTest(args);
+		resultAry.push_back(res);
+		elapsedTimeAry.push_back(res.ElapsedTime);
 
 		totalFileSize = res.TotalFileSize;
-		elapsedTimeMean += res.ElapsedTime;
 		peakMemoryMean += res.PeakMemory;
 
+		const double completionRate = res.ElapsedTime > 0 ? testFileCount / (res.ElapsedTime / 1000.0) : 0;
+		loadSummary->OfferedRate += res.OfferedRate / testCount;
+		loadSummary->CompletionRate += completionRate / testCount;
+		loadSummary->ResponseP50 += res.TotalLatency.P50 / testCount;
+		loadSummary->ResponseP99 += res.TotalLatency.P99 / testCount;
+		loadSummary->MeanArrivalLag += res.MeanArrivalLag / testCount;
+
 		printf("\
 Peak memory: %.2f MiB\n\
 Elapsed time: %.2f ms\n\n",
 			res.PeakMemory / (1024.0 * 1024.0),
 			res.ElapsedTime);
+
+		if (args.SimType == SIM_IO_URING_THREAD || args.SimType == SIM_COROUTINE_THREAD)
+			printf("Submit calls: %llu\n\n", res.SubmitCallCount);
+
+		printf("Compute kernel: %s\n\n",
+			res.ComputeKernelUsed == COMPUTE_KERNEL_AVX512 ? "AVX512" :
+			res.ComputeKernelUsed == COMPUTE_KERNEL_AVX2 ? "AVX2" :
+			res.ComputeKernelUsed == COMPUTE_KERNEL_SSE2 ? "SSE2" : "SCALAR");
+
+		if (args.UseDefinedComputeTime)
+			printf("Compute model: %.2f units/us, overshoot %.2f us, %.1f timer checks per compute\n\n",
+				res.ComputeUnitsPerMicroSecond,
+				res.MeanComputeOvershoot,
+				res.MeanComputeTimerCheckCount);
+
+		if (args.TraceFilePath != nullptr)
+			printf("Trace: %llu spans written to %s, %llu dropped\n\n", res.TraceEventCount, args.TraceFilePath, res.TraceDroppedEventCount);
+
+		printf("Page faults: Major(%llu) / Minor(%llu)\n\n", res.MajorFaultCount, res.MinorFaultCount);
+
+		if (args.UseBufferPool)
+			printf("Buffer pool: Hit(%llu) / Miss(%llu) / High water(%.2f MiB)\n\n",
+				res.BufferPoolHitCount,
+				res.BufferPoolMissCount,
+				res.BufferPoolHighWaterByteSize / (1024.0 * 1024.0));
+
+		if (args.SimType != SIM_MANUAL_TASK_THREAD)
+			printf("Task dispatch: Post(%.1f ns) / Get(%.1f ns) per task\n\n",
+				res.DispatchPostNanoSeconds,
+				res.DispatchGetNanoSeconds);
+
+		if (args.SimType == SIM_MANUAL_TASK_THREAD)
+			printf("File state setup: %.3f ms\nFile status sync: %.1f ns per task, parked %llu times\n\n",
+				res.FileSetupTime,
+				res.FileSyncNanoSeconds,
+				res.FileSyncParkCount);
+
+		if (args.SimType == SIM_WORK_STEALING_THREAD)
+			printf("Steals: ReadCall(%llu) / Compute(%llu) / Idle periods(%llu)\nCompute locality: %.1f%% (%llu / %u)\n\n",
+				res.StealReadCallCount,
+				res.StealComputeCount,
+				res.StealFailCount,
+				100.0 * res.LocalComputeCount / testFileCount,
+				res.LocalComputeCount,
+				testFileCount);
+
+		if (args.SimType == SIM_COROUTINE_THREAD)
+			printf("Coroutine frames: %llu bytes each, %llu alive at peak, %.2f MiB pooled\n-- Created in %.3f ms, suspended %llu times\n\n",
+				res.CoroutineFrameByteSize,
+				res.CoroutinePeakFrameCount,
+				res.CoroutineFramePoolByteSize / (1024.0 * 1024.0),
+				res.FileSetupTime,
+				res.CoroutineSuspendCount);
+
+		if (args.UseRebalancer)
+			printf("Rebalancer: Switch(%llu) / Grow(%llu) / Shrink(%llu)\nMean threads: ReadCall(%.2f) / Compute(%.2f)\n\n",
+				res.RebalanceSwitchCount,
+				res.RebalanceGrowCount,
+				res.RebalanceShrinkCount,
+				res.MeanReadCallThreadCount,
+				res.MeanComputeThreadCount);
+
+		if (args.MemoryBudgetByteSize > 0)
+			printf("Memory budget: %.2f MiB\n-- Waits(%llu, %.2f ms) / Over cap(%llu) / High water(%.2f MiB)\n\n",
+				args.MemoryBudgetByteSize / (1024.0 * 1024.0),
+				res.MemoryBudgetWaitCount,
+				res.MemoryBudgetWaitTime,
+				res.MemoryBudgetOverCommitCount,
+				res.MemoryBudgetHighWaterByteSize / (1024.0 * 1024.0));
+
+		if (args.UseNowaitRead)
+		{
+			const UINT64 nowaitFileCount = res.NowaitHitCount + res.NowaitMissCount;
+			printf("RWF_NOWAIT: Hit(%llu) / Miss(%llu), %.1f%% inline\n",
+				res.NowaitHitCount,
+				res.NowaitMissCount,
+				nowaitFileCount > 0 ? 100.0 * res.NowaitHitCount / nowaitFileCount : 0);
+
+			printf("-- Hit  read p50 %.1f us, total p50 %.1f us, p99 %.1f us\n-- Miss read p50 %.1f us, total p50 %.1f us, p99 %.1f us\n\n",
+				res.NowaitHitReadLatency.P50,
+				res.NowaitHitTotalLatency.P50,
+				res.NowaitHitTotalLatency.P99,
+				res.NowaitMissReadLatency.P50,
+				res.NowaitMissTotalLatency.P50,
+				res.NowaitMissTotalLatency.P99);
+		}
+
+		if (args.ThreadPlacement != THREAD_PLACEMENT_NONE)
+		{
+			printf("Topology: %u node(s), %u core(s), %u CPU(s)\n-- Pinned threads(%u) / Placed buffers(%llu)\n",
+				res.NodeCount,
+				res.CoreCount,
+				res.CpuCount,
+				res.PinnedThreadCount,
+				res.PlacedBufferCount);
+
+			for (UINT n = 0; n < res.NodeCount && n < g_maxReportedNodeCount; n++)
+				printf("-- Node %u compute: Local(%.2f MiB) / Remote(%.2f MiB)\n",
+					n,
+					res.NodeLocalByteSizeAry[n] / (1024.0 * 1024.0),
+					res.NodeRemoteByteSizeAry[n] / (1024.0 * 1024.0));
+			printf("\n");
+		}
+
+		if (args.BufferPage == BUFFER_PAGE_HUGE)
+		{
+			const UINT64 triedCount = res.HugePageBufferCount + res.TransparentHugePageBufferCount + res.SmallPageBufferCount;
+			printf("Huge pages: %.0f KiB, Reserved(%llu) / THP(%llu) / Small page(%llu), %.1f%% fell back\n-- Under half page, not tried(%llu)\n",
+				res.HugePageByteSize / 1024.0,
+				res.HugePageBufferCount,
+				res.TransparentHugePageBufferCount,
+				res.SmallPageBufferCount,
+				triedCount > 0 ? 100.0 * (triedCount - res.HugePageBufferCount) / triedCount : 0,
+				res.SmallBufferCount);
+		}
+
+		if (res.IsDtlbMissCounted)
+			printf("dTLB load misses: %llu, %.1f per MiB read\n\n",
+				res.DtlbMissCount,
+				res.TotalFileSize > 0 ? res.DtlbMissCount / (res.TotalFileSize / (1024.0 * 1024.0)) : 0);
+		else if (args.BufferPage == BUFFER_PAGE_HUGE)
+			printf("\n");
+
+		if (args.ArrivalRate > 0)
+			printf("Arrival: %s %u files/s, Offered(%.1f files/s) / Completed(%.1f files/s)\n-- Post lag: Mean(%.1f us) / Max(%.1f us)\n\n",
+				Sweep::GetArrivalName(args),
+				args.ArrivalRate,
+				res.OfferedRate,
+				completionRate,
+				res.MeanArrivalLag,
+				res.MaxArrivalLag);
+
+		if (args.SimType == SIM_STREAMING_THREAD)
+			printf("Time to first byte: %.2f ms (mean)\nFile latency: %.2f ms (mean), %.2f ms (max)\n\n",
+				res.MeanTimeToFirstByte,
+				res.MeanFileLatency,
+				res.MaxFileLatency);
+
+		printf("Stage latency (us)     p50        p90        p99        p99.9\n");
+		const std::pair<const char*, LatencyPercentiles> stageAry[] =
+		{
+			{ "Queue wait", res.QueueWaitLatency },
+			{ "Read", res.ReadLatency },
+			{ "Compute wait", res.ComputeWaitLatency },
+			{ "Compute", res.ComputeLatency },
+			{ "Total", res.TotalLatency },
+		};
+		for (const auto& stage : stageAry)
+			printf("%-16s %10.1f %10.1f %10.1f %10.1f\n", stage.first, stage.second.P50, stage.second.P90, stage.second.P99, stage.second.P999);
+		printf("\n");
 	}
 
 	// Summarize test results.
@@ -53,6 +256,11 @@ File distribution: %s\n\
 File size: %.2f KiB ~ %.2f KiB, Mean(%.2f KiB), Variance(%.2f KiB)\n\
 File compute time: %.2f ms ~ %.2f ms, Mean(%.2f ms), Variance(%.2f ms)\n\
 Test file count: %d\n\
+Dataset layout: %s\n\
+Post order: %s\n\
+Thread placement: %s\n\
+Buffer pages: %s\n\
+Arrival: %s, %u files/s\n\
 Total file size: %.2f MiB\n\n\
 Thread count: %d\n\
 -- READCALL_ONLY(%d) / COMPUTE_ONLY(%d) / COMPUTE_AND_READCALL(%d) / READCALL_AND_COMPUTE(%d)\n\n\
@@ -67,84 +275,187 @@ Simulation type: %s\n\n",
 		fileGenArgs->FileCompute.Mean / 1024.0,
 		fileGenArgs->FileCompute.Variance / 1024.0,
 		testFileCount,
+		Sweep::GetDatasetLayoutName(args.DatasetLayout),
+		Sweep::GetPostOrderName(args.PostOrder),
+		Sweep::GetThreadPlacementName(args.ThreadPlacement),
+		Sweep::GetBufferPageName(args.BufferPage),
+		Sweep::GetArrivalName(args),
+		args.ArrivalRate,
 		totalFileSize / (1024.0 * 1024.0),
 		args.ThreadCount,
 		args.ThreadRoleAry == NULL ? 0 : args.ThreadRoleAry[0],
 		args.ThreadRoleAry == NULL ? 0 : args.ThreadRoleAry[1],
 		args.ThreadRoleAry == NULL ? 0 : args.ThreadRoleAry[2],
 		args.ThreadRoleAry == NULL ? 0 : args.ThreadRoleAry[3],
-		args.SimType == SIM_MANUAL_TASK_THREAD ? "SIM_MANUAL_TASK_THREAD" :
-		args.SimType == SIM_ROLE_SPECIFIED_THREAD ? "SIM_ROLE_SPECIFIED_THREAD" :
-		args.SimType == SIM_SYNC_THREAD ? "SIM_SYNC_THREAD" : "SIM_MMAP_THREAD");
+		Sweep::GetSimulationName(args.SimType));
+
+	std::vector<BOOL> isOutlierAry;
+	const Statistics::Summary elapsedTime = Statistics::Summarize(elapsedTimeAry, &isOutlierAry);
+
+	for (UINT t = 0; t < testCount; t++)
+		Sweep::WriteRow(pointIndex, t, args, resultAry[t], isOutlierAry[t]);
 
-	elapsedTimeMean /= testCount;
 	peakMemoryMean /= testCount;
 
-	printf("%d Tested.\nMean Elapsed time: %.2f ms\nMean Peak memory: %.2f MiB\n\n\n",
+	printf("%d Tested (%d warmup, %d outlier).\n\
+Elapsed time: Median(%.2f ms) / Mean(%.2f ms) / StdDev(%.2f ms) / 95%% CI(%.2f ~ %.2f ms)\n\
+Mean Peak memory: %.2f MiB\n\
+Mean throughput: %.2f MiB/s\n\n\n",
 		testCount,
-		elapsedTimeMean,
-		peakMemoryMean / (1024.0 * 1024.0));
+		config.WarmupCount,
+		elapsedTime.OutlierCount,
+		elapsedTime.Median,
+		elapsedTime.Mean,
+		elapsedTime.StdDev,
+		elapsedTime.CiLow,
+		elapsedTime.CiHigh,
+		peakMemoryMean / (1024.0 * 1024.0),
+		elapsedTime.Mean > 0 ? totalFileSize / (1024.0 * 1024.0) / (elapsedTime.Mean / 1000.0) : 0);
 
+#ifdef _WIN32
 	HeapFree(GetProcessHeap(), MEM_RELEASE, buffer);
+#else
+	free(buffer);
+#endif
+
+	return elapsedTime;
 }
 
-int main()
+int main(int argc, char** argv)
 {
+	// Every setting comes from command line or config file. See Sweep.h.
+	const Sweep::SweepConfig config = Sweep::ParseArgs(argc, argv);
+
 	/* --------------------------------------------------------------------- File Generation */
 
-	FileSizeArgs fileSizeArgs =
+	// One dataset is shared by every point of sweep.
+	if (config.GenerateFileCount > 0)
 	{
-		(UINT64)1 * 1024,									// MinByte
-		(UINT64)2 * 1024 * 1024,							// MaxByte
-		(UINT64)1 * 1024 * 1024,							// Mean
-		(UINT64)512 * 1024									// Variance
-	};
+		FileGenerationArgs fileGenArgs = config.GenerationArgs;
+		fileGenArgs.TotalFileCount = config.GenerateFileCount;
 
-	FileComputeArgs fileComputeArgs =
-	{
-		100u,												// MinMicroSeconds
-		5000u,												// MaxMicroSeconds
-		2000u,												// Mean
-		2000u												// Variance
-	};
+		const std::vector<DatasetLayoutType>& layoutAry = config.DatasetLayoutAry;
+		GenerateDummyFiles(
+			fileGenArgs,
+			config.GeneratorOptions,
+			std::find(layoutAry.begin(), layoutAry.end(), DATASET_LAYOUT_FILES) != layoutAry.end(),
+			std::find(layoutAry.begin(), layoutAry.end(), DATASET_LAYOUT_PACKED) != layoutAry.end());
+	}
+
+	/* -------------------------------------------------------------------------------------- */
+
+	/* --------------------------------------------------------------------------------- Test */
+
+	const std::vector<TestArgument> pointAry = Sweep::Expand(config);
+
+	std::vector<Statistics::Summary> summaryAry;
+	std::vector<LoadSummary> loadSummaryAry(pointAry.size());
+
+	Sweep::OpenOutput(config);
 
-	FileGenerationArgs fileGenArgs =
+	for (UINT p = 0; p < pointAry.size(); p++)
 	{
-		100,												// TotalFileCount
-		fileSizeArgs,										// FileSize
-		NORMAL_DIST,										// FileSizeModelType
-		fileComputeArgs,									// FileCompute
-	};
+		printf("\n[Point %u / %zu]\n\n", p + 1, pointAry.size());
+		summaryAry.push_back(RunTest(config, p, pointAry[p], &loadSummaryAry[p]));
+	}
 
-	// GenerateDummyFiles(fileGenArgs);
+	Sweep::CloseOutput();
 
-	/* -------------------------------------------------------------------------------------- */
+	// Rank points. Point whose interval overlaps the best one is not a real improvement over it.
+	if (pointAry.size() > 1)
+	{
+		std::vector<UINT> rankAry(pointAry.size());
+		for (UINT p = 0; p < pointAry.size(); p++)
+			rankAry[p] = p;
 
-	/* --------------------------------------------------------------------------------- Test */
+		std::sort(rankAry.begin(), rankAry.end(), [&](const UINT a, const UINT b) { return summaryAry[a].Mean < summaryAry[b].Mean; });
 
-	constexpr UINT testCount = 10;
-	constexpr UINT testFileCount = 50;
+		printf("\n[Comparison] Mean elapsed time, 95%% CI\n");
+		for (const UINT p : rankAry)
+		{
+			const Statistics::Summary& summary = summaryAry[p];
+			const BOOL isTie = p != rankAry[0] && Statistics::IsOverlapped(summary, summaryAry[rankAry[0]]);
 
-	UINT threadRoleAry[4] = { 1, 2, 0, 0 };
+			// Budget of 0 is unlimited.
+			char budget[32] = "-";
+			if (pointAry[p].MemoryBudgetByteSize > 0)
+				snprintf(budget, sizeof(budget), "%.2f MiB", pointAry[p].MemoryBudgetByteSize / (1024.0 * 1024.0));
 
-	UINT threadCount = 0;
-	for (UINT i = 0; i < 4; i++)
-		threadCount += threadRoleAry[i];
+			printf("Point %-4u %-16s threads %-3u files %-7u layout %-7s order %-11s placement %-8s pages %-5s arrival %-7s rate %-6u budget %-10s %10.2f ms  (%.2f ~ %.2f)%s\n",
+				p + 1,
+				Sweep::GetSimulationName(pointAry[p].SimType),
+				pointAry[p].ThreadCount,
+				pointAry[p].TestFileCount,
+				Sweep::GetDatasetLayoutName(pointAry[p].DatasetLayout),
+				Sweep::GetPostOrderName(pointAry[p].PostOrder),
+				Sweep::GetThreadPlacementName(pointAry[p].ThreadPlacement),
+				Sweep::GetBufferPageName(pointAry[p].BufferPage),
+				Sweep::GetArrivalName(pointAry[p]),
+				pointAry[p].ArrivalRate,
+				budget,
+				summary.Mean,
+				summary.CiLow,
+				summary.CiHigh,
+				isTie ? "  NOT SIGNIFICANT vs best" : "");
+		}
+	}
 
-	TestArgument args =
+	// Rates are innermost axis, so every run of rateCount points is one configuration.
+	const size_t rateCount = config.ArrivalRateAry.size();
+	if (rateCount > 1)
 	{
-		SIM_ROLE_SPECIFIED_THREAD,							// Simulation type
-		testFileCount,										// Number of files to test
-		threadCount,										// Number of threads
-		threadRoleAry,										// Role of thread
-		testFileCount,										// ReadCall task limit
-		testFileCount,										// Compute task limit
-		TRUE												// Use defined compute time?
-	};
+		printf("\n[Saturation] Open loop rate sweep, knee is highest rate completed at %.0f%% of offered rate or more\n", g_saturationRatio * 100);
+		for (size_t first = 0; first < pointAry.size(); first += rateCount)
+		{
+			printf("\n%s threads %u files %u layout %s order %s placement %s pages %s arrival %s\n",
+				Sweep::GetSimulationName(pointAry[first].SimType),
+				pointAry[first].ThreadCount,
+				pointAry[first].TestFileCount,
+				Sweep::GetDatasetLayoutName(pointAry[first].DatasetLayout),
+				Sweep::GetPostOrderName(pointAry[first].PostOrder),
+				Sweep::GetThreadPlacementName(pointAry[first].ThreadPlacement),
+				Sweep::GetBufferPageName(pointAry[first].BufferPage),
+				Sweep::GetArrivalName(pointAry[first + rateCount - 1]));
+			printf("Rate (files/s)   Offered    Completed  Resp p50 (us)  Resp p99 (us)  Post lag (us)\n");
+
+			UINT kneeRate = 0;
+			BOOL isKneeFound = FALSE;
+			for (size_t p = first; p < first + rateCount; p++)
+			{
+				const LoadSummary& load = loadSummaryAry[p];
+
+				// Closed batch has no offered rate.
+				if (pointAry[p].ArrivalRate == 0)
+				{
+					printf("%-14s %9s %12.1f %14.1f %14.1f %14s\n", "CLOSED", "-", load.CompletionRate, load.ResponseP50, load.ResponseP99, "-");
+					continue;
+				}
+
+				const BOOL isSaturated = load.CompletionRate < load.OfferedRate * g_saturationRatio;
+				if (FALSE == isSaturated && pointAry[p].ArrivalRate > kneeRate)
+				{
+					kneeRate = pointAry[p].ArrivalRate;
+					isKneeFound = TRUE;
+				}
 
-	RunTest(testCount, testFileCount, args);
+				printf("%-14u %9.1f %12.1f %14.1f %14.1f %14.1f%s\n",
+					pointAry[p].ArrivalRate,
+					load.OfferedRate,
+					load.CompletionRate,
+					load.ResponseP50,
+					load.ResponseP99,
+					load.MeanArrivalLag,
+					isSaturated ? "  SATURATED" : "");
+			}
+
+			if (isKneeFound)
+				printf("Knee: %u files/s\n", kneeRate);
+			else
+				printf("Knee: below every swept rate\n");
+		}
+	}
 
 	/* -------------------------------------------------------------------------------------- */
 
 	return 0;
-}
\ No newline at end of file
+}